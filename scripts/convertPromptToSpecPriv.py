@@ -1,5 +1,9 @@
+# specpriv_convert (src/runtime/tools) emits the same profile natively and also
+# covers the loaded values; this script is kept for the logs of older runs.
 import os
 import argparse
+import mmap
+import struct
 
 
 # Parse the rabbit6 file
@@ -58,6 +62,43 @@ def parse_rabbit6(fname):
 
     return malloc_id, uo_id, func_id, loop_id
 
+# Load the symbol table the SLAMP pass writes (-slamp-symbols), see
+# slamp_symbols.h: a PROMPT profile whose SYMBOLS section holds
+# (kind, id, offset, size) records into the SYMBOL_STRINGS section
+def parse_symbols(fname):
+    SYMBOLS, SYMBOL_STRINGS = 9, 10
+    INSTRUCTION, ARGUMENT, FUNCTION, LOOP = 1, 2, 3, 4
+
+    with open(fname, 'rb') as f:
+        data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    magic, version, num_sections, file_size = struct.unpack_from("<8sIIQ", data, 0)
+    assert magic == b"PROMPTPF"
+
+    sections = {}
+    for i in range(num_sections):
+        kind, record_size, loop_id, flags, offset, count = struct.unpack_from("<IIIIQQ", data, 24 + i * 32)
+        sections[kind] = (offset, count)
+
+    strings_offset, _ = sections[SYMBOL_STRINGS]
+    records_offset, count = sections[SYMBOLS]
+
+    malloc_id, uo_id, func_id, loop_id = {}, {}, {}, {}
+    for kind, sid, offset, size in struct.iter_unpack("<IIII", data[records_offset:records_offset + count * 16]):
+        start = strings_offset + offset
+        name = data[start:start + size].decode()
+        if kind == INSTRUCTION:
+            malloc_id[str(sid)] = name
+            uo_id[str(sid << 1)] = name
+        elif kind == ARGUMENT:
+            uo_id[str(sid)] = name
+        elif kind == FUNCTION:
+            func_id[str(sid)] = name
+        elif kind == LOOP:
+            loop_id[str(sid)] = name
+
+    return malloc_id, uo_id, func_id, loop_id
+
 def parse_specpriv(fname, id_maps):
 
     with open(fname, 'r') as f:
@@ -202,7 +243,8 @@ def parse_specpriv(fname, id_maps):
 # Parse the rabbit6 file and the specpriv-profile.out file
 def parse_args():
     parser = argparse.ArgumentParser(description='Parse the rabbit6 file and the specpriv-profile.out file')
-    parser.add_argument('-r', '--rabbit6', help='Rabbit6 file', default="rabbit6", type=str)
+    parser.add_argument('-r', '--rabbit6', help='Rabbit6 file (log of the pass with -slamp-print-ids)', default="rabbit6", type=str)
+    parser.add_argument('-s', '--symbols', help='Symbol table of the pass (-slamp-symbols), used instead of the rabbit6 file', default=None, type=str)
     parser.add_argument('-p', '--profile', help='specpriv-profile.out file', default="specpriv-profile.out", type=str)
     parser.add_argument('-o', '--output', help='Output file', default="specpriv-profile-converted.out", type=str)
     return parser.parse_args()
@@ -215,8 +257,11 @@ if __name__ == "__main__":
     rabbit6 = args.rabbit6
     profile = args.profile
 
-    # Parse the rabbit6 file
-    malloc_id, uo_id, func_id, loop_id = parse_rabbit6(rabbit6)
+    # Load the symbol table, or parse the rabbit6 file
+    if args.symbols:
+        malloc_id, uo_id, func_id, loop_id = parse_symbols(args.symbols)
+    else:
+        malloc_id, uo_id, func_id, loop_id = parse_rabbit6(rabbit6)
 
     id_maps = {"malloc": malloc_id, "uo": uo_id, "func": func_id, "loop": loop_id}
 
@@ -37,6 +37,7 @@
 
 #include "externs.h"
 
+#include <algorithm>
 #include <map>
 #include <sstream>
 #include <vector>
@@ -99,6 +100,13 @@ static cl::opt<std::string> TargetFcn("slamp-target-fn", cl::init(""),
 static cl::opt<std::string> TargetLoop("slamp-target-loop", cl::init(""),
                                        cl::NotHidden, cl::desc("Target Loop"));
 
+// batch mode: profile all these loops in one run, each reported with its own
+// loop ID; replaces -slamp-target-fn and -slamp-target-loop
+static cl::list<std::string>
+    TargetLoops("slamp-target-loops", cl::NotHidden, cl::CommaSeparated,
+                cl::desc("Target loops of the batch mode"),
+                cl::value_desc("fn:loop"));
+
 // top priority; not compatible with the rest
 static cl::list<uint32_t>
     ExplicitInsts("slamp-explicit-insts", cl::NotHidden, cl::CommaSeparated,
@@ -131,6 +139,19 @@ static cl::opt<uint32_t> TargetInst("slamp-target-inst", cl::init(0),
 cl::opt<std::string> outfile("slamp-outfile", cl::init("result.slamp.profile"),
                              cl::NotHidden, cl::desc("Output file name"));
 
+static cl::opt<std::string>
+    SymbolsFile("slamp-symbols", cl::init(::slamp::SYMBOLS_DEFAULT_FILE),
+                cl::NotHidden,
+                cl::desc("Symbol table (ID to name) of the instrumented "
+                         "program, empty to skip it"));
+
+// the text form of the symbol table, for scripts scraping the log
+static cl::opt<bool> PrintIds("slamp-print-ids", cl::init(false),
+                              cl::NotHidden,
+                              cl::desc("Print the IDs and names of allocation "
+                                       "sites, underlying objects, loops and "
+                                       "functions to stderr"));
+
 SLAMP::SLAMP() : ModulePass(ID) {}
 
 SLAMP::~SLAMP() = default;
@@ -236,20 +257,36 @@ bool SLAMP::runOnModule(Module &m) {
   I64 = Type::getInt64Ty(ctxt);
   I8Ptr = Type::getInt8PtrTy(ctxt);
 
+  const bool batch = !TargetLoops.empty();
+
   // find target function/loop
-  if (TargetLoopEnabled && !findTarget(m))
+  if (batch) {
+    if (!findBatchTargets(m))
+      return false;
+  } else if (TargetLoopEnabled && !findTarget(m)) {
     return false;
+  }
 
   // TODO: might want to check the whole program if no target loop is found
   // check if target may call setjmp/longjmp
-  if (TargetLoopEnabled && mayCallSetjmpLongjmp(this->target_loop)) {
+  if (batch) {
+    for (auto &target : batch_targets) {
+      if (mayCallSetjmpLongjmp(getBatchLoop(target)))
+        LLVM_DEBUG(errs() << "Warning! target loop " << target.header->getName()
+                          << " may call setjmp/longjmp\n");
+    }
+  } else if (TargetLoopEnabled && mayCallSetjmpLongjmp(this->target_loop)) {
     LLVM_DEBUG(errs() << "Warning! target loop may call setjmp/longjmp\n");
     // return false;
   }
 
 #ifdef USE_PDG
+  // the elision is for one target loop
+  if (batch) {
+    errs() << "No elision in the batch mode\n";
+  }
   // User set the explicit insts through slamp-explicit-insts
-  if (!ExplicitInsts.empty()) {
+  else if (!ExplicitInsts.empty()) {
     for (auto *BB : this->target_loop->blocks()) {
       for (Instruction &I : *BB) {
         if (!I.mayReadOrWriteMemory()) {
@@ -471,11 +508,20 @@ bool SLAMP::runOnModule(Module &m) {
   instrumentFunctionStartStop(m);
   instrumentMainFunction(m);
 
-  if (TargetLoopEnabled) {
+  if (batch) {
+    // outermost first, so an exit block shared with an inner loop reports the
+    // inner exit first
+    set<Instruction *> loopinsts;
+    for (auto &target : batch_targets) {
+      Loop *loop = getBatchLoop(target);
+      instrumentLoopStartStop(m, loop, true);
+      for (auto &bb : loop->getBlocks())
+        for (auto &ii : *bb)
+          loopinsts.insert(&ii);
+    }
+    instrumentInstructions(m, loopinsts, false);
+  } else if (TargetLoopEnabled) {
     instrumentLoopStartStop(m, this->target_loop);
-  }
-
-  if (TargetLoopEnabled) {
     instrumentInstructions(m, this->target_loop);
   } else {
     instrumentInstructions(m);
@@ -486,6 +532,9 @@ bool SLAMP::runOnModule(Module &m) {
   // binary standard function
   addWrapperImplementations(m);
 
+  if (!SymbolsFile.empty() && !symbols.write(SymbolsFile.c_str()))
+    errs() << "Cannot write the symbol table to " << SymbolsFile << "\n";
+
   return true;
 }
 
@@ -524,6 +573,56 @@ bool SLAMP::findTarget(Module &m) {
   return found;
 }
 
+/// Find the loops of -slamp-target-loops ("fn:loop"), outermost first. The
+/// ones that cannot be found are skipped
+bool SLAMP::findBatchTargets(Module &m) {
+  for (auto &spec : TargetLoops) {
+    auto colon = spec.find(':');
+    Function *f =
+        colon == string::npos ? nullptr : m.getFunction(spec.substr(0, colon));
+
+    BasicBlock *header = nullptr;
+    if (f && !f->isDeclaration()) {
+      for (auto &bi : *f) {
+        if (bi.getName().str() == spec.substr(colon + 1)) {
+          header = &bi;
+          break;
+        }
+      }
+    }
+
+    Loop *loop = nullptr;
+    if (header) {
+      LoopInfo &loopinfo = getAnalysis<LoopInfoWrapperPass>(*f).getLoopInfo();
+      loop = loopinfo.getLoopFor(header);
+    }
+    if (!loop || loop->getHeader() != header) {
+      errs() << "Cannot find target loop " << spec << ", skipped\n";
+      continue;
+    }
+
+    bool duplicate = any_of(
+        batch_targets.begin(), batch_targets.end(),
+        [&](const BatchTarget &target) { return target.header == header; });
+    if (!duplicate)
+      batch_targets.push_back({f, header, loop->getLoopDepth()});
+  }
+
+  stable_sort(batch_targets.begin(), batch_targets.end(),
+              [](const BatchTarget &a, const BatchTarget &b) {
+                return a.depth < b.depth;
+              });
+  return !batch_targets.empty();
+}
+
+/// The LoopInfo of a function does not survive asking for the one of another
+/// function, so the loops of the batch mode are looked up every time
+Loop *SLAMP::getBatchLoop(const BatchTarget &target) {
+  LoopInfo &loopinfo =
+      getAnalysis<LoopInfoWrapperPass>(*target.fn).getLoopInfo();
+  return loopinfo.getLoopFor(target.header);
+}
+
 static bool is_setjmp_or_longjmp(Function *f) {
   string name = f->getName().str();
   if (name == "_setjmp" || name == "longjmp")
@@ -728,7 +827,11 @@ void SLAMP::replaceExternalFunctionCalls(Module &m) {
       InstInsertPt pt = InstInsertPt::Before(inst);
       pt << updateDebugInfo(CallInst::Create(push, args), pt.getPosition(), m);
 
-      errs() << "Malloc ID " << id << " : " << getInstructionName(inst) << "\n";
+      symbols.add(::slamp::SymbolKind::INSTRUCTION, id,
+                  getInstructionName(inst));
+      if (PrintIds)
+        errs() << "Malloc ID " << id << " : " << getInstructionName(inst)
+               << "\n";
 
       if (isa<CallInst>(inst)) {
         pt = InstInsertPt::After(inst);
@@ -805,7 +908,12 @@ Function *SLAMP::instrumentConstructor(Module &m) {
   uint32_t maxInstructionId = findMaxInstructionId(m);
   uint32_t targetFunctionId = 0;
   uint32_t targetLoopId = 0;
-  if (TargetLoopEnabled) {
+  // the first loop stands for the batch, a loop ID other than 0 turns on the
+  // target loop mode of the runtime
+  if (!batch_targets.empty()) {
+    targetFunctionId = Namer::getFuncId(batch_targets[0].fn);
+    targetLoopId = Namer::getBlkId(batch_targets[0].header);
+  } else if (TargetLoopEnabled) {
     targetFunctionId = Namer::getFuncId(this->target_fn);
     targetLoopId = Namer::getBlkId(this->target_loop->getHeader());
   }
@@ -934,6 +1042,10 @@ void SLAMP::reportStartOfAllocaLifetime(AllocaInst *inst, Instruction *start,
 
   Type *ptype[4] = {I32, I64, I64, I64};
 
+  // the stack AU is known by its lifetime start, but named after the alloca
+  symbols.add(::slamp::SymbolKind::INSTRUCTION, Namer::getInstrId(start),
+              getInstructionName(inst));
+
   vector<Value *> args;
   args.push_back(ConstantInt::get(I32, Namer::getInstrId(start)));
   args.push_back(ptrcast);
@@ -1032,9 +1144,11 @@ void SLAMP::instrumentBasePointer(Module &m) {
          << updateDebugInfo(CallInst::Create(find_underlying_arg, args),
                             pt.getPosition(), m);
 
+      auto uoId = ::slamp::underlyingArgId(fcnId, argId);
+      symbols.add(::slamp::SymbolKind::ARGUMENT, uoId, getArgName(arg));
       // errs() << "UO Arg (" << fcnId << "," << argId <<  ") : "
-      errs() << "UO Arg " << (fcnId << 5 | ((0x1f & (argId << 4)) | 0x1))
-             << " : " << getArgName(arg) << "\n";
+      if (PrintIds)
+        errs() << "UO Arg " << uoId << " : " << getArgName(arg) << "\n";
     } else if (const auto *const_inst = dyn_cast<Instruction>(object)) {
       if (already.count(const_inst))
         continue;
@@ -1087,8 +1201,11 @@ void SLAMP::instrumentBasePointer(Module &m) {
             << updateDebugInfo(CallInst::Create(find_underlying_inst, args),
                                where.getPosition(), m);
 
-      errs() << "UO Inst " << (instId << 1 | 0x0) << " : "
-             << getInstructionName(inst) << "\n";
+      symbols.add(::slamp::SymbolKind::INSTRUCTION, instId,
+                  getInstructionName(inst));
+      if (PrintIds)
+        errs() << "UO Inst " << ::slamp::underlyingInstId(instId) << " : "
+               << getInstructionName(inst) << "\n";
     } else {
       errs() << "What is: " << *object << '\n';
       assert(false && "Unknown object type?!?!");
@@ -1276,8 +1393,12 @@ void SLAMP::instrumentLoopStartStopForAll(Module &m) {
       vector<Value *> args;
       args.push_back(ConstantInt::get(I32, loopId));
 
-      errs() << "Loop ID " << loopId << " : " << f.getName() << " "
-             << header->getName() << " " << li.getLoopDepth(header) << "\n";
+      std::ostringstream loopName;
+      loopName << f.getName().str() << ' ' << header->getName().str() << ' '
+               << li.getLoopDepth(header);
+      symbols.add(::slamp::SymbolKind::LOOP, loopId, loopName.str());
+      if (PrintIds)
+        errs() << "Loop ID " << loopId << " : " << loopName.str() << "\n";
 
       // check if loop-simplify pass executed
       assert(loop->getNumBackEdges() == 1 &&
@@ -1365,7 +1486,9 @@ void SLAMP::instrumentFunctionStartStop(Module &m) {
       continue;
     }
 
-    errs() << "Function ID " << fcnID << " : " << func->getName() << "\n";
+    symbols.add(::slamp::SymbolKind::FUNCTION, fcnID, func->getName().str());
+    if (PrintIds)
+      errs() << "Function ID " << fcnID << " : " << func->getName() << "\n";
 
     // set parameters
     vector<Value *> args;
@@ -1408,8 +1531,9 @@ void SLAMP::instrumentFunctionStartStop(Module &m) {
   }
 }
 
-/// Pass in the loop and instrument invocation/iteration/exit hooks
-void SLAMP::instrumentLoopStartStop(Module &m, Loop *loop) {
+/// Pass in the loop and instrument invocation/iteration/exit hooks. In the
+/// batch mode the hooks take the ID of the loop
+void SLAMP::instrumentLoopStartStop(Module &m, Loop *loop, bool batch) {
   // TODO: check setjmp/longjmp
 
   BasicBlock *header = loop->getHeader();
@@ -1423,13 +1547,19 @@ void SLAMP::instrumentLoopStartStop(Module &m, Loop *loop) {
   // add instrumentation on loop header:
   // if new invocation, call SLAMP_loop_invocation, else, call
   // SLAMP_loop_iteration
-  FunctionType *fty = FunctionType::get(Void, false);
+  FunctionType *fty = batch ? FunctionType::get(Void, I32, false)
+                            : FunctionType::get(Void, false);
+  string prefix = batch ? "SLAMP_batch_loop_" : "SLAMP_loop_";
   auto *f_loop_invoke = cast<Function>(
-      m.getOrInsertFunction("SLAMP_loop_invocation", fty).getCallee());
+      m.getOrInsertFunction(prefix + "invocation", fty).getCallee());
   auto *f_loop_iter = cast<Function>(
-      m.getOrInsertFunction("SLAMP_loop_iteration", fty).getCallee());
+      m.getOrInsertFunction(prefix + "iteration", fty).getCallee());
   auto *f_loop_exit =
-      cast<Function>(m.getOrInsertFunction("SLAMP_loop_exit", fty).getCallee());
+      cast<Function>(m.getOrInsertFunction(prefix + "exit", fty).getCallee());
+
+  SmallVector<Value *, 1> args;
+  if (batch)
+    args.push_back(ConstantInt::get(I32, Namer::getBlkId(header)));
 
   PHINode *funcphi = PHINode::Create(f_loop_invoke->getType(), 2, "funcphi");
   InstInsertPt pt;
@@ -1449,8 +1579,9 @@ void SLAMP::instrumentLoopStartStop(Module &m, Loop *loop) {
       funcphi->addIncoming(f_loop_invoke, pred);
   }
 
-  updateDebugInfo(CallInst::Create(fty, funcphi, "", header->getFirstNonPHI()),
-                  header->getFirstNonPHI(), m);
+  updateDebugInfo(
+      CallInst::Create(fty, funcphi, args, "", header->getFirstNonPHI()),
+      header->getFirstNonPHI(), m);
 
   // Add `SLAMP_loop_exit` to all loop exits
   SmallVector<BasicBlock *, 8> exits;
@@ -1463,7 +1594,7 @@ void SLAMP::instrumentLoopStartStop(Module &m, Loop *loop) {
     if (s.count(exits[i]))
       continue;
 
-    CallInst *ci = CallInst::Create(f_loop_exit, "");
+    CallInst *ci = CallInst::Create(f_loop_exit, args, "");
 
     InstInsertPt pt2;
     if (isa<LandingPadInst>(exits[i]->getFirstNonPHI()))
@@ -1488,6 +1619,14 @@ void SLAMP::instrumentInstructions(Module &m, Loop *loop) {
         loopinsts.insert(&ii);
   }
 
+  instrumentInstructions(m, loopinsts, !TargetLoopEnabled);
+}
+
+/// Instrument all instructions, the ones in `loopinsts` (all of them for
+/// `whole_program`) as loop instructions and the rest as external ones
+void SLAMP::instrumentInstructions(Module &m,
+                                   const set<Instruction *> &loopinsts,
+                                   bool whole_program) {
   // go over all instructions in the module
   // - change some intrinsics functions
   // - for instructions within the loop, replace it with normal load/store
@@ -1516,7 +1655,7 @@ void SLAMP::instrumentInstructions(Module &m, Loop *loop) {
         continue; // it's an instrumented instruction, skip
 
       // if not target loop or found in loopinsts
-      if (!TargetLoopEnabled || loopinsts.find(&inst) != loopinsts.end()) {
+      if (whole_program || loopinsts.find(&inst) != loopinsts.end()) {
         instrumentLoopInst(m, &inst, id);
       } else {
         instrumentExtInst(m, &inst, id);
@@ -1748,6 +1887,11 @@ void SLAMP::instrumentLoopInst(Module &m, Instruction *inst, uint32_t id) {
     } else {
       args.push_back(ConstantInt::get(I32, id));
       args.push_back(castToInt64Ty(li, pt)); // value
+
+      // the loaded value of an integer can be predicted
+      if (li->getType()->isIntegerTy())
+        symbols.add(::slamp::SymbolKind::INTEGER_LOAD, id,
+                    getInstructionName(li));
     }
 
     pt << updateDebugInfo(CallInst::Create(lf[index], args), li, m);
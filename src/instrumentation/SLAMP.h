@@ -10,6 +10,8 @@
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/DataLayout.h"
 
+#include "ProfilingModules/slamp_symbols.h"
+
 #include <set>
 #include <unordered_set>
 
@@ -33,6 +35,15 @@ public:
 private:
   bool findTarget(Module &m);
 
+  // a loop of the batch mode (-slamp-target-loops)
+  struct BatchTarget {
+    Function *fn;
+    BasicBlock *header;
+    unsigned depth;
+  };
+  bool findBatchTargets(Module &m);
+  Loop *getBatchLoop(const BatchTarget &target);
+
   bool mayCallSetjmpLongjmp(Loop *loop);
   void getCallableFunctions(Loop *loop, set<Function *> &callables);
   void getCallableFunctions(Function *f, set<Function *> &callables);
@@ -61,8 +72,10 @@ private:
   void allocErrnoLocation(Module &m, Function *ctor);
   void instrumentLoopStartStopForAll(Module &m);
   void instrumentFunctionStartStop(Module &m);
-  void instrumentLoopStartStop(Module &m, Loop *l);
+  void instrumentLoopStartStop(Module &m, Loop *l, bool batch = false);
   void instrumentInstructions(Module &m, Loop *l = nullptr);
+  void instrumentInstructions(Module &m, const set<Instruction *> &loopinsts,
+                              bool whole_program);
 
   void instrumentMainFunction(Module &m);
 
@@ -80,7 +93,12 @@ private:
 
   Function *target_fn;
   Loop *target_loop;
+  // outermost first
+  vector<BatchTarget> batch_targets;
   unordered_set<Instruction *> elidedLoopInsts;
+
+  // the names of the IDs passed to the runtime, written to -slamp-symbols
+  ::slamp::SymbolTableWriter symbols;
 };
 
 } // namespace liberty::slamp
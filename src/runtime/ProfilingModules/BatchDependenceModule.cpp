@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "BatchDependenceModule.h"
+
+// Batch dependence module
+// Requires events:
+//  - init, fini
+//  - [x] Load (size, instr, addr)
+//  - [x] Store (size, instr, addr)
+//  - [x] Alloc (size, ptr)
+//  - [x] Target loop invocation, iteration, exit (loop_id)
+
+#define SIZE_8M 0x800000
+
+void BatchDependenceModule::init(uint32_t loop_id, uint32_t pid) {
+  smmap->init_stack(SIZE_8M, pid);
+}
+
+static auto record_key(const slamp::DependenceRecord &r) {
+  return std::tie(r.src, r.dst, r.dst_bare, r.cross);
+}
+
+static std::vector<slamp::DependenceRecord>
+sorted_records(const phmap::flat_hash_set<slamp::KEY, slamp::KEYHash,
+                                          slamp::KEYEqual> &deps) {
+  std::vector<slamp::DependenceRecord> records;
+  for (auto &k : deps)
+    records.push_back({k.src, k.dst, k.dst_bare, k.cross ? 1u : 0u, 1, 0, 0});
+
+  std::sort(records.begin(), records.end(),
+            [](const slamp::DependenceRecord &a,
+               const slamp::DependenceRecord &b) {
+              return record_key(a) < record_key(b);
+            });
+  return records;
+}
+
+// the format of DependenceModule::fini, one block per loop in the order of
+// the loop IDs
+void BatchDependenceModule::fini(const char *filename) {
+  std::map<uint32_t, const Deps *> sorted;
+  for (auto &[loop_id, d] : deps)
+    sorted.emplace(loop_id, &d);
+
+  std::ofstream of(filename);
+  for (auto &[loop_id, d] : sorted) {
+    of << loop_id << " " << 0 << " " << 0 << " " << 0 << " " << 0 << " " << 0
+       << "\n";
+    for (auto &r : sorted_records(*d))
+      of << loop_id << " " << r.src << " " << r.dst << " " << r.dst_bare << " "
+         << r.cross << " " << r.count << " \n";
+  }
+}
+
+// binary counterpart of `fini`, a DEPENDENCE section per loop
+void BatchDependenceModule::dump(slamp::ProfileWriter &writer) {
+  std::map<uint32_t, const Deps *> sorted;
+  for (auto &[loop_id, d] : deps)
+    sorted.emplace(loop_id, &d);
+
+  for (auto &[loop_id, d] : sorted)
+    writer.addSection(slamp::ProfileSection::DEPENDENCE, sorted_records(*d),
+                      loop_id);
+}
+
+// fold in a previous binary profile, returns the number of dependences that
+// are not in it
+uint64_t BatchDependenceModule::accumulate(const slamp::ProfileReader &reader) {
+  uint64_t previous = 0;
+  for (auto &section : reader.sections()) {
+    if (section.kind != slamp::ProfileSection::DEPENDENCE)
+      continue;
+    previous += section.count;
+    auto &d = deps[section.loop_id];
+    for (auto &r : reader.records<slamp::DependenceRecord>(section))
+      d.emplace(r.src, r.dst, r.dst_bare, r.cross);
+  }
+
+  uint64_t total = 0;
+  for (auto &[loop_id, d] : deps)
+    total += d.size();
+  return total - previous;
+}
+
+void BatchDependenceModule::allocate(void *addr, uint64_t size) {
+  smmap->allocate(addr, size);
+}
+
+// the loops on the stack whose current invocation started before the store
+// are the ones both accesses are in; they are a prefix, the inner ones
+// started later
+void BatchDependenceModule::log(TS ts, uint32_t dst_inst) {
+  const uint32_t src_inst = GET_INSTR(ts);
+  const uint64_t store_time = ts & TIME_MASK;
+
+  for (auto &loop : stack) {
+    if (store_time < loop.invocation_time)
+      break;
+    loop.deps->emplace(src_inst, dst_inst, 0,
+                       store_time < loop.iteration_time ? 1 : 0);
+  }
+}
+
+// every byte of the access, as DependenceModule
+void BatchDependenceModule::load(uint32_t instr, uint64_t addr, uint32_t size) {
+  local_write_range(addr, size, [&](const uint64_t addr, const uint32_t size) {
+    TS *s = (TS *)GET_SHADOW_GRANULAR(addr, TIMESTAMP_SIZE_IN_POWER_OF_TWO,
+                                      granularity);
+    slamp::shadow_for_each_stamp(
+        s, slamp::shadow_slots(addr, size, granularity),
+        [&](const TS ts) { log(ts, instr); });
+  });
+}
+
+void BatchDependenceModule::store(uint32_t instr, uint64_t addr,
+                                  uint32_t size) {
+  // the store instruction is the 20 bits above the time
+  assert(instr < (1u << 20) && "instruction ID does not fit in a time stamp");
+  local_write_range(addr, size, [&](const uint64_t addr, const uint32_t size) {
+    TS *s = (TS *)GET_SHADOW_GRANULAR(addr, TIMESTAMP_SIZE_IN_POWER_OF_TWO,
+                                      granularity);
+    slamp::shadow_fill(s, ((TS)instr << 44) | time,
+                       slamp::shadow_slots(addr, size, granularity));
+  });
+}
+
+void BatchDependenceModule::loop_invoc(uint32_t loop_id) {
+  time++;
+  stack.push_back({loop_id, time, time, &deps[loop_id]});
+}
+
+void BatchDependenceModule::loop_iter(uint32_t loop_id) {
+  time++;
+  if (!stack.empty())
+    stack.back().iteration_time = time;
+}
+
+// a loop left without its exit event (longjmp, exceptions) is popped with
+// the loop around it
+void BatchDependenceModule::loop_exit(uint32_t loop_id) {
+  auto it = std::find_if(stack.rbegin(), stack.rend(),
+                         [&](const ActiveLoop &l) { return l.loop_id == loop_id; });
+  if (it != stack.rend())
+    stack.erase(std::next(it).base(), stack.end());
+}
+
+void BatchDependenceModule::merge_dep(BatchDependenceModule &other) {
+  for (auto &[loop_id, d] : other.deps)
+    deps[loop_id].merge(d);
+}
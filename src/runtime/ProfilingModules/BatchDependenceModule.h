@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "parallel_hashmap/phmap.h"
+#include "slamp_logger.h"
+#include "slamp_profile.h"
+#include "slamp_shadow_access.h"
+#include "slamp_shadow_mem.h"
+#include "slamp_timestamp.h"
+
+#include "LocalWriteModule.h"
+
+enum class BatchDepModAction : uint32_t {
+  INIT = 0,
+  LOAD,
+  STORE,
+  ALLOC,
+  LOOP_INVOC,
+  LOOP_ITER,
+  LOOP_EXIT,
+  FINISHED,
+};
+
+// Dependence module of the batch mode (-slamp-target-loops): all the
+// candidate loops of the program are profiled in one run, each with its own
+// dependences, as DependenceModule does for one target loop.
+//
+// The shadow memory is shared by the loops. Instead of the iteration and
+// invocation of one loop, a store records the global time, which moves on at
+// every invocation and iteration of any target loop. A loop on the stack
+// knows when its current invocation and iteration started, so the time of
+// the last store tells, for each loop the load is in, whether the dependence
+// is in the same invocation, and whether it is loop-carried.
+class BatchDependenceModule : public LocalWriteModule {
+private:
+  using Deps = phmap::flat_hash_set<slamp::KEY, slamp::KEYHash, slamp::KEYEqual>;
+
+  // the time is 44 bits, the store instruction the 20 above it as in TS
+  static constexpr uint64_t TIME_MASK = (1ULL << 44) - 1;
+
+  struct ActiveLoop {
+    uint32_t loop_id;
+    uint64_t invocation_time;
+    uint64_t iteration_time;
+    Deps *deps;
+  };
+
+  uint64_t time = 1;
+  // the target loops being executed, outermost first
+  std::vector<ActiveLoop> stack;
+  // node based, the stack points into it
+  phmap::node_hash_map<uint32_t, Deps> deps;
+
+  slamp::MemoryMap<MASK2> *smmap = nullptr;
+  // log2 of the data bytes per shadow slot
+  const unsigned granularity;
+
+  void log(TS ts, uint32_t dst_inst);
+
+public:
+  // exact as long as the accesses cover whole slots; otherwise the bytes of
+  // a slot share their last store
+  static constexpr unsigned MAX_SHADOW_GRANULARITY = 64;
+
+  BatchDependenceModule(uint32_t mask, uint32_t pattern,
+                        unsigned granularity = 0)
+      : LocalWriteModule(mask, pattern,
+                         slamp::local_write_shift(
+                             TIMESTAMP_SIZE_IN_POWER_OF_TWO, granularity)),
+        granularity(granularity) {
+    smmap = new slamp::MemoryMap<MASK2>(mask, pattern, sizeof(TS), granularity);
+  }
+
+  ~BatchDependenceModule() override { delete smmap; }
+
+  void init(uint32_t loop_id, uint32_t pid);
+  // place the shadow memory on `node` (--numa-bind-shadow)
+  void bind_shadow(int node) { smmap->bind_to_node(node); }
+  void set_page_owners(slamp::PageOwners *o) override {
+    LocalWriteModule::set_page_owners(o);
+    smmap->set_page_owners(o);
+  }
+  void fini(const char *filename);
+  void dump(slamp::ProfileWriter &writer);
+  uint64_t accumulate(const slamp::ProfileReader &reader);
+  void load(uint32_t instr, uint64_t addr, uint32_t size);
+  void store(uint32_t instr, uint64_t addr, uint32_t size);
+  void allocate(void *addr, uint64_t size);
+  void loop_invoc(uint32_t loop_id);
+  void loop_iter(uint32_t loop_id);
+  void loop_exit(uint32_t loop_id);
+
+  void merge_dep(BatchDependenceModule &other);
+};
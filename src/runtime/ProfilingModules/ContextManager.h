@@ -10,13 +10,6 @@
 #include <vector>
 
 
-// namespace SpecPrivLib {
-// enum SpecPrivContextType {
-  // TopContext = 0,
-  // FunctionContext,
-  // LoopContext,
-// };
-
 #define CONTEXT_DEBUG 0
 
 template <class TypeEnum, typename MetaIdType>
@@ -116,6 +109,13 @@ public:
     }
   }
 
+  // follow a context that was pushed and encoded by another manager (the
+  // control timeline of the unified workflow); the stack is not updated
+  void setActiveContext(HashType hash) {
+    cached = true;
+    cachedContextHash = hash;
+  }
+
   HashType encodeActiveContext() {
     if (cached) {
       return cachedContextHash;
@@ -140,3 +140,12 @@ public:
     }
   }
 };
+
+// the contexts of the SpecPriv profiles (points-to, object lifetime)
+enum SpecPrivContextType {
+  TopContext = 0,
+  FunctionContext,
+  LoopContext,
+};
+using SpecPrivContextManager =
+    NewContextManager<SpecPrivContextType, uint32_t, uint64_t>;
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ContextManager.h"
+
+// The control state right after a control event (loop and function
+// entry/exit, target loop invocation/iteration)
+struct ControlStamp {
+  uint64_t index;       // of the event packet in the queue buffer
+  uint64_t iteration;   // of the target loop
+  uint64_t invocation;  // of the target loop
+  uint64_t context;     // function and loop contexts, in `contexts`
+  uint64_t fcn_context; // function contexts only, in `fcnContexts`
+  uint32_t callee;      // function called directly in the target loop, or 0
+  int nested_level;     // of the target loop invocations
+  bool in_loop;         // between the target loop invocation and its exit
+};
+
+// In the unified workflow every module thread sees every event. Instead of
+// each of them replaying the control events (and keeping its own context
+// managers), the thread handing out a queue buffer replays them once and
+// stamps the state after each event; the module threads look the stamps up.
+class ControlTimeline {
+  ControlStamp state = {};
+
+  void stamp(uint64_t index) {
+    state.index = index;
+    state.context = contexts.encodeActiveContext();
+    state.fcn_context = fcnContexts.encodeActiveContext();
+    stamps.push_back(state);
+  }
+
+public:
+  SpecPrivContextManager contexts, fcnContexts;
+  // of the current buffer, in packet order
+  std::vector<ControlStamp> stamps;
+
+  void clear() { stamps.clear(); }
+
+  void loop_invoc(uint64_t index) {
+    state.iteration = 0;
+    state.invocation++;
+    state.nested_level++;
+    state.in_loop = true;
+    stamp(index);
+  }
+
+  void loop_iter(uint64_t index) {
+    state.iteration++;
+    stamp(index);
+  }
+
+  void loop_exit(uint64_t index) {
+    state.nested_level--;
+    state.in_loop = false;
+    stamp(index);
+  }
+
+  void func_entry(uint64_t index, uint32_t fcnId) {
+    contexts.pushContext({FunctionContext, fcnId});
+    fcnContexts.pushContext({FunctionContext, fcnId});
+    if (state.nested_level == 1)
+      state.callee = fcnId;
+    stamp(index);
+  }
+
+  void func_exit(uint64_t index, uint32_t fcnId) {
+    contexts.popContext({FunctionContext, fcnId});
+    fcnContexts.popContext({FunctionContext, fcnId});
+    if (state.nested_level == 1)
+      state.callee = 0;
+    stamp(index);
+  }
+
+  void loop_entry(uint64_t index, uint32_t loopId) {
+    contexts.pushContext({LoopContext, loopId});
+    stamp(index);
+  }
+
+  void loop_exit(uint64_t index, uint32_t loopId) {
+    contexts.popContext({LoopContext, loopId});
+    stamp(index);
+  }
+
+  // the stamp of the control event at `index`; a thread keeps a `cursor`
+  // per buffer, so it can skip the control events it does not care about
+  const ControlStamp &at(uint64_t index, uint64_t &cursor) const {
+    while (stamps[cursor].index < index)
+      cursor++;
+    return stamps[cursor];
+  }
+};
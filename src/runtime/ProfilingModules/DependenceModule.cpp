@@ -1,11 +1,21 @@
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <fstream>
+#include <iostream>
 #include <map>
+#include <memory>
+#include <queue>
 #include <set>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <tuple>
 #include <unordered_set>
 #include <vector>
 
+#include <unistd.h>
+
 #include "DependenceModule.h"
 #include "slamp_logger.h"
 #include "slamp_shadow_mem.h"
@@ -28,6 +38,34 @@ void DependenceModule::init(uint32_t loop_id, uint32_t pid)
   // inst_count = new std::map<uint32_t, uint64_t>();
 }
 
+// a rough upper bound of the memory of one dependence, with the slack of the
+// hash tables while they grow
+static constexpr uint64_t DEP_ENTRY_BYTES = 64;
+
+void DependenceModule::set_spill_budget(uint64_t bytes,
+                                        const std::string &dir) {
+  static std::atomic<unsigned> next_spill_id(0);
+
+  spill_limit = bytes / DEP_ENTRY_BYTES;
+  spill_dir = dir;
+  spill_id = next_spill_id++;
+}
+
+static uint32_t profile_flags() {
+  uint32_t flags = 0;
+#ifdef TRACK_COUNT
+  flags |= slamp::PROFILE_HAS_COUNT;
+#endif
+#ifdef TRACK_MIN_DISTANCE
+  flags |= slamp::PROFILE_HAS_MIN_DISTANCE;
+#endif
+  return flags;
+}
+
+static auto record_key(const slamp::DependenceRecord &r) {
+  return std::tie(r.src, r.dst, r.dst_bare, r.cross);
+}
+
 // static uint64_t log_time = 0;
 
 void DependenceModule::fini(const char *filename) {
@@ -38,30 +76,18 @@ void DependenceModule::fini(const char *filename) {
   of << target_loop_id << " " << 0 << " " << 0 << " " << 0 << " " << 0 << " "
      << 0 << "\n";
 
-#ifdef TRACK_COUNT
-  // get all the keys of a hash table to ordered set
-  std::set<slamp::KEY, slamp::KEYComp> ordered;
-  for (auto &it : deps) {
-    ordered.insert(it.first);
-  }
-#else
-  std::set<slamp::KEY, slamp::KEYComp> ordered(deps.begin(), deps.end());
-#endif
-
-  for (auto &k : ordered) {
-#ifdef TRACK_COUNT
-    auto count = deps[k];
-#else
-    auto count = 1;
-#endif
-    of << target_loop_id << " " << k.src << " " << k.dst << " " << k.dst_bare
-       << " " << (k.cross ? 1 : 0) << " " << count << " ";
+  auto print = [&](const slamp::DependenceRecord &r) {
+    of << target_loop_id << " " << r.src << " " << r.dst << " " << r.dst_bare
+       << " " << r.cross << " " << r.count << " ";
 #ifdef TRACK_MIN_DISTANCE
-    auto dist = min_dist[k];
-    of << dist;
+    of << r.min_distance;
 #endif
     of << "\n";
-  }
+  };
+
+  // stream the merged runs, never holding all of them in memory
+  merge_runs(print, sorted_records());
+  remove_runs();
   of.close();
 
   // std::cout << "Log time: " << log_time/ 2.6e9 << " s" << std::endl;
@@ -79,6 +105,184 @@ void DependenceModule::fini(const char *filename) {
 #endif
 }
 
+// binary counterpart of `fini`
+void DependenceModule::dump(slamp::ProfileWriter &writer) {
+  std::vector<slamp::DependenceRecord> records;
+  merge_runs([&](const slamp::DependenceRecord &r) { records.push_back(r); },
+             sorted_records());
+  remove_runs();
+
+  writer.addSection(slamp::ProfileSection::DEPENDENCE, records, target_loop_id,
+                    profile_flags());
+}
+
+std::vector<slamp::DependenceRecord> DependenceModule::sorted_records() {
+  std::vector<slamp::DependenceRecord> records;
+  for (auto &it : deps) {
+#ifdef TRACK_COUNT
+    auto &k = it.first;
+    uint64_t count = it.second;
+#else
+    auto &k = it;
+    uint64_t count = 1;
+#endif
+    slamp::DependenceRecord record{
+        k.src, k.dst, k.dst_bare, k.cross ? 1u : 0u, count, 0, 0};
+#ifdef TRACK_MIN_DISTANCE
+    record.min_distance = min_dist[k];
+#endif
+    records.push_back(record);
+  }
+
+  std::sort(records.begin(), records.end(),
+            [](const slamp::DependenceRecord &a,
+               const slamp::DependenceRecord &b) {
+              return record_key(a) < record_key(b);
+            });
+  return records;
+}
+
+inline uint64_t DependenceModule::dep_count() {
+#ifdef TRACK_COUNT
+  return deps.map.size(); // without the buffer, close enough for the budget
+#else
+  return deps.size();
+#endif
+}
+
+// write the dependences so far as a sorted run and start over
+void DependenceModule::spill() {
+  slamp::ProfileWriter writer;
+  writer.addSection(slamp::ProfileSection::DEPENDENCE, sorted_records(),
+                    target_loop_id, profile_flags());
+  deps.clear();
+#ifdef TRACK_MIN_DISTANCE
+  min_dist.clear();
+#endif
+
+  // a run is a complete profile, so the partial result survives a killed run
+  // and can be read with profile_convert or `consumer --accumulate`
+  std::string run = spill_dir + "/deplog." + std::to_string(getpid()) + "." +
+                    std::to_string(spill_id) + "." +
+                    std::to_string(runs.size()) + ".prof";
+  if (!writer.write(run.c_str()))
+    exit(-1);
+  runs.push_back(run);
+}
+
+// k-way merge of the runs, the dependences still in memory (`resident`,
+// sorted) and the profile of `accumulate` in key order; the records of the
+// same dependence are combined before `emit`. Returns the number of
+// dependences that are not in the previous profile
+template <typename F>
+uint64_t DependenceModule::merge_runs(
+    F emit, const std::vector<slamp::DependenceRecord> &resident) {
+  std::vector<std::unique_ptr<slamp::ProfileReader>> readers;
+  std::vector<slamp::ProfileSpan<slamp::DependenceRecord>> spans;
+  for (auto &run : runs) {
+    auto reader = std::make_unique<slamp::ProfileReader>();
+    if (!reader->open(run.c_str()))
+      exit(-1);
+    spans.push_back(reader->records<slamp::DependenceRecord>(
+        slamp::ProfileSection::DEPENDENCE));
+    readers.push_back(std::move(reader));
+  }
+  spans.push_back({resident.data(), resident.size()});
+  const size_t previous_run = spans.size();
+  spans.push_back(previous);
+
+  // (run, position), the smallest record on top
+  using Cursor = std::pair<size_t, uint64_t>;
+  auto greater = [&](const Cursor &a, const Cursor &b) {
+    return record_key(spans[a.first][a.second]) >
+           record_key(spans[b.first][b.second]);
+  };
+  std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(
+      greater);
+  for (size_t i = 0; i < spans.size(); i++) {
+    if (!spans[i].empty())
+      heap.push({i, 0});
+  }
+
+  uint64_t added = 0;
+  bool pending = false;
+  // whether the current dependence is in the previous profile, and whether
+  // its distance is known (the profile may not have them)
+  bool in_previous = false;
+  bool has_distance = false;
+  slamp::DependenceRecord current{};
+  while (!heap.empty()) {
+    auto [run, pos] = heap.top();
+    heap.pop();
+    auto &r = spans[run][pos];
+    if (pos + 1 < spans[run].size())
+      heap.push({run, pos + 1});
+
+    const bool from_previous = run == previous_run;
+    const bool distance = !from_previous || previous_min_distance;
+    if (pending && record_key(current) == record_key(r)) {
+#ifdef TRACK_COUNT
+      current.count += r.count;
+#endif
+      if (distance)
+        current.min_distance = has_distance
+                                   ? std::min(current.min_distance,
+                                              r.min_distance)
+                                   : r.min_distance;
+      in_previous |= from_previous;
+      has_distance |= distance;
+      continue;
+    }
+    if (pending) {
+      added += !in_previous;
+      emit(current);
+    }
+    current = r;
+    pending = true;
+    in_previous = from_previous;
+    has_distance = distance;
+  }
+  if (pending) {
+    added += !in_previous;
+    emit(current);
+  }
+  return added;
+}
+
+void DependenceModule::remove_runs() {
+  for (auto &run : runs)
+    unlink(run.c_str());
+  runs.clear();
+}
+
+// fold in a previous binary profile, returns the number of dependences that
+// are not in it. The profile is one more sorted run of the merge in
+// `fini`/`dump`, it is never loaded into the hash table
+uint64_t DependenceModule::accumulate(const slamp::ProfileReader &reader) {
+  auto *section = reader.findSection(slamp::ProfileSection::DEPENDENCE);
+  if (section) {
+    if (target_loop_id == 0)
+      target_loop_id = section->loop_id;
+    previous = reader.records<slamp::DependenceRecord>(*section);
+    previous_min_distance = section->flags & slamp::PROFILE_HAS_MIN_DISTANCE;
+
+    // `dump` writes each dependence once, in key order
+    auto unordered = std::adjacent_find(
+        previous.begin(), previous.end(),
+        [](const slamp::DependenceRecord &a, const slamp::DependenceRecord &b) {
+          return !(record_key(a) < record_key(b));
+        });
+    if (unordered != previous.end()) {
+      std::cerr << "accumulate: the dependences of the profile are not sorted"
+                << std::endl;
+      exit(-1);
+    }
+  }
+
+  // only count, the merge is done again when the result is written
+  return merge_runs([](const slamp::DependenceRecord &) {}, sorted_records());
+}
+
 void DependenceModule::allocate(void *addr, uint64_t size)
     __attribute__((always_inline)) {
   smmap->allocate(addr, size);
@@ -105,6 +309,8 @@ void DependenceModule::log(TS ts, const uint32_t dst_inst,
 #endif
 
   deps.emplace(key);
+  if (spill_limit && dep_count() >= spill_limit)
+    spill();
 
 #ifdef COLLECT_TRACE
   if (dep_trace_idx < dep_trace_size) {
@@ -115,22 +321,32 @@ void DependenceModule::log(TS ts, const uint32_t dst_inst,
 }
 
 void DependenceModule::load(uint32_t instr, const uint64_t addr,
-                            const uint32_t bare_instr)
+                            const uint32_t bare_instr, const uint32_t size)
     __attribute__((always_inline)) {
-  local_write(addr, [&]() {
+#ifdef TRACK_WAR
+  const uint32_t span = 1;
+#else
+  const uint32_t span = size;
+#endif
+  local_write_range(addr, span, [&](const uint64_t addr, const uint32_t size) {
     // load_count++;
 
     // if tracking multiple loops
 
-    TS *s = (TS *)GET_SHADOW(addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2);
+    TS *s = (TS *)GET_SHADOW_GRANULAR(addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2,
+                                      granularity);
 
+#ifdef TRACK_WAR
+    // the read stamps are interleaved, only the first byte is tracked
     TS tss = s[0];
     if (tss != 0) {
-      // uint64_t start = rdtsc();
       log(tss, instr, context);
-      // uint64_t end = rdtsc();
-      // log_time += end - start;
     }
+#else
+    slamp::shadow_for_each_stamp(
+        s, slamp::shadow_slots(addr, size, granularity),
+        [&](const TS tss) { log(tss, instr, context); });
+#endif
 #ifdef TRACK_WAR
     if (context != 0) {
       instr = context;
@@ -142,20 +358,29 @@ void DependenceModule::load(uint32_t instr, const uint64_t addr,
 }
 
 void DependenceModule::store(uint32_t instr, uint32_t bare_instr,
-                             const uint64_t addr)
+                             const uint64_t addr, const uint32_t size)
     __attribute__((always_inline)) {
-
-  local_write(addr, [&]() {
+#ifdef TRACK_WAR
+  const uint32_t span = 1;
+#else
+  const uint32_t span = size;
+#endif
+  local_write_range(addr, span, [&](const uint64_t addr, const uint32_t size) {
     // store_count++;
-    TS *shadow_addr = (TS *)GET_SHADOW(addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2);
+    TS *shadow_addr = (TS *)GET_SHADOW_GRANULAR(
+        addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2, granularity);
+    const uint32_t slots = slamp::shadow_slots(addr, size, granularity);
 
-#ifdef TRACK_WAW
+#if defined(TRACK_WAW) && defined(TRACK_WAR)
     if (shadow_addr[0] != 0) {
       // uint64_t start = rdtsc();
       log(shadow_addr[0], instr, context);
       // uint64_t end = rdtsc();
       // log_time += end - start;
     }
+#elif defined(TRACK_WAW)
+    slamp::shadow_for_each_stamp(
+        shadow_addr, slots, [&](const TS tss) { log(tss, instr, context); });
 #endif
 
 #ifdef TRACK_WAR
@@ -171,7 +396,11 @@ void DependenceModule::store(uint32_t instr, uint32_t bare_instr,
       instr = context;
     }
     TS ts = CREATE_TS(instr, slamp_iteration, slamp_invocation);
+#ifdef TRACK_WAR
     shadow_addr[0] = ts;
+#else
+    slamp::shadow_fill(shadow_addr, ts, slots);
+#endif
   });
 }
 
@@ -202,9 +431,60 @@ void DependenceModule::func_exit(uint32_t instr) {
   }
 }
 
+void DependenceModule::set_control(const ControlStamp &stamp) {
+  slamp_iteration = stamp.iteration;
+  slamp_invocation = stamp.invocation;
+  nested_level = stamp.nested_level;
+  context = stamp.callee;
+}
+
 void DependenceModule::merge_dep(DependenceModule &other) {
+  if (target_loop_id == 0)
+    target_loop_id = other.target_loop_id;
   deps.merge(other.deps);
 #ifdef TRACK_MIN_DISTANCE
   min_dist.merge(other.min_dist);
 #endif
+
+  // the runs are merged at the end
+  runs.insert(runs.end(), other.runs.begin(), other.runs.end());
+  other.runs.clear();
+  if (spill_limit && dep_count() >= spill_limit)
+    spill();
+}
+
+// the inverse of `fini`, so logs of separate runs (e.g., the slices of the
+// epoch-parallel mode) can be combined with `merge_dep`
+void DependenceModule::load_log(const char *filename) {
+  std::ifstream ifs(filename);
+  if (!ifs.is_open()) {
+    std::cerr << "Cannot open " << filename << std::endl;
+    exit(-1);
+  }
+
+  // header: loop 0 0 0 0 0
+  std::string line;
+  if (!std::getline(ifs, line))
+    return;
+  std::istringstream(line) >> target_loop_id;
+
+  while (std::getline(ifs, line)) {
+    std::istringstream iss(line);
+    uint32_t loop, src, dst, dst_bare, cross;
+    uint64_t count;
+    if (!(iss >> loop >> src >> dst >> dst_bare >> cross >> count))
+      continue;
+
+    slamp::KEY key(src, dst, dst_bare, cross);
+#ifdef TRACK_COUNT
+    deps[key] += count;
+#else
+    deps.emplace(key);
+#endif
+#ifdef TRACK_MIN_DISTANCE
+    uint32_t dist;
+    if (iss >> dist)
+      min_dist.emplace({key, dist});
+#endif
+  }
 }
@@ -1,12 +1,16 @@
 #include <cstdint>
 #include <mutex>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
 #include "slamp_logger.h"
+#include "slamp_profile.h"
+#include "slamp_shadow_access.h"
 #include "slamp_shadow_mem.h"
 #include "slamp_timestamp.h"
 
+#include "ControlTimeline.h"
 #include "HTContainer.h"
 #include "LocalWriteModule.h"
 
@@ -59,6 +63,8 @@ private:
 #endif
 
   slamp::MemoryMap<MASK2> *smmap = nullptr;
+  // log2 of the data bytes per shadow slot
+  const unsigned granularity;
 
 #ifdef TRACK_COUNT
   HTMap_Sum<slamp::KEY, slamp::KEYHash, slamp::KEYEqual, 16> deps;
@@ -71,13 +77,38 @@ private:
   HTMap_Min<slamp::KEY, slamp::KEYHash, slamp::KEYEqual, 16> min_dist;
 #endif
 
+  // with a budget, the dependences are spilled as sorted runs (binary
+  // profiles) once they outgrow it, and k-way merged at the end
+  uint64_t spill_limit = 0; // in dependences, 0 keeps everything in memory
+  std::string spill_dir;
+  unsigned spill_id = 0;
+  std::vector<std::string> runs;
+  // the dependences of the profile of `accumulate`, merged as one more run
+  slamp::ProfileSpan<slamp::DependenceRecord> previous;
+  bool previous_min_distance = false;
+
   void log(TS ts, const uint32_t dst_inst, const uint32_t bare_inst);
 
+  uint64_t dep_count();
+  std::vector<slamp::DependenceRecord> sorted_records();
+  void spill();
+  template <typename F>
+  uint64_t merge_runs(F emit,
+                      const std::vector<slamp::DependenceRecord> &resident);
+  void remove_runs();
+
 public:
-  DependenceModule(uint32_t mask, uint32_t pattern)
-      : LocalWriteModule(mask, pattern) {
-    smmap =
-        new slamp::MemoryMap<MASK2>(mask, pattern, DM_TIMESTAMP_SIZE_IN_BYTES);
+  // exact as long as the accesses cover whole slots; otherwise the bytes of
+  // a slot share their last store
+  static constexpr unsigned MAX_SHADOW_GRANULARITY = 64;
+
+  DependenceModule(uint32_t mask, uint32_t pattern, unsigned granularity = 0)
+      : LocalWriteModule(mask, pattern,
+                         slamp::local_write_shift(
+                             DM_TIMESTAMP_SIZE_IN_BYTES_LOG2, granularity)),
+        granularity(granularity) {
+    smmap = new slamp::MemoryMap<MASK2>(
+        mask, pattern, DM_TIMESTAMP_SIZE_IN_BYTES, granularity);
 #ifdef COLLECT_TRACE
     dep_trace.reserve(dep_trace_size + 10); // 10M
 #endif
@@ -86,15 +117,31 @@ public:
   ~DependenceModule() override { delete smmap; }
 
   void init(uint32_t loop_id, uint32_t pid);
+  // place the shadow memory on `node` (--numa-bind-shadow)
+  void bind_shadow(int node) { smmap->bind_to_node(node); }
+  void set_page_owners(slamp::PageOwners *o) override {
+    LocalWriteModule::set_page_owners(o);
+    smmap->set_page_owners(o);
+  }
+  void set_spill_budget(uint64_t bytes, const std::string &dir);
   void fini(const char *filename);
-  void load(uint32_t instr, const uint64_t addr, const uint32_t bare_instr);
-  void store(uint32_t instr, uint32_t bare_instr, const uint64_t addr);
+  void dump(slamp::ProfileWriter &writer);
+  uint64_t accumulate(const slamp::ProfileReader &reader);
+  // `size` bytes from `addr`, each byte has its own time stamp
+  void load(uint32_t instr, const uint64_t addr, const uint32_t bare_instr,
+            const uint32_t size);
+  void store(uint32_t instr, uint32_t bare_instr, const uint64_t addr,
+             const uint32_t size);
   void allocate(void *addr, uint64_t size);
   void loop_invoc();
   void loop_iter();
   void loop_exit();
   void func_entry(uint32_t context);
   void func_exit(uint32_t context);
+  // unified workflow: the control state comes from the shared timeline
+  void set_control(const ControlStamp &stamp);
 
   void merge_dep(DependenceModule &other);
+  // load the dependences of a log written by `fini`
+  void load_log(const char *filename);
 };
@@ -61,6 +61,9 @@ private:
   void log(TS ts, const uint32_t dst_inst, const uint32_t bare_inst);
 
 public:
+  // the context is kept per byte, a coarser shadow is not wired up
+  static constexpr unsigned MAX_SHADOW_GRANULARITY = 1;
+
   DependenceWithContextModule(uint32_t mask, uint32_t pattern)
       : LocalWriteModule(mask, pattern) {
     smmap =
@@ -73,6 +76,12 @@ public:
   ~DependenceWithContextModule() override { delete smmap; }
 
   void init(uint32_t loop_id, uint32_t pid);
+  // place the shadow memory on `node` (--numa-bind-shadow)
+  void bind_shadow(int node) { smmap->bind_to_node(node); }
+  void set_page_owners(slamp::PageOwners *o) override {
+    LocalWriteModule::set_page_owners(o);
+    smmap->set_page_owners(o);
+  }
   void fini(const char *filename);
   void load(uint32_t instr, const uint64_t addr, const uint32_t bare_instr);
   void store(uint32_t instr, uint32_t bare_instr, const uint64_t addr);
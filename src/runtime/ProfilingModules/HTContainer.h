@@ -7,11 +7,13 @@
  *
  */
 #pragma once
+#include <algorithm>
 #include <condition_variable>
 #include <fstream>
 #include <iostream>
 #include <mutex>
 #include <thread>
+#include <tuple>
 #include <unistd.h>
 #include <vector>
 
@@ -67,7 +69,10 @@ private:
       // set_chunk->reserve(set_size);
 
       auto begin = id * (buffer_size / thread_count);
-      auto end = (id + 1) * (buffer_size / thread_count);
+      // the last chunk takes the remainder as well
+      auto end = id == thread_count - 1
+                     ? buffer_size
+                     : (id + 1) * (buffer_size / thread_count);
 
       set_chunk->insert(buffer.begin() + begin, buffer.begin() + end);
 
@@ -267,7 +272,10 @@ private:
             set_chunk->reserve(set_size);
 
             auto begin = id * (buffer_size / thread_count);
-            auto end = (id + 1) * (buffer_size / thread_count);
+            // the last chunk takes the remainder as well
+            auto end = id == thread_count - 1
+                           ? buffer_size
+                           : (id + 1) * (buffer_size / thread_count);
 
             set_chunk->insert(buffer.begin() + begin, buffer.begin() + end);
 
@@ -318,7 +326,10 @@ private:
       const auto buffer_size = buffer.size();
 
       auto begin = id * (buffer_size / thread_count);
-      auto end = (id + 1) * (buffer_size / thread_count);
+      // the last chunk takes the remainder as well
+      auto end = id == thread_count - 1
+                     ? buffer_size
+                     : (id + 1) * (buffer_size / thread_count);
 
       // for each element in the chunk, insert into the map, and increment the
       // count from begin to end
@@ -439,6 +450,13 @@ public:
     return map[key];
   }
 
+  // drop everything, e.g., after spilling to disk
+  void clear() {
+    convertVectorToSet();
+    buffer.clear();
+    map.clear();
+  }
+
   void merge(MyType &other) { merge(other.begin(), other.end()); }
 
   // insert (begin, end)
@@ -517,6 +535,8 @@ private:
           it->second++;
         }
       }
+      // counted, do not count again on the next call
+      buffer.clear();
       return;
     }
 
@@ -541,6 +561,7 @@ private:
         break;
       }
     }
+    buffer.clear();
 #endif
 
 #ifndef HT_THREAD_POOL
@@ -563,6 +584,8 @@ private:
 #ifdef HT_THREAD_POOL
   bool should_terminate = false; // Tells threads to stop looking for jobs
   bool should_gather = false;
+  // the thread chunks hold entries that are not gathered into `map` yet
+  bool pending_chunks = false;
   std::mutex queue_mutex; // Prevents data races to the job queue
   std::condition_variable
       mutex_condition; // Allows threads to wait on new jobs or termination
@@ -581,7 +604,10 @@ private:
       const auto buffer_size = buffer.size();
 
       auto begin = id * (buffer_size / thread_count);
-      auto end = (id + 1) * (buffer_size / thread_count);
+      // the last chunk takes the remainder as well
+      auto end = id == thread_count - 1
+                     ? buffer_size
+                     : (id + 1) * (buffer_size / thread_count);
 
       // for each element in the chunk, insert into the map, and take min
       for (auto it_buffer = buffer.begin() + begin;
@@ -724,6 +750,13 @@ public:
     return map[key];
   }
 
+  // drop everything, e.g., after spilling to disk
+  void clear() {
+    convertVectorToSet(true);
+    buffer.clear();
+    map.clear();
+  }
+
   void merge(MyType &other) { merge(other.begin(), other.end()); }
 
   // insert (begin, end)
@@ -791,7 +824,7 @@ private:
     const auto set_size = buffer.size() / thread_count;
     const auto buffer_size = buffer.size();
 
-    if (buffer_size == 0) {
+    if (buffer_size == 0 && !(gather && pending_chunks)) {
       return;
     }
 
@@ -839,6 +872,7 @@ private:
       }
     }
     should_gather = false;
+    pending_chunks = !gather;
 #endif
 
 #ifndef HT_THREAD_POOL
@@ -859,10 +893,42 @@ public:
   constexpr static TV MAGIC_INVALID = 0xbeefdeadbeefdead;
   void Start() {}
 
+#ifndef PB
+  static_assert(false, "PB is not defined, HTMap_IsConstant partitions the "
+                       "submaps of phmap");
+#endif
+
+  // the map is split by key hash into 2^SUBMAP_BITS submaps; a flush hands
+  // whole submaps to each pool thread, so the threads own disjoint keys and
+  // write the map without a lock
+  constexpr static size_t SUBMAP_BITS = 8;
+  using base_map_t = phmap::parallel_flat_hash_map<
+      TK, TV, Hash, KeyEqual,
+      phmap::priv::Allocator<phmap::priv::Pair<const TK, TV>>, SUBMAP_BITS>;
+  struct hash_map_t : base_map_t {
+    using base_map_t::base_map_t;
+    using base_map_t::subidx;
+  };
+
 private:
+  using buffer_item_t = std::pair<TK, TV>;
+
+  // a buffer entry tagged with its hash and the thread owning its submap
+  struct batch_item_t {
+    size_t hash;
+    TV value;
+    uint32_t index; // into `buffer`
+    uint32_t owner;
+  };
+
+  // the pool threads prepare a slice of the buffer each, then insert the
+  // entries of their submaps from all the slices
+  enum class Phase { PREPARE, INSERT };
+
 #ifdef HT_THREAD_POOL
   bool should_terminate = false; // Tells threads to stop looking for jobs
-  bool should_gather = false;
+  Phase phase = Phase::PREPARE;
+  uint32_t active_threads = 1;
   std::mutex queue_mutex; // Prevents data races to the job queue
   std::condition_variable
       mutex_condition; // Allows threads to wait on new jobs or termination
@@ -873,55 +939,6 @@ private:
   std::vector<bool> ready;
 
   void ThreadLoop(const int id) {
-    auto map_chunk = std::make_unique<hash_map_t>();
-
-    const auto thread_count = MAX_THREAD;
-    auto job = [&]() {
-      const auto set_size = buffer.size() / thread_count;
-      const auto buffer_size = buffer.size();
-
-      auto begin = id * (buffer_size / thread_count);
-      auto end = (id + 1) * (buffer_size / thread_count);
-
-      // for each element in the chunk, insert into the map, and set invalid
-      // if not same
-      for (auto it_buffer = buffer.begin() + begin;
-           it_buffer != buffer.begin() + end; ++it_buffer) {
-        auto &key = it_buffer->first;
-        auto &value = it_buffer->second;
-
-        auto it = map_chunk->find(key);
-        if (it == map_chunk->end()) {
-          map_chunk->insert({key, value});
-        } else {
-          // check if value is the same
-          if (it->second != MAGIC_INVALID && it->second != value) {
-            it->second = MAGIC_INVALID;
-          }
-        }
-      }
-
-      if (should_gather) {
-        m.lock();
-        // std::cout << "thread " << id << " is gathering" << std::endl;
-        // lock the global set and insert the chunk
-        // merge the map_chunk into the global map
-        for (auto it = map_chunk->begin(); it != map_chunk->end(); ++it) {
-          auto global_it = map.find(it->first);
-          if (global_it == map.end()) {
-            map.insert({it->first, it->second});
-          } else {
-            // check if value is the same
-            if (global_it->second != MAGIC_INVALID &&
-                global_it->second != it->second) {
-              global_it->second = MAGIC_INVALID;
-            }
-          }
-        }
-        m.unlock();
-        map_chunk->clear();
-      }
-    };
     while (true) {
       {
         std::unique_lock<std::mutex> lock(queue_mutex);
@@ -933,25 +950,115 @@ private:
           return;
         }
         lock.unlock();
-        job();
+        if (phase == Phase::PREPARE)
+          prepare(id, active_threads);
+        else
+          insert(id, active_threads);
         lock.lock();
         ready[id * CACHELINE_SIZE] = false;
         pending_jobs--;
       }
     }
   }
+
+  void runJobs(uint32_t thread_count) {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    pending_jobs = thread_count;
+
+    for (uint32_t i = 0; i < thread_count; i++) {
+      ready[i * CACHELINE_SIZE] = true;
+    }
+    lock.unlock();
+    mutex_condition.notify_all();
+
+    // busy wait: check if all threads are done
+    while (true) {
+      if (pending_jobs == 0) {
+        break;
+      }
+    }
+  }
 #endif
 
-private:
-  using buffer_item_t = std::pair<TK, TV>;
   std::vector<buffer_item_t> buffer;
-  std::mutex m;
-  using hash_map_t = hash_map<TK, TV, Hash, KeyEqual>;
+  // per slice: the tagged entries, sorted by owner, and where each owner's
+  // entries begin
+  std::vector<std::vector<batch_item_t>> batches;
+  std::vector<std::vector<uint32_t>> owner_begin;
+
+  // Tag slice `id` of the buffer, sort it by (owner, hash, value) and drop
+  // the repeated (key, value) pairs; a constant load fills the buffer with
+  // them, the insert then sees each pair once per slice
+  void prepare(const uint32_t id, const uint32_t thread_count) {
+    const auto buffer_size = buffer.size();
+    auto begin = id * (buffer_size / thread_count);
+    // the last slice takes the remainder as well
+    auto end = id == thread_count - 1
+                   ? buffer_size
+                   : (id + 1) * (buffer_size / thread_count);
+
+    auto &batch = batches[id];
+    batch.clear();
+    batch.reserve(end - begin);
+    for (auto i = begin; i < end; i++) {
+      const auto hash = map.hash(buffer[i].first);
+      batch.push_back({hash, buffer[i].second, static_cast<uint32_t>(i),
+                       static_cast<uint32_t>(hash_map_t::subidx(hash) %
+                                             thread_count)});
+    }
+
+    std::sort(batch.begin(), batch.end(),
+              [](const batch_item_t &a, const batch_item_t &b) {
+                return std::tie(a.owner, a.hash, a.value) <
+                       std::tie(b.owner, b.hash, b.value);
+              });
+    // keys with the same hash may interleave, a pair left over is only
+    // inserted twice
+    KeyEqual eq;
+    batch.erase(std::unique(batch.begin(), batch.end(),
+                            [&](const batch_item_t &a, const batch_item_t &b) {
+                              return a.hash == b.hash && a.value == b.value &&
+                                     eq(buffer[a.index].first,
+                                        buffer[b.index].first);
+                            }),
+                batch.end());
+
+    auto &offsets = owner_begin[id];
+    offsets.assign(thread_count + 1, batch.size());
+    for (uint32_t i = batch.size(); i > 0; i--)
+      offsets[batch[i - 1].owner] = i - 1;
+    // owners without entries begin where the next one does
+    for (uint32_t owner = thread_count; owner > 0; owner--)
+      offsets[owner - 1] = std::min(offsets[owner - 1], offsets[owner]);
+  }
+
+  // insert the entries of the submaps owned by `id`, from every slice
+  void insert(const uint32_t id, const uint32_t thread_count) {
+    for (uint32_t slice = 0; slice < thread_count; slice++) {
+      auto &batch = batches[slice];
+      for (auto i = owner_begin[slice][id]; i < owner_begin[slice][id + 1];
+           i++) {
+        auto &item = batch[i];
+        auto &key = buffer[item.index].first;
+        auto it = map.lazy_emplace_with_hash(
+            key, item.hash,
+            [&](const typename hash_map_t::constructor &ctor) {
+              ctor(key, item.value);
+            });
+        // check if value is the same
+        if (it->second != MAGIC_INVALID && it->second != item.value) {
+          it->second = MAGIC_INVALID;
+        }
+      }
+    }
+  }
 
 public:
   hash_map_t map;
   HTMap_IsConstant() {
     buffer.reserve(BUFFER_SIZE);
+    batches.resize(MAX_THREAD);
+    owner_begin.resize(MAX_THREAD);
 #ifdef HT_THREAD_POOL
     const uint32_t num_threads = MAX_THREAD;
     threads.resize(num_threads);
@@ -1084,14 +1191,12 @@ private:
   inline void checkBuffer() {
     if (buffer.size() == BUFFER_SIZE) {
       convertVectorToSet();
-      buffer.resize(0);
-      buffer.reserve(BUFFER_SIZE);
     }
   }
 
+  // every entry is in `map` afterwards, there is nothing to gather
   void convertVectorToSet(bool gather = false) {
     const uint32_t thread_count = getThreadCount();
-    const auto set_size = buffer.size() / thread_count;
     const auto buffer_size = buffer.size();
 
     if (buffer_size == 0) {
@@ -1099,49 +1204,19 @@ private:
     }
 
     if (thread_count == 1) {
-      // merge the buffer to the map
-      for (auto p : buffer) {
-        auto &key = p.first;
-        auto &value = p.second;
-        auto it = map.find(key);
-
-        if (it == map.end()) {
-          map.insert({key, value});
-        } else {
-          // check if value is the same
-          if (it->second != MAGIC_INVALID && it->second != value) {
-            it->second = MAGIC_INVALID;
-          }
-        }
-      }
+      prepare(0, 1);
+      insert(0, 1);
+      buffer.clear();
       return;
     }
 
 #ifdef HT_THREAD_POOL
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    pending_jobs = thread_count;
-
-    for (uint32_t i = 0; i < thread_count; i++) {
-      ready[i * CACHELINE_SIZE] = true;
-    }
-
-    // std::cout << "pending jobs: " << pending_jobs << std::endl;
-    if (gather) {
-      should_gather = true;
-    }
-    lock.unlock();
-    mutex_condition.notify_all();
-
-    // std:: cout << "waiting for jobs to finish" << std::endl;
-
-    // busy wait: check if all threads are done
-    while (true) {
-      // std::cout << "pending jobs: " << pending_jobs << std::endl;
-      if (pending_jobs == 0) {
-        break;
-      }
-    }
-    should_gather = false;
+    active_threads = thread_count;
+    phase = Phase::PREPARE;
+    runJobs(thread_count);
+    phase = Phase::INSERT;
+    runJobs(thread_count);
+    buffer.clear();
 #endif
 
 #ifndef HT_THREAD_POOL
@@ -1163,6 +1238,8 @@ private:
 #ifdef HT_THREAD_POOL
   bool should_terminate = false; // Tells threads to stop looking for jobs
   bool should_gather = false;
+  // the thread chunks hold entries that are not gathered into `map` yet
+  bool pending_chunks = false;
   std::mutex queue_mutex; // Prevents data races to the job queue
   std::condition_variable
       mutex_condition; // Allows threads to wait on new jobs or termination
@@ -1181,7 +1258,10 @@ private:
       const auto buffer_size = buffer.size();
 
       auto begin = id * (buffer_size / thread_count);
-      auto end = (id + 1) * (buffer_size / thread_count);
+      // the last chunk takes the remainder as well
+      auto end = id == thread_count - 1
+                     ? buffer_size
+                     : (id + 1) * (buffer_size / thread_count);
 
       // for each element in the chunk, insert into the map, and set invalid
       // if not same
@@ -1384,7 +1464,7 @@ private:
     const auto set_size = buffer.size() / thread_count;
     const auto buffer_size = buffer.size();
 
-    if (buffer_size == 0) {
+    if (buffer_size == 0 && !(gather && pending_chunks)) {
       return;
     }
 
@@ -1430,6 +1510,7 @@ private:
       }
     }
     should_gather = false;
+    pending_chunks = !gather;
 #endif
 
 #ifndef HT_THREAD_POOL
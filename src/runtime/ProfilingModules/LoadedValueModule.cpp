@@ -1,4 +1,5 @@
 #include "LoadedValueModule.h"
+#include <tuple>
 #include <utility>
 
 void LoadedValueModule::init(uint32_t loop_id, uint32_t pid) {
@@ -23,6 +24,38 @@ void LoadedValueModule::fini(const char *filename) {
   specprivfs.close();
 }
 
+static_assert(slamp::PROFILE_VALUE_INVALID ==
+                  HTMap_IsConstant<AccessKey, PairHash>::MAGIC_INVALID,
+              "the profile keeps the non-constant loads as MAGIC_INVALID");
+
+// binary counterpart of `fini`; the non-constant loads are kept as well, so
+// profiles can be accumulated
+void LoadedValueModule::dump(slamp::ProfileWriter &writer) {
+  std::vector<slamp::ValueRecord> records;
+  for (auto &[key, cp] : constmap_value)
+    records.push_back({key.first, key.second, cp});
+
+  writer.addSortedSection(
+      slamp::ProfileSection::LOADED_VALUE, records,
+      [](const slamp::ValueRecord &a, const slamp::ValueRecord &b) {
+        return std::tie(a.instr, a.bare_instr) <
+               std::tie(b.instr, b.bare_instr);
+      },
+      target_loop_id);
+}
+
+// fold in a previous binary profile with the same semantics as merging two
+// threads, returns the number of loads that are not in it
+uint64_t LoadedValueModule::accumulate(const slamp::ProfileReader &reader) {
+  auto records =
+      reader.records<slamp::ValueRecord>(slamp::ProfileSection::LOADED_VALUE);
+  for (auto &r : records)
+    constmap_value.emplace(
+        std::make_pair(AccessKey(r.instr, r.bare_instr), r.value));
+
+  return constmap_value.size() - records.size();
+}
+
 void LoadedValueModule::load(uint32_t instr, const uint64_t addr, const uint32_t bare_instr, uint64_t value, uint8_t size) {
   local_write(instr, [&]() {
     AccessKey key(instr, bare_instr);
@@ -6,6 +6,7 @@
 #include "LocalWriteModule.h"
 #include "HTContainer.h"
 #include "context.h"
+#include "slamp_profile.h"
 
 enum class LoadedValueModAction : uint32_t {
   INIT = 0,
@@ -61,6 +62,8 @@ class LoadedValueModule: public GenericLocalWriteModule {
 
   void init(uint32_t loop_id, uint32_t pid);
   void fini(const char *filename);
+  void dump(slamp::ProfileWriter &writer);
+  uint64_t accumulate(const slamp::ProfileReader &reader);
   void load(uint32_t instr, const uint64_t addr, const uint32_t bare_instr, uint64_t value, uint8_t size);
 
   void merge_values(LoadedValueModule &other);
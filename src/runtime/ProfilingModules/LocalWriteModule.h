@@ -1,26 +1,60 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 
+#include "PageOwners.h"
+
 class LocalWriteModule {
 protected:
   const uint32_t LOCALWRITE_MASK{};
   const uint32_t LOCALWRITE_PATTERN{};
-  // PAGE SIZE 4096 = 2^12; FIXME: here we can make it finer because we
-  // allocate 8 bytes of metadata per one byte of data, but changes to
-  // shadow memory needed
-  static constexpr uint32_t LOCALWRITE_SHIFT = 12;
+  // PAGE SIZE 4096 = 2^12; wider with a coarse shadow, where a shadow page
+  // covers several pages (slamp::local_write_shift)
+  const uint32_t LOCALWRITE_SHIFT = 12;
+  // when set, the pages are owned through the table instead of the mask, and
+  // the pattern is the thread number
+  slamp::PageOwners *owners = nullptr;
   // takes in a lambda action and uint64_t addr
   template <typename F>
   inline void local_write(uint64_t addr, const F &action) {
+    if (owners) {
+      if (owners->claim(addr >> LOCALWRITE_SHIFT, LOCALWRITE_PATTERN))
+        action();
+      return;
+    }
     if (((addr >> LOCALWRITE_SHIFT) & LOCALWRITE_MASK) == LOCALWRITE_PATTERN) {
       action();
     }
   }
 
+  // an access of `size` bytes may run into the pages of other threads;
+  // `action(addr, size)` gets the pieces in the page groups this one owns
+  template <typename F>
+  inline void local_write_range(uint64_t addr, uint32_t size,
+                                const F &action) {
+    // nearly always within one group
+    if (size <= 1 || ((addr ^ (addr + size - 1)) >> LOCALWRITE_SHIFT) == 0) {
+      local_write(addr, [&]() { action(addr, size); });
+      return;
+    }
+
+    const uint64_t end = addr + size;
+    while (addr < end) {
+      const uint64_t next =
+          std::min(end, ((addr >> LOCALWRITE_SHIFT) + 1) << LOCALWRITE_SHIFT);
+      local_write(addr, [&]() { action(addr, (uint32_t)(next - addr)); });
+      addr = next;
+    }
+  }
+
 public:
-  LocalWriteModule(uint32_t mask, uint32_t pattern)
-      : LOCALWRITE_MASK(mask), LOCALWRITE_PATTERN(pattern) {}
+  LocalWriteModule(uint32_t mask, uint32_t pattern, uint32_t shift = 12)
+      : LOCALWRITE_MASK(mask), LOCALWRITE_PATTERN(pattern),
+        LOCALWRITE_SHIFT(shift) {}
   virtual ~LocalWriteModule() = default;
+
+  // a module with a MemoryMap passes the table on to it
+  virtual void set_page_owners(slamp::PageOwners *o) { owners = o; }
 };
 
 class GenericLocalWriteModule {
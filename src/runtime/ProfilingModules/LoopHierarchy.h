@@ -5,31 +5,52 @@
 #include <cinttypes>
 #include <cstdlib>
 #include <iostream>
-#include <iterator>
 #include <vector>
 
-// FIXME: use more modern circular buffer implementation (maybe Boost)
-#include "CircularQueue.h"
-
 #define DEBUG 0
 
 using namespace std;
-using namespace Collections;
 
 namespace Loop {
 
 static const uint64_t DEFAULT_DEPENDENCE_DISTANCE = 5;
 
+/// The time stamps of the last N iterations, inline; a new one overwrites the
+/// oldest
+template <int N> class IterationRing {
+  static_assert(N > 0, "the ring keeps at least one iteration");
+
+  uint64_t stamps[N];
+  uint32_t newest = N - 1;
+  uint32_t count = 0;
+
+public:
+  void clear() { count = 0; }
+
+  void push_back(uint64_t time_stamp) {
+    newest = newest + 1 == N ? 0 : newest + 1;
+    stamps[newest] = time_stamp;
+    if (count < N)
+      count++;
+  }
+
+  uint32_t size() const { return count; }
+
+  /// 0 is the newest, `i` < size()
+  uint64_t fromNewest(uint32_t i) const {
+    return stamps[newest >= i ? newest - i : newest + N - i];
+  }
+};
+
 template <class T, int maxDepDist = DEFAULT_DEPENDENCE_DISTANCE>
 class LoopInfo {
 public:
-  circular_buffer<uint64_t> iteration_time_stamps;
+  IterationRing<maxDepDist> iteration_time_stamps;
   uint64_t invocation_time_stamp{};
   uint32_t loop_id{};
-  uint64_t iters{}; // TRM
   T item;
 
-  LoopInfo() : iteration_time_stamps(maxDepDist), item() {}
+  LoopInfo() : item() {}
 
   void reset(uint64_t loop, uint64_t time_stamp) {
     this->loop_id = loop;
@@ -46,9 +67,11 @@ public:
   }
 };
 
-static const uint64_t DEFAULT_LOOP_DEPTH = 1048576;
+// the stack starts with this many loops and doubles when a deeper nest (or
+// recursion) shows up
+static const uint64_t DEFAULT_LOOP_DEPTH = 256;
 
-template <class T, int maxLoopDepth = DEFAULT_LOOP_DEPTH,
+template <class T, int initialLoopDepth = DEFAULT_LOOP_DEPTH,
           int maxDepDistance = DEFAULT_DEPENDENCE_DISTANCE>
 class LoopHierarchy {
 public:
@@ -62,13 +85,17 @@ public:
 
   uint32_t current_depth{static_cast<uint32_t>(-1)};
 
+  // the loops being executed, outermost (the whole program) first; the
+  // entries past `current_depth` are kept to be reused
   vector<LoopInfoType> loop_info;
 
-  LoopHierarchy() : loop_info(maxLoopDepth) { enterLoop(0, 0); }
+  LoopHierarchy() : loop_info(initialLoopDepth) { enterLoop(0, 0); }
 
   void enterLoop(uint64_t loop_id, uint64_t timestamp) {
     this->current_depth++;
-    this->loop_info.at(this->current_depth).reset(loop_id, timestamp);
+    if (this->current_depth == this->loop_info.size())
+      this->loop_info.resize(this->loop_info.size() * 2);
+    this->loop_info[this->current_depth].reset(loop_id, timestamp);
 
 #if DEBUG
     cerr << "Entering loop " << loop_id << " now at depth "
@@ -81,10 +108,10 @@ public:
 
   void exitLoop(const uint16_t loop_id) {
 #if DEBUG
-    if (this->loop_info.at(this->current_depth).loop_id != loop_id) {
+    if (this->loop_info[this->current_depth].loop_id != loop_id) {
 
       cerr << "ERROR: Exiting from loop " << loop_id << " but expected loop "
-           << this->loop_info.at(this->current_depth).loop_id << endl;
+           << this->loop_info[this->current_depth].loop_id << endl;
       exit(-1);
     } else {
       cerr << "Exiting from loop " << loop_id << endl;
@@ -92,10 +119,11 @@ public:
 #endif
 
     // TODO: check the loop_id
-    this->current_depth--;
+    // the whole program is never left
+    if (this->current_depth > 0)
+      this->current_depth--;
 #if DEBUG
     cerr << "Leaving a loop, now at depth " << this->current_depth << "\n";
-    assert(this->current_depth <= 1048 && "We left a loop we never entered");
 #endif
   }
 
@@ -104,7 +132,7 @@ public:
   }
 
   LoopInfoType &getCurrentLoop() {
-    return this->loop_info.at(this->current_depth);
+    return this->loop_info[this->current_depth];
   }
 
   LoopInfoType &findLoop(uint64_t store_time_stamp) {
@@ -127,16 +155,16 @@ public:
     return this->loop_info[0];
   }
 
-  uint32_t calculateDistance(LoopInfoType &store_loop,
+  /// the number of the recorded iterations of `store_loop` that started
+  /// after the store, at most maxDepDistance
+  uint32_t calculateDistance(const LoopInfoType &store_loop,
                              uint64_t store_time_stamp) {
-    circular_buffer<uint64_t>::reverse_iterator iter =
-        store_loop.iteration_time_stamps.rbegin();
+    const auto &stamps = store_loop.iteration_time_stamps;
 
     uint32_t distance = 0;
-    for (; iter != store_loop.iteration_time_stamps.rend(); iter++) {
-      if (*iter <= store_time_stamp)
+    for (; distance < stamps.size(); distance++) {
+      if (stamps.fromNewest(distance) <= store_time_stamp)
         break;
-      distance++;
     }
 
     return distance;
@@ -41,10 +41,11 @@ public:
 
 template <int maxTrackedDistance = DEFAULT_TRACKED_DISTANCE>
 class MemoryProfiler
-    : public KeyDistanceProfiler<MemoryProfile, maxTrackedDistance> {
+    : public FlatKeyDistanceProfiler<MemoryProfile, maxTrackedDistance> {
 public:
   MemoryProfiler(const uint32_t num_instrs)
-      : KeyDistanceProfiler<MemoryProfile, maxTrackedDistance>(num_instrs) {}
+      : FlatKeyDistanceProfiler<MemoryProfile, maxTrackedDistance>(
+            num_instrs) {}
 
   MemoryProfile &increment(const Dependence &dep) {
     MemoryProfile &profile = this->getProfile(dep);
@@ -52,8 +53,19 @@ public:
     return profile;
   }
 
+  // the loop count is incremented once per `epoch` (one iteration of the loop
+  // the store happened in)
+  MemoryProfile &increment(const Dependence &dep, const uint64_t epoch) {
+    bool first;
+    MemoryProfile &profile = this->getProfile(dep, epoch, first);
+    profile.increment();
+    if (first)
+      profile.incrementLoop();
+    return profile;
+  }
+
   void merge(const MemoryProfiler &other) {
-    KeyDistanceProfiler<MemoryProfile, maxTrackedDistance>::merge(other);
+    FlatKeyDistanceProfiler<MemoryProfile, maxTrackedDistance>::merge(other);
   }
 
   template <int S>
@@ -63,7 +75,7 @@ public:
 template <int S>
 ostream &operator<<(ostream &stream, const MemoryProfiler<S> &vp) {
   stream << "BEGIN Memory Profile" << endl;
-  stream << ((KeyDistanceProfiler<MemoryProfile, S> &)vp);
+  stream << ((FlatKeyDistanceProfiler<MemoryProfile, S> &)vp);
   stream << "END Memory Profile" << endl;
   return stream;
 }
@@ -1,26 +1,31 @@
 #include "ObjectLifetimeModule.h"
 #include "slamp_timestamp.h"
+#include <tuple>
 
 void ObjectLifetimeModule::allocate(void *addr, uint32_t instr, uint64_t size) {
-  void *shadow = smmap->allocate(addr, size);
+  // alloc/free are sharded by the page of the base address, only the
+  // owner of an object tracks it
+  local_write((uint64_t)addr, [&]() {
+    void *shadow = smmap->allocate(addr, size);
 
-  TS *s = (TS *)shadow;
-  // log all data into sigle TS
-  // FIXME: static instruction and the dynamic context?
-  // context: static instr + function + loop
-  auto hash = contextManager.encodeActiveContext();
-  // print active context
-  // contextManager->activeContext->print(std::cerr);
+    TS *s = (TS *)shadow;
+    // log all data into sigle TS
+    // FIXME: static instruction and the dynamic context?
+    // context: static instr + function + loop
+    auto hash = contextManager.encodeActiveContext();
+    // print active context
+    // contextManager->activeContext->print(std::cerr);
 
-  // currentContext->print(std::cerr);
-  // std::cerr << "malloc hash: " << hash << "\n";
+    // currentContext->print(std::cerr);
+    // std::cerr << "malloc hash: " << hash << "\n";
 
-  // TS ts = CREATE_TS(instr, hash, __slamp_invocation);
-  TS ts = CREATE_TS_HASH(instr, hash, slamp_iteration, slamp_invocation);
+    // TS ts = CREATE_TS(instr, hash, __slamp_invocation);
+    TS ts = CREATE_TS_HASH(instr, hash, slamp_iteration, slamp_invocation);
 
-  // 8 bytes per byte TODO: can we reduce this?
-  for (auto i = 0; i < size; i++)
-    s[i] = ts;
+    // `free` only reads the TS of the base address
+    if (size > 0)
+      s[0] = ts;
+  });
 }
 
 void ObjectLifetimeModule::free(void *addr) {
@@ -39,10 +44,10 @@ void ObjectLifetimeModule::free(void *addr) {
 
     if (iteration == (0xf & slamp_iteration) &&
         invocation == (0xf & slamp_invocation) && in_loop == true) {
-      shortLivedObjects.emplace(instrAndHash);
+      siteLifetimes[instrAndHash] |= SHORT_LIVED;
     } else {
       // is not short-lived
-      longLivedObjects.emplace(instrAndHash);
+      siteLifetimes[instrAndHash] |= LONG_LIVED;
     }
   });
 }
@@ -68,6 +73,18 @@ void ObjectLifetimeModule::loop_iter() { slamp_iteration++; }
 
 void ObjectLifetimeModule::loop_exit() { in_loop = false; }
 
+void ObjectLifetimeModule::set_control(const ControlStamp &stamp) {
+  slamp_iteration = stamp.iteration;
+  slamp_invocation = stamp.invocation;
+  in_loop = stamp.in_loop;
+  contextManager.setActiveContext(stamp.fcn_context);
+}
+
+void ObjectLifetimeModule::adopt_contexts(
+    const SpecPrivContextManager &contexts) {
+  contextManager = contexts;
+}
+
 void ObjectLifetimeModule::init(uint32_t loop_id, uint32_t pid) {
   target_loop_id = loop_id;
 #define SIZE_8M 0x800000
@@ -82,11 +99,11 @@ void ObjectLifetimeModule::fini(const char *filename) {
   specprivfs << "COMPLETE ALLOCATION INFO ; \n";
 
   // local objects
-  for (auto &obj : shortLivedObjects) {
+  for (auto &[obj, state] : siteLifetimes) {
     // LOCAL OBJECT AU HEAP main if.else.i call.i4.i FROM  CONTEXT { LOOP main
     // for.cond15 1 WITHIN FUNCTION main WITHIN TOP }  IS LOCAL TO  CONTEXT {
     // LOOP main for.cond15 1 WITHIN FUNCTION main WITHIN TOP }  COUNT 300 ;
-    if (longLivedObjects.count(obj))
+    if (state != SHORT_LIVED)
       continue;
 
     auto instr = GET_INSTR(obj);
@@ -98,3 +115,58 @@ void ObjectLifetimeModule::fini(const char *filename) {
 
   specprivfs << " END SPEC PRIV PROFILE\n";
 }
+
+// binary counterpart of `fini`
+void ObjectLifetimeModule::dump(slamp::ProfileWriter &writer) {
+  auto comp = [](const slamp::LocalObjectRecord &a,
+                 const slamp::LocalObjectRecord &b) {
+    return std::tie(a.instr, a.context) < std::tie(b.instr, b.context);
+  };
+
+  // the non-local ones are needed to accumulate profiles
+  std::vector<slamp::LocalObjectRecord> nonlocal;
+  std::vector<slamp::LocalObjectRecord> records;
+  for (auto &[obj, state] : siteLifetimes) {
+    uint32_t instr = GET_INSTR(obj);
+    auto hash = GET_HASH(obj);
+    slamp::LocalObjectRecord record = {
+        instr, writer.addContext(contextManager.decodeContext(hash))};
+    if (state & LONG_LIVED)
+      nonlocal.push_back(record);
+    else
+      records.push_back(record);
+  }
+
+  writer.addSortedSection(slamp::ProfileSection::NONLOCAL_OBJECTS, nonlocal,
+                          comp, target_loop_id);
+  writer.addSortedSection(slamp::ProfileSection::LOCAL_OBJECTS, records, comp,
+                          target_loop_id);
+}
+
+// fold in a previous binary profile, returns the number of objects that are
+// not in it
+uint64_t ObjectLifetimeModule::accumulate(const slamp::ProfileReader &reader) {
+  uint64_t previous = 0;
+  auto add = [&](slamp::ProfileSection kind, uint8_t state) {
+    auto records = reader.records<slamp::LocalObjectRecord>(kind);
+    for (auto &r : records) {
+      auto hash = contextManager.encodeContext(
+          reader.decodeContext<ContextId>(r.context));
+      siteLifetimes[site(r.instr, hash)] |= state;
+    }
+    previous += records.size();
+  };
+  add(slamp::ProfileSection::LOCAL_OBJECTS, SHORT_LIVED);
+  add(slamp::ProfileSection::NONLOCAL_OBJECTS, LONG_LIVED);
+
+  return siteLifetimes.size() - previous;
+}
+
+// fold in the sites of another shard, its context hashes are re-encoded
+void ObjectLifetimeModule::merge(ObjectLifetimeModule &other) {
+  for (auto &[obj, state] : other.siteLifetimes) {
+    auto hash = contextManager.encodeContext(
+        other.contextManager.decodeContext(GET_HASH(obj)));
+    siteLifetimes[site(GET_INSTR(obj), hash)] |= state;
+  }
+}
@@ -3,12 +3,14 @@
 #include <vector>
 
 #include "slamp_logger.h"
+#include "slamp_profile.h"
 #include "slamp_shadow_mem.h"
 #include "slamp_timestamp.h"
 
 #include "LocalWriteModule.h"
 #include "HTContainer.h"
 #include "ContextManager.h"
+#include "ControlTimeline.h"
 
 enum class ObjectLifetimeModAction : uint32_t {
   INIT = 0,
@@ -35,21 +37,25 @@ class ObjectLifetimeModule: public LocalWriteModule {
 
     bool in_loop = false;
 
-
-    enum SpecPrivContextType {
-      TopContext = 0,
-      FunctionContext,
-      LoopContext,
-    };
-
-    using SpecPrivContextManager = NewContextManager<SpecPrivContextType, uint32_t, uint64_t>;
     using ContextId = ContextId<SpecPrivContextType, uint32_t>;
     SpecPrivContextManager contextManager;
 
-    HTSet<uint64_t, std::hash<uint64_t>, std::equal_to<>, 16> shortLivedObjects, longLivedObjects;
-    // std::unordered_set<unsigned long> shortLivedObjects, longLivedObjects;
+    // lifetime of the objects of each allocation site (instr + context hash,
+    // the upper bits of the TS); a site is local if it is only SHORT_LIVED
+    enum LifetimeState : uint8_t {
+      SHORT_LIVED = 1 << 0, // freed in the iteration that allocated it
+      LONG_LIVED = 1 << 1,
+    };
+    phmap::flat_hash_map<uint64_t, uint8_t> siteLifetimes;
+
+    static uint64_t site(uint32_t instr, uint64_t hash) {
+      return CREATE_TS_HASH(instr, hash, 0, 0);
+    }
 
   public:
+  // the shadow holds the object of each byte
+  static constexpr unsigned MAX_SHADOW_GRANULARITY = 1;
+
   ObjectLifetimeModule(uint32_t mask, uint32_t pattern)
       : LocalWriteModule(mask, pattern) {
     smmap = new slamp::MemoryMap<MASK2_OL>(LOCALWRITE_MASK, LOCALWRITE_PATTERN, TIMESTAMP_SIZE_IN_BYTES);
@@ -60,7 +66,12 @@ class ObjectLifetimeModule: public LocalWriteModule {
   }
 
   void init(uint32_t loop_id, uint32_t pid);
+  // place the shadow memory on `node` (--numa-bind-shadow)
+  void bind_shadow(int node) { smmap->bind_to_node(node); }
   void fini(const char *filename);
+  void dump(slamp::ProfileWriter &writer);
+  uint64_t accumulate(const slamp::ProfileReader &reader);
+  void merge(ObjectLifetimeModule &other);
 
   void allocate(void *addr, uint32_t instr, uint64_t size);
   void free(void *addr);
@@ -72,4 +83,8 @@ class ObjectLifetimeModule: public LocalWriteModule {
   void loop_iter();
   void loop_exit();
 
+  // unified workflow: the control state comes from the shared timeline, its
+  // contexts are adopted before the module is merged or written
+  void set_control(const ControlStamp &stamp);
+  void adopt_contexts(const SpecPrivContextManager &contexts);
 };
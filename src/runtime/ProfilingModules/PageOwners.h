@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace slamp {
+
+// Which consumer thread handles the accesses to which pages. The pages (or
+// the page groups of LocalWriteModule::LOCALWRITE_SHIFT) are hashed to
+// GROUPS groups; a group is owned by one thread at a time.
+//
+// Statically, `(page & MASK) == PATTERN` gives every thread the same number
+// of pages however hot they are, and takes a power-of-two thread count. The
+// table starts out the same way (group % threads, for any count), the owner
+// of a group counts the accesses it handles, and `rebalance` moves hot groups
+// from the busiest thread to the idlest.
+//
+// Moving a group is free: every thread sees every event, so the shadow (at a
+// fixed address) holds the same time stamps whoever wrote it. The table only
+// changes while no thread is handling events, at a buffer swap
+// (DoubleQueue::on_buffer).
+class PageOwners {
+public:
+  static constexpr uint32_t GROUPS = 1 << 14;
+
+private:
+  const unsigned threads;
+  std::vector<uint16_t> owners;
+  // a row of GROUPS per thread, only the thread writes it
+  std::vector<uint32_t> loads;
+  uint64_t moved = 0;
+  uint64_t rebalances = 0;
+
+  // at most this many groups move at a swap, and none while the busiest
+  // thread is within `SLACK` (in 1/16) of the average
+  static constexpr unsigned MAX_MOVES = 64;
+  static constexpr uint64_t SLACK = 2;
+  // too few accesses to tell the load
+  static constexpr uint64_t MIN_ACCESSES = 1 << 16;
+
+public:
+  explicit PageOwners(unsigned threads)
+      : threads(threads), owners(GROUPS), loads((uint64_t)threads * GROUPS) {
+    for (uint32_t g = 0; g < GROUPS; g++)
+      owners[g] = g % threads;
+  }
+
+  /// the owner of page group `unit` (the address >> LOCALWRITE_SHIFT)
+  unsigned owner(uint64_t unit) const { return owners[unit & (GROUPS - 1)]; }
+
+  /// whether `thread` owns `unit`, counting the access if so
+  bool claim(uint64_t unit, unsigned thread) {
+    const uint32_t g = unit & (GROUPS - 1);
+    if (owners[g] != thread)
+      return false;
+    loads[(uint64_t)thread * GROUPS + g]++;
+    return true;
+  }
+
+  /// move groups to even out the accesses since the last call, then start
+  /// counting again; the threads must be waiting. Returns the groups moved.
+  unsigned rebalance() {
+    std::vector<uint64_t> total(threads);
+    std::vector<uint32_t> load(GROUPS);
+    uint64_t sum = 0;
+    for (uint32_t g = 0; g < GROUPS; g++) {
+      load[g] = loads[(uint64_t)owners[g] * GROUPS + g];
+      total[owners[g]] += load[g];
+      sum += load[g];
+    }
+    std::fill(loads.begin(), loads.end(), 0);
+    if (threads < 2 || sum < MIN_ACCESSES)
+      return 0;
+
+    // hottest first, the groups that were not accessed cannot help
+    std::vector<uint32_t> hot;
+    for (uint32_t g = 0; g < GROUPS; g++)
+      if (load[g] != 0)
+        hot.push_back(g);
+    std::sort(hot.begin(), hot.end(),
+              [&](uint32_t a, uint32_t b) { return load[a] > load[b]; });
+
+    const uint64_t average = sum / threads;
+    unsigned n = 0;
+    for (; n < MAX_MOVES; n++) {
+      auto busiest = std::max_element(total.begin(), total.end());
+      auto idlest = std::min_element(total.begin(), total.end());
+      if (*busiest * 16 <= average * (16 + SLACK))
+        break;
+
+      // the hottest group of the busiest thread that closes at most the gap,
+      // so the two do not trade places
+      const uint64_t gap = *busiest - *idlest;
+      const unsigned from = busiest - total.begin();
+      auto g = std::find_if(hot.begin(), hot.end(), [&](uint32_t g) {
+        return owners[g] == from && 2 * (uint64_t)load[g] <= gap;
+      });
+      if (g == hot.end())
+        break;
+
+      owners[*g] = idlest - total.begin();
+      *busiest -= load[*g];
+      *idlest += load[*g];
+    }
+
+    moved += n;
+    rebalances += n != 0;
+    return n;
+  }
+
+  uint64_t groups_moved() const { return moved; }
+  uint64_t rebalance_count() const { return rebalances; }
+};
+
+} // namespace slamp
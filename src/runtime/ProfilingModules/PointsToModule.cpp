@@ -1,6 +1,8 @@
 #include "PointsToModule.h"
 #include "context.h"
+#include "slamp_specpriv.h"
 #include "slamp_timestamp.h"
+#include <tuple>
 #include <utility>
 
 // Points-to module
@@ -100,6 +102,20 @@ void PointsToModule::loop_invoc() {
 
 void PointsToModule::loop_iter() { slamp_iteration++; }
 
+void PointsToModule::set_control(const ControlStamp &stamp) {
+  // a new invocation, see `loop_invoc`
+  if (stamp.invocation != slamp_invocation)
+    targetLoopContexts.emplace(stamp.context);
+
+  slamp_iteration = stamp.iteration;
+  slamp_invocation = stamp.invocation;
+  contextManager.setActiveContext(stamp.context);
+}
+
+void PointsToModule::adopt_contexts(const SpecPrivContextManager &contexts) {
+  contextManager = contexts;
+}
+
 void PointsToModule::points_to_arg(uint32_t fcnId, uint32_t argId, void *ptr) {
   local_write((uint64_t)ptr, [&]() {
     auto instr = FORMAT_INST_ARG(fcnId, argId);
@@ -179,6 +195,14 @@ void PointsToModule::init(uint32_t loop_id, uint32_t pid) {
 }
 
 void PointsToModule::fini(const char *filename) {
+  // with the symbols of the program, the predictions are written as SpecPriv
+  // predictions right away
+  auto &symbols = slamp::symbols();
+  if (!symbols.empty()) {
+    fini_named(filename, symbols);
+    return;
+  }
+
   // Dump compatible one as SpecPriv output
   std::ofstream specprivfs(filename);
   specprivfs << "BEGIN SPEC PRIV PROFILE\n";
@@ -287,6 +311,85 @@ void PointsToModule::fini(const char *filename) {
   specprivfs << " END SPEC PRIV PROFILE\n";
 }
 
+// `fini` with the names resolved, what convertPromptToSpecPriv.py makes of
+// the IDs
+void PointsToModule::fini_named(const char *filename,
+                                const slamp::SymbolTable &symbols) {
+  auto elements = [](const std::vector<ContextId> &context) {
+    std::vector<slamp::ContextElement> elements;
+    for (auto &c : context)
+      elements.push_back({static_cast<uint32_t>(c.type), c.metaId});
+    return elements;
+  };
+
+  std::ofstream specprivfs(filename);
+  slamp::SpecPrivEmitter emitter(specprivfs, symbols);
+  emitter.begin();
+  for (auto contextHash : targetLoopContexts)
+    emitter.addLoopContext(
+        elements(contextManager.decodeContext(contextHash)));
+
+  for (auto &kv : decodedContextMap) {
+    auto &[instr, context] = kv.first;
+    auto &[au, auContext] = kv.second;
+    emitter.predictObject(instr, elements(context), static_cast<int32_t>(au),
+                          elements(auContext));
+  }
+  emitter.end();
+}
+
+// binary counterpart of `fini`, expects `decode_all` to be done
+void PointsToModule::dump(slamp::ProfileWriter &writer) {
+  std::vector<slamp::LoopContextRecord> loopContexts;
+  for (auto contextHash : targetLoopContexts)
+    loopContexts.push_back(
+        {writer.addContext(contextManager.decodeContext(contextHash))});
+  writer.addSortedSection(
+      slamp::ProfileSection::LOOP_CONTEXTS, loopContexts,
+      [](const slamp::LoopContextRecord &a, const slamp::LoopContextRecord &b) {
+        return a.context < b.context;
+      },
+      target_loop_id);
+
+  std::vector<slamp::PointsToRecord> records;
+  for (auto &kv : decodedContextMap) {
+    auto &[instr, context] = kv.first;
+    auto &[au, auContext] = kv.second;
+    records.push_back({instr, writer.addContext(context),
+                       static_cast<int32_t>(au), writer.addContext(auContext)});
+  }
+  writer.addSortedSection(
+      slamp::ProfileSection::POINTS_TO, records,
+      [](const slamp::PointsToRecord &a, const slamp::PointsToRecord &b) {
+        return std::tie(a.instr, a.context) < std::tie(b.instr, b.context);
+      },
+      target_loop_id);
+}
+
+// fold in a previous binary profile, merged like another thread. Returns the
+// number of pointers that are not in it
+uint64_t PointsToModule::accumulate(const slamp::ProfileReader &reader) {
+  decode_all();
+
+  for (auto &r : reader.records<slamp::LoopContextRecord>(
+           slamp::ProfileSection::LOOP_CONTEXTS)) {
+    targetLoopContexts.insert(contextManager.encodeContext(
+        reader.decodeContext<ContextId>(r.context)));
+  }
+
+  auto records =
+      reader.records<slamp::PointsToRecord>(slamp::ProfileSection::POINTS_TO);
+  for (auto &r : records) {
+    InstrAndContext instrAndContext = {
+        r.instr, reader.decodeContext<ContextId>(r.context)};
+    InstrAndContext au = {static_cast<uint32_t>(r.au),
+                          reader.decodeContext<ContextId>(r.au_context)};
+    merge_decoded(instrAndContext, au);
+  }
+
+  return decodedContextMap.size() - records.size();
+}
+
 void PointsToModule::decode_all() {
   // convert it to decodedContextMap
   for (auto &it : pointsToMap) {
@@ -334,24 +437,28 @@ void PointsToModule::decode_all() {
   }
 }
 
+void PointsToModule::merge_decoded(const InstrAndContext &instrAndContext,
+                                   const InstrAndContext &au) {
+  if (decodedContextMap.find(instrAndContext) == decodedContextMap.end()) {
+    // not found, insert
+    decodedContextMap[instrAndContext] = au;
+  } else {
+    // found, if different, set to unmanaged
+    if (decodedContextMap[instrAndContext] != au) {
+      decodedContextMap[instrAndContext] = {-2, {}};
+    }
+
+    // for (auto &it2 : it.second) {
+    //   decodedContextMap[instrAndContext].insert(it2);
+    // }
+  }
+}
+
 void PointsToModule::merge(PointsToModule &other) {
   other.decode_all();
 
   for (auto &it : other.decodedContextMap) {
-    auto instrAndContext = it.first;
-    if (decodedContextMap.find(instrAndContext) == decodedContextMap.end()) {
-      // not found, insert
-      decodedContextMap[instrAndContext] = it.second;
-    } else {
-      // found, if different, set to unmanaged
-      if (decodedContextMap[instrAndContext] != it.second) {
-        decodedContextMap[instrAndContext] = {-2, {}};
-      }
-      
-      // for (auto &it2 : it.second) {
-      //   decodedContextMap[instrAndContext].insert(it2);
-      // }
-    }
+    merge_decoded(it.first, it.second);
   }
 
   // // FIXME: this won't work because the context map is different
@@ -4,12 +4,15 @@
 
 #include "parallel_hashmap/phmap.h"
 #include "slamp_logger.h"
+#include "slamp_profile.h"
 #include "slamp_shadow_mem.h"
+#include "slamp_symbols.h"
 #include "slamp_timestamp.h"
 
 #include "LocalWriteModule.h"
 #include "HTContainer.h"
 #include "ContextManager.h"
+#include "ControlTimeline.h"
 
 enum class PointsToModAction : uint32_t {
   INIT = 0,
@@ -37,13 +40,7 @@ class PointsToModule : public LocalWriteModule {
 
     bool in_loop = false;
 
-    enum SpecPrivContextType {
-      TopContext = 0,
-      FunctionContext,
-      LoopContext,
-    };
     using ContextHash = uint64_t;
-    using SpecPrivContextManager = NewContextManager<SpecPrivContextType, uint32_t, ContextHash>;
     using ContextId = ContextId<SpecPrivContextType, uint32_t>;
     std::unordered_set<ContextHash> targetLoopContexts;
     SpecPrivContextManager contextManager;
@@ -59,6 +56,9 @@ class PointsToModule : public LocalWriteModule {
     // std::map<InstrAndContext, std::set<InstrAndContext>> decodedContextMap;
 
   public:
+  // the shadow holds the object of each byte
+  static constexpr unsigned MAX_SHADOW_GRANULARITY = 1;
+
   PointsToModule(uint32_t mask, uint32_t pattern)
       : LocalWriteModule(mask, pattern) {
     smmap = new slamp::MemoryMap<MASK2_PT>(mask, pattern, TIMESTAMP_SIZE_IN_BYTES);
@@ -69,7 +69,11 @@ class PointsToModule : public LocalWriteModule {
   }
 
   void init(uint32_t loop_id, uint32_t pid);
+  // place the shadow memory on `node` (--numa-bind-shadow)
+  void bind_shadow(int node) { smmap->bind_to_node(node); }
   void fini(const char *filename);
+  void dump(slamp::ProfileWriter &writer);
+  uint64_t accumulate(const slamp::ProfileReader &reader);
 
   void allocate(void *addr, uint32_t instr, uint64_t size);
   void free(void *addr);
@@ -80,10 +84,19 @@ class PointsToModule : public LocalWriteModule {
   void func_exit(uint32_t fcnId);
   void loop_entry(uint32_t loopId);
   void loop_exit(uint32_t loopId);
+  // unified workflow: the control state comes from the shared timeline, its
+  // contexts are adopted before the module is merged or written
+  void set_control(const ControlStamp &stamp);
+  void adopt_contexts(const SpecPrivContextManager &contexts);
 
   void points_to_inst(uint32_t instId, void *ptr);
 
   void points_to_arg(uint32_t fcnId, uint32_t argId, void *ptr);
   void merge(PointsToModule &other);
   void decode_all();
+
+  private:
+    void fini_named(const char *filename, const slamp::SymbolTable &symbols);
+    void merge_decoded(const InstrAndContext &instrAndContext,
+                       const InstrAndContext &au);
 };
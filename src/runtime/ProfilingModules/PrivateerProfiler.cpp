@@ -1,101 +1,83 @@
 #include "PrivateerProfiler.h"
 #include "privateer/profiler.h"
 
-// FIXME: a hack to hold the names
-static const char *inst_names[500000];
-static const char *fn_names[500000];
-static const char *loop_names[500000];
-
-void PrivateerProfiler::init(uint32_t loop_id, uint32_t pid) {
-  Profiler &prof = Profiler::getInstance();
-  prof.begin();
-
-  // allocate chunks
-  auto inst_name_chunk = (char *)malloc(500000 * 16);
-  auto fn_name_chunk = (char *)malloc(500000 * 16);
-  auto loop_name_chunk = (char *)malloc(500000 * 16);
-  for (auto i = 0; i < 500000; i++) {
-    // create a new string "inst_{i}" and store it in inst_names[i]
-    auto inst_name = inst_name_chunk + (i * 16);
-    auto fn_name = fn_name_chunk + (i * 16);
-    auto loop_name = loop_name_chunk + (i * 16);
-    sprintf(inst_name, "inst_%d", i);
-    sprintf(fn_name, "fn_%d", i);
-    sprintf(loop_name, "loop_%d", i);
-
-    inst_names[i] = inst_name;
-    fn_names[i] = fn_name;
-    loop_names[i] = loop_name;
-  }
+static Name inst_name(uint32_t id) { return Name(InstName, id); }
+static Name fn_name(uint32_t id) { return Name(FcnName, id); }
+static Name loop_name(uint32_t id) { return Name(LoopName, id); }
+
+PrivateerProfiler::PrivateerProfiler(uint32_t mask, uint32_t pattern)
+    : LocalWriteModule(mask, pattern), prof(new Profiler()) {
+  prof->set_shard(mask, pattern);
 }
 
-void PrivateerProfiler::fini(const char *filename) {
-  Profiler &prof = Profiler::getInstance();
-  prof.end();
+PrivateerProfiler::~PrivateerProfiler() { delete prof; }
+
+void PrivateerProfiler::init(uint32_t loop_id, uint32_t pid) { prof->begin(); }
+
+void PrivateerProfiler::fini(const char *filename) { prof->end(); }
+
+// `other` is finished (its open contexts closed) before it is folded in
+void PrivateerProfiler::merge(PrivateerProfiler &other) {
+  other.prof->finish();
+  prof->merge(*other.prof);
 }
 
 void PrivateerProfiler::allocate(void *addr, uint32_t instr, uint64_t size) {
-  Profiler &prof = Profiler::getInstance();
-  prof.malloc(inst_names[instr], addr, size);
+  prof->malloc(inst_name(instr), addr, size);
 }
 
 void PrivateerProfiler::realloc(void *old_addr, void *new_addr, uint32_t instr,
                                 uint64_t size) {
-  Profiler &prof = Profiler::getInstance();
-  prof.realloc(inst_names[instr], old_addr, new_addr, size);
+  prof->realloc(inst_name(instr), old_addr, new_addr, size);
 }
 
 void PrivateerProfiler::free(void *addr) {
-  Profiler &prof = Profiler::getInstance();
-  prof.free(nullptr, addr, false);
+  prof->free(Name(), addr, false);
 }
 
 void PrivateerProfiler::stack_alloc(void *addr, uint32_t instr, uint64_t size) {
-  Profiler &prof = Profiler::getInstance();
-  prof.report_stack(inst_names[instr], addr, 1, size);
+  prof->report_stack(inst_name(instr), addr, 1, size);
 }
 
 void PrivateerProfiler::stack_free(void *addr) {
-  Profiler &prof = Profiler::getInstance();
-  prof.free(nullptr, addr, true);
+  prof->free(Name(), addr, true);
 }
 
 void PrivateerProfiler::func_entry(uint32_t fcnId) {
-  Profiler &prof = Profiler::getInstance();
-  prof.begin_function(fn_names[fcnId]);
+  prof->begin_function(fn_name(fcnId));
 }
 void PrivateerProfiler::func_exit(uint32_t fcnId) {
-  Profiler &prof = Profiler::getInstance();
-  prof.end_function(0);
-  // prof.end_function(fn_names[fcnId]);
+  prof->end_function(Name());
+  // prof->end_function(fn_name(fcnId));
 }
 
 void PrivateerProfiler::loop_entry(uint32_t loopId) {
-  Profiler &prof = Profiler::getInstance();
-  prof.begin_iter(loop_names[loopId]);
+  prof->begin_iter(loop_name(loopId));
 }
 
 void PrivateerProfiler::loop_exit(uint32_t loopId) {
-  Profiler &prof = Profiler::getInstance();
-  prof.end_iter(0);
-  // prof.end_iter(loop_names[loopId]);
+  prof->end_iter(Name());
+  // prof->end_iter(loop_name(loopId));
 }
 
 void PrivateerProfiler::loop_iter(uint32_t loopId) {
-  Profiler &prof = Profiler::getInstance();
   // FIXME: this is a hack to get around the fact that we don't have a
   // loop_iter_end
-  prof.end_iter(0);
-  prof.begin_iter(loop_names[loopId]);
-  // prof.end_iter(loop_names[loopId]);
-  // prof.begin_iter(loop_names[loopId]);
+  prof->end_iter(Name());
+  prof->begin_iter(loop_name(loopId));
+  // prof->end_iter(loop_name(loopId));
+  // prof->begin_iter(loop_name(loopId));
 }
 
 void PrivateerProfiler::points_to_inst(uint32_t instId, void *ptr) {
-  Profiler &prof = Profiler::getInstance();
-
-  prof.find_underlying_object(inst_names[instId], ptr);
-  prof.predict_ptr(inst_names[instId], ptr);
+  // the owner of the page has the AU
+  local_write((uint64_t)ptr, [&]() {
+    prof->find_underlying_object(inst_name(instId), ptr);
+    prof->predict_ptr(inst_name(instId), ptr, false);
+  });
+
+  if (owns_instr(instId))
+    prof->pointer_residue(inst_name(instId), ptr);
 }
 
 void PrivateerProfiler::points_to_arg(uint32_t fcnId, uint32_t argId,
@@ -104,8 +86,8 @@ void PrivateerProfiler::points_to_arg(uint32_t fcnId, uint32_t argId,
 }
 
 void PrivateerProfiler::load(uint32_t instr, uint64_t value) {
-  Profiler &prof = Profiler::getInstance();
-  prof.predict_int(inst_names[instr], value);
+  if (owns_instr(instr))
+    prof->predict_int(inst_name(instr), value);
 }
 
 void PrivateerProfiler::predict_int(uint32_t instId, uint64_t value) {}
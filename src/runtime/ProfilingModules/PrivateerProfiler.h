@@ -6,23 +6,27 @@
 #include "HTContainer.h"
 #include "LocalWriteModule.h"
 
+struct Profiler;
+
+// Each instance is a shard with its own privateer Profiler: the pointer
+// predictions are split by page (the LocalWriteModule pattern), the integer
+// predictions and pointer residues by instruction
 class PrivateerProfiler : public LocalWriteModule {
 private:
   uint32_t target_loop_id = 0;
+  Profiler *prof;
 
-public:
-  PrivateerProfiler(uint32_t mask, uint32_t pattern)
-      : LocalWriteModule(mask, pattern) {
-    // smmap = new slamp::MemoryMap<MASK2_PT>(mask, pattern,
-    // TIMESTAMP_SIZE_IN_BYTES);
+  bool owns_instr(uint32_t instr) const {
+    return (instr & LOCALWRITE_MASK) == LOCALWRITE_PATTERN;
   }
 
-  ~PrivateerProfiler() override {
-    // delete smmap;
-  }
+public:
+  PrivateerProfiler(uint32_t mask, uint32_t pattern);
+  ~PrivateerProfiler() override;
 
   void init(uint32_t loop_id, uint32_t pid);
   void fini(const char *filename);
+  void merge(PrivateerProfiler &other);
 
   void load(uint32_t instr, uint64_t value);
 
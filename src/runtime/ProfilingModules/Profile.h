@@ -1,7 +1,9 @@
 #ifndef PROFILING_H
 #define PROFILING_H
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstdlib>
 #include <iostream>
 #include <ostream>
 
@@ -22,6 +24,11 @@ using ls_key_t = struct ls_key_s {
 
 static const uint64_t PROFILE_INSTR_MAX = ((1ULL << 22) - 1);
 static const uint64_t PROFILE_LOOP_MAX = ((1ULL << 10) - 1);
+static const uint64_t PROFILE_DIST_MAX = ((1ULL << 10) - 1);
+
+inline bool operator<(const ls_key_t &ls1, const ls_key_t &ls2) {
+  return *((uint32_t *)&ls1) < *((uint32_t *)&ls2);
+}
 
 static const uint64_t DEFAULT_TRACKED_DISTANCE = 2;
 
@@ -169,6 +176,161 @@ ostream &operator<<(ostream &stream, const KeyDistanceProfiler<T, D> &vp) {
   return stream;
 }
 
+/// KeyDistanceProfiler flattened into one open-addressing table, keyed by the
+/// packed (load, distance, loop, store) with the profile stored inline.
+/// Each entry also keeps the last epoch it was seen in, so "first time in
+/// this loop iteration" is a compare instead of a set insertion.
+template <class T, int maxTrackedDistance = DEFAULT_TRACKED_DISTANCE>
+class FlatKeyDistanceProfiler {
+public:
+  static const uint64_t MAX_TRACKED_DISTANCE = maxTrackedDistance;
+  static_assert(maxTrackedDistance <= PROFILE_DIST_MAX + 1,
+                "distance does not fit in the packed key");
+
+private:
+  static const uint64_t EMPTY_KEY = ~0ULL; // the load never has the top bits
+  static const uint64_t NO_EPOCH = 0;
+  static const uint64_t INITIAL_CAPACITY = 1024;
+
+  struct Entry {
+    uint64_t key;
+    uint64_t epoch;
+    T profile;
+  };
+
+  vector<Entry> table;
+  uint64_t mask;
+  uint64_t used = 0;
+  const uint32_t num_instrs;
+
+  // load:22 | distance:10 | loop:10 | store:22, the key order is the order of
+  // the output
+  static uint64_t pack(const Dependence &dep) {
+    return ((uint64_t)dep.load << 42) |
+           ((uint64_t)trackedDistance(dep.dist) << 32) |
+           ((uint64_t)(dep.loop & PROFILE_LOOP_MAX) << 22) |
+           (dep.store & PROFILE_INSTR_MAX);
+  }
+
+  static uint64_t hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+  }
+
+  Entry &lookup(const uint64_t key) {
+    for (uint64_t i = hash(key) & mask;; i = (i + 1) & mask) {
+      Entry &entry = table[i];
+      if (entry.key == key)
+        return entry;
+      if (entry.key != EMPTY_KEY)
+        continue;
+
+      // keep the load factor under 1/2
+      if ((used + 1) * 2 > table.size()) {
+        grow();
+        return lookup(key);
+      }
+      entry.key = key;
+      used++;
+      return entry;
+    }
+  }
+
+  void grow() {
+    vector<Entry> old(table.size() * 2, Entry{EMPTY_KEY, NO_EPOCH, T()});
+    old.swap(table);
+    mask = table.size() - 1;
+    for (auto &entry : old) {
+      if (entry.key == EMPTY_KEY)
+        continue;
+      uint64_t i = hash(entry.key) & mask;
+      while (table[i].key != EMPTY_KEY)
+        i = (i + 1) & mask;
+      table[i] = entry;
+    }
+  }
+
+  vector<const Entry *> sortedEntries() const {
+    vector<const Entry *> entries;
+    entries.reserve(used);
+    for (auto &entry : table)
+      if (entry.key != EMPTY_KEY)
+        entries.push_back(&entry);
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry *a, const Entry *b) { return a->key < b->key; });
+    return entries;
+  }
+
+public:
+  FlatKeyDistanceProfiler(const uint32_t num_instrs)
+      : table(INITIAL_CAPACITY, Entry{EMPTY_KEY, NO_EPOCH, T()}),
+        mask(INITIAL_CAPACITY - 1), num_instrs(num_instrs) {
+    if (num_instrs > PROFILE_INSTR_MAX) {
+      cerr << "Number of instructions must be less than " << PROFILE_INSTR_MAX
+           << " " << num_instrs << " given" << endl;
+      abort();
+    }
+  }
+
+  static uint32_t trackedDistance(const uint32_t dist) {
+    const uint32_t tracked_distance =
+        (dist >= maxTrackedDistance) ? (maxTrackedDistance - 1) : dist;
+    return tracked_distance;
+  }
+
+  T &getProfile(const Dependence &dep) {
+    if (dep.load >= num_instrs) {
+      cerr << "Load " << dep.load << " out of range (" << num_instrs << ")"
+           << endl;
+      abort();
+    }
+    return lookup(pack(dep)).profile;
+  }
+
+  /// `first` is set if `dep` is not seen in `epoch` before (epochs start at 1)
+  T &getProfile(const Dependence &dep, const uint64_t epoch, bool &first) {
+    if (dep.load >= num_instrs) {
+      cerr << "Load " << dep.load << " out of range (" << num_instrs << ")"
+           << endl;
+      abort();
+    }
+    Entry &entry = lookup(pack(dep));
+    first = entry.epoch != epoch;
+    entry.epoch = epoch;
+    return entry.profile;
+  }
+
+  uint64_t size() const { return used; }
+
+  void merge(const FlatKeyDistanceProfiler<T, maxTrackedDistance> &other) {
+    for (auto &entry : other.table) {
+      if (entry.key != EMPTY_KEY)
+        lookup(entry.key).profile.merge(entry.profile);
+    }
+  }
+
+  template <class S, int D>
+  friend ostream &operator<<(ostream &stream,
+                             const FlatKeyDistanceProfiler<S, D> &vp);
+};
+
+template <class T, int D>
+ostream &operator<<(ostream &stream, const FlatKeyDistanceProfiler<T, D> &vp) {
+  for (auto *entry : vp.sortedEntries()) {
+    const uint64_t key = entry->key;
+    const uint32_t load = key >> 42;
+    const uint32_t dist = (key >> 32) & PROFILE_DIST_MAX;
+    const uint32_t loop = (key >> 22) & PROFILE_LOOP_MAX;
+    const uint32_t store = key & PROFILE_INSTR_MAX;
+
+    stream << "(" << load << " " << dist << " " << loop << " " << store
+           << " (" << entry->profile << ") )" << endl;
+  }
+  return stream;
+}
+
 } // namespace Profiling
 
 #endif
@@ -0,0 +1,120 @@
+#include <fstream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "ValuePatternModule.h"
+
+// Value-pattern module
+// Requires events:
+//  - init, fini
+//  - [x] Load (instr, addr, value)
+//  - [x] Target loop invocation, iteration
+
+void ValuePatternModule::init(uint32_t loop_id, uint32_t pid) {
+  target_loop_id = loop_id;
+}
+
+static void print_pattern(std::ostream &os, const char *kind, uint32_t instr,
+                          const ValuePattern &p) {
+  // PRED VALUE 12 LINEAR 2 7 COUNT 300 ;
+  if (p.is_constant())
+    os << "PRED " << kind << " " << instr << " CONSTANT " << p.first;
+  else if (p.is_linear())
+    os << "PRED " << kind << " " << instr << " LINEAR " << p.slope << " "
+       << p.base();
+  else if (p.is_stride())
+    os << "PRED " << kind << " " << instr << " STRIDE " << p.stride;
+  else
+    return;
+  os << " COUNT " << p.count << " ; \n";
+}
+
+void ValuePatternModule::fini(const char *filename) {
+  // sorted by instruction, the map is not
+  std::map<uint32_t, const LoadPatterns *> sorted;
+  for (auto &[instr, p] : patterns)
+    sorted.emplace(instr, &p);
+
+  std::ofstream specprivfs(filename);
+  specprivfs << "BEGIN SPEC PRIV PROFILE\n";
+  for (auto &[instr, p] : sorted) {
+    print_pattern(specprivfs, "VALUE", instr, p->value);
+    print_pattern(specprivfs, "ADDR", instr, p->addr);
+  }
+  specprivfs << " END SPEC PRIV PROFILE\n";
+}
+
+static slamp::ValuePatternRecord to_record(uint32_t instr, uint32_t stream,
+                                           const ValuePattern &p) {
+  return {instr,   stream,      p.flags, 0,        p.count, p.first_iter,
+          p.first, p.last_iter, p.last,  p.stride, p.slope};
+}
+
+static ValuePattern from_record(const slamp::ValuePatternRecord &r) {
+  ValuePattern p;
+  p.flags = r.flags;
+  p.count = r.count;
+  p.first_iter = r.first_iter;
+  p.first = r.first;
+  p.last_iter = r.last_iter;
+  p.last = r.last;
+  p.stride = r.stride;
+  p.slope = r.slope;
+  return p;
+}
+
+// binary counterpart of `fini`; the whole state is kept, so profiles can be
+// accumulated
+void ValuePatternModule::dump(slamp::ProfileWriter &writer) {
+  std::vector<slamp::ValuePatternRecord> records;
+  for (auto &[instr, p] : patterns) {
+    records.push_back(to_record(instr, slamp::STREAM_VALUE, p.value));
+    records.push_back(to_record(instr, slamp::STREAM_ADDR, p.addr));
+  }
+
+  writer.addSortedSection(
+      slamp::ProfileSection::VALUE_PATTERN, records,
+      [](const slamp::ValuePatternRecord &a,
+         const slamp::ValuePatternRecord &b) {
+        return std::tie(a.instr, a.stream) < std::tie(b.instr, b.stream);
+      },
+      target_loop_id);
+}
+
+// fold in a previous binary profile, merged like another thread. Returns the
+// number of loads that are not in it
+uint64_t ValuePatternModule::accumulate(const slamp::ProfileReader &reader) {
+  auto records = reader.records<slamp::ValuePatternRecord>(
+      slamp::ProfileSection::VALUE_PATTERN);
+  for (auto &r : records) {
+    auto &p = patterns[r.instr];
+    if (r.stream == slamp::STREAM_VALUE)
+      p.value.merge(from_record(r));
+    else
+      p.addr.merge(from_record(r));
+  }
+
+  return patterns.size() - records.size() / 2;
+}
+
+void ValuePatternModule::loop_invoc() { slamp_iteration = 0; }
+
+void ValuePatternModule::loop_iter() { slamp_iteration++; }
+
+void ValuePatternModule::load(uint32_t instr, uint64_t addr, uint64_t value) {
+  local_write(instr, [&]() {
+    auto &p = patterns[instr];
+    p.value.observe(slamp_iteration, value);
+    p.addr.observe(slamp_iteration, addr);
+  });
+}
+
+// each load is in one shard, but the two may overlap after accumulating
+void ValuePatternModule::merge_patterns(ValuePatternModule &other) {
+  for (auto &[instr, p] : other.patterns) {
+    auto &mine = patterns[instr];
+    mine.value.merge(p.value);
+    mine.addr.merge(p.addr);
+  }
+}
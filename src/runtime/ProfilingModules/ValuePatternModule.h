@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+
+#include "LocalWriteModule.h"
+#include "parallel_hashmap/phmap.h"
+#include "slamp_profile.h"
+
+enum class ValuePatternModAction : uint32_t {
+  INIT = 0,
+  LOAD,
+  LOOP_INVOC,
+  LOOP_ITER,
+  FINISHED
+};
+
+// The pattern of one stream of samples (the values or the addresses of a
+// load), in O(1) state:
+//  - constant: every sample is `first`
+//  - linear: sample = slope * iteration + base, the iteration of the target
+//    loop counted from 0 in each invocation
+//  - stride: each sample is the previous one plus `stride`
+// A constant is also linear and has stride 0; `kind` reports the most
+// specific one.
+struct ValuePattern {
+  enum Flags : uint32_t {
+    CONSTANT = slamp::PATTERN_CONSTANT,
+    LINEAR = slamp::PATTERN_LINEAR,
+    STRIDE = slamp::PATTERN_STRIDE,
+    SLOPE_KNOWN = slamp::PATTERN_SLOPE_KNOWN,
+  };
+
+  uint32_t flags = CONSTANT | LINEAR | STRIDE;
+  uint64_t count = 0;
+  uint64_t first_iter = 0, first = 0;
+  uint64_t last_iter = 0, last = 0;
+  int64_t stride = 0;
+  int64_t slope = 0;
+
+  void observe(uint64_t iter, uint64_t value) {
+    if (count == 0) {
+      first_iter = last_iter = iter;
+      first = last = value;
+      count = 1;
+      return;
+    }
+
+    fit(iter, value);
+    if (flags & STRIDE) {
+      const int64_t d = value - last;
+      if (count == 1)
+        stride = d;
+      else if (d != stride)
+        flags &= ~STRIDE;
+    }
+    last_iter = iter;
+    last = value;
+    count++;
+  }
+
+  // Combine the samples of another shard or run. Their order relative to
+  // ours is unknown, so a stride is only kept if both have the same one.
+  void merge(const ValuePattern &other) {
+    if (other.count == 0)
+      return;
+    if (count == 0) {
+      *this = other;
+      return;
+    }
+
+    // all the samples of `other` are on its line; its first and last sample,
+    // and its slope, stand for them
+    flags &= other.flags | SLOPE_KNOWN;
+    fit(other.first_iter, other.first);
+    fit(other.last_iter, other.last);
+    if (other.is_linear())
+      fit(other.first_iter + 1, other.first + other.slope);
+
+    if (count == 1)
+      stride = other.count == 1 ? (int64_t)(other.first - first) : other.stride;
+    else if (other.count > 1 && stride != other.stride)
+      flags &= ~STRIDE;
+    count += other.count;
+  }
+
+  bool is_constant() const { return flags & CONSTANT; }
+  bool is_linear() const { return (flags & LINEAR) && (flags & SLOPE_KNOWN); }
+  bool is_stride() const { return (flags & STRIDE) && count > 1; }
+  int64_t base() const { return first - slope * first_iter; }
+
+private:
+  // the constant and linear patterns depend on the sample, not the order
+  void fit(uint64_t iter, uint64_t value) {
+    if ((flags & CONSTANT) && value != first)
+      flags &= ~CONSTANT;
+
+    if (!(flags & LINEAR))
+      return;
+    const int64_t di = iter - first_iter;
+    const int64_t dv = value - first;
+    if (di == 0) {
+      if (dv != 0)
+        flags &= ~LINEAR;
+    } else if (!(flags & SLOPE_KNOWN)) {
+      if (dv % di != 0)
+        flags &= ~LINEAR;
+      else {
+        slope = dv / di;
+        flags |= SLOPE_KNOWN;
+      }
+    } else if (slope * di != dv) {
+      flags &= ~LINEAR;
+    }
+  }
+};
+
+// the loaded values and the addresses of one load
+struct LoadPatterns {
+  ValuePattern value;
+  ValuePattern addr;
+};
+
+class ValuePatternModule : public GenericLocalWriteModule {
+private:
+  uint64_t slamp_iteration = 0;
+  uint32_t target_loop_id = 0;
+
+  phmap::flat_hash_map<uint32_t, LoadPatterns> patterns;
+
+public:
+  ValuePatternModule(uint32_t mask, uint32_t pattern)
+      : GenericLocalWriteModule(mask, pattern) {}
+
+  ~ValuePatternModule() override = default;
+
+  void init(uint32_t loop_id, uint32_t pid);
+  void fini(const char *filename);
+  void dump(slamp::ProfileWriter &writer);
+  uint64_t accumulate(const slamp::ProfileReader &reader);
+
+  void loop_invoc();
+  void loop_iter();
+  void load(uint32_t instr, uint64_t addr, uint64_t value);
+
+  void merge_patterns(ValuePatternModule &other);
+};
@@ -13,6 +13,7 @@
 #include "Profile.h"
 #include "WholeProgramDependenceModule.h"
 #include "parallel_hashmap/phmap.h"
+#include "slamp_shadow_access.h"
 #include "slamp_shadow_mem.h"
 #include "slamp_timestamp.h"
 
@@ -23,10 +24,6 @@ std::ostream &operator<<(std::ostream &stream, const MemoryProfile &vp) {
   stream << vp.total_count << " " << vp.loop_count << " ";
   return stream;
 }
-
-bool operator<(const ls_key_t &ls1, const ls_key_t &ls2) {
-  return *((uint32_t *)&ls1) < *((uint32_t *)&ls2);
-}
 } // namespace Profiling
 
 std::ostream &operator<<(std::ostream &stream, const Dependence &dep) {
@@ -34,22 +31,10 @@ std::ostream &operator<<(std::ostream &stream, const Dependence &dep) {
   return stream;
 }
 
-void WholeProgramDependenceModule::initializeSets() {
-  LoopInfoType &loopInfo = loop_hierarchy->getCurrentLoop();
-  DependenceSets &dependenceSets = loopInfo.getItem();
-
-  if (dependenceSets.size() != MemoryProfilerType::MAX_TRACKED_DISTANCE) {
-    for (uint32_t i = dependenceSets.size();
-         i < MemoryProfilerType::MAX_TRACKED_DISTANCE; i++) {
-      DependenceSet seta;
-      dependenceSets.push_back(seta);
-    }
-  }
-
-  auto viter = dependenceSets.begin();
-  for (; viter != dependenceSets.end(); viter++) {
-    viter->clear();
-  }
+// a new iteration of the current loop, the dependences are counted for the
+// loop again
+void WholeProgramDependenceModule::startEpoch() {
+  loop_hierarchy->getCurrentLoop().getItem().epoch = ++loop_epoch;
 }
 
 LoopInfoType &
@@ -74,10 +59,7 @@ void WholeProgramDependenceModule::init(uint32_t max_inst, uint32_t pid) {
   memoryProfiler = new MemoryProfilerType(max_inst + 1);
 
   loop_hierarchy->loopIteration(0);
-
-  LoopInfoType &loopInfo = loop_hierarchy->getCurrentLoop();
-  DependenceSets dependenceSets(MemoryProfilerType::MAX_TRACKED_DISTANCE);
-  loopInfo.setItem(dependenceSets);
+  startEpoch();
 
   smmap->init_stack(SIZE_8M, pid);
 }
@@ -133,42 +115,37 @@ void WholeProgramDependenceModule::log(const timestamp_t ts,
   Dependence dep(dst_inst);
   LoopInfoType &loopInfo = fillInDependence(ts, dep);
   dep.dist = MemoryProfilerType::trackedDistance(dep.dist);
-  MemoryProfile &profile = memoryProfiler->increment(dep);
-
-  DependenceSets &dependenceSets = loopInfo.getItem();
-  pair<DependenceSet::iterator, bool> result =
-      dependenceSets[dep.dist].insert(dep);
-  if (result.second) {
-    profile.incrementLoop();
-  }
+  memoryProfiler->increment(dep, loopInfo.getItem().epoch);
 }
 
 void WholeProgramDependenceModule::load(uint32_t instr, const uint64_t addr,
                                         const uint32_t bare_instr,
                                         const uint32_t size) {
-  local_write(addr, [&]() {
-    lamp_stats.dyn_loads++;
-    TS *s = (TS *)GET_SHADOW(addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2);
-
-    timestamp_ts_u ts;
-    TS last_ts = 0;
-
-    for (uint32_t i = 0; i < size; i++) {
-      if (s[i] != last_ts) {
-        ts.ts = s[i];
-        log(ts.timestamp, instr);
-        last_ts = s[i];
-      }
-    }
+  const uint64_t first = addr;
+  local_write_range(addr, size, [&](const uint64_t addr, const uint32_t size) {
+    // counted by the owner of the first byte
+    if (addr == first)
+      lamp_stats.dyn_loads++;
+    TS *s = (TS *)GET_SHADOW_GRANULAR(addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2,
+                                      granularity);
+
+    const uint32_t slots = slamp::shadow_slots(addr, size, granularity);
+    slamp::shadow_for_each_stamp(s, slots, [&](const TS stamp) {
+      timestamp_ts_u ts;
+      ts.ts = stamp;
+      log(ts.timestamp, instr);
+    });
   });
 }
 
 void WholeProgramDependenceModule::store(uint32_t instr, uint32_t bare_instr,
                                          const uint64_t addr,
                                          const uint32_t size) {
-  local_write(addr, [&]() {
+  const uint64_t first = addr;
+  local_write_range(addr, size, [&](const uint64_t addr, const uint32_t size) {
     // store_count++;
-    lamp_stats.dyn_stores++;
+    if (addr == first)
+      lamp_stats.dyn_stores++;
     // if (lamp_stats.dyn_stores % 1'000 == 0) {
     // if (lamp_stats.dyn_stores > 54'000'000 &&
     //     lamp_stats.dyn_stores < 54'456'000) {
@@ -180,33 +157,38 @@ void WholeProgramDependenceModule::store(uint32_t instr, uint32_t bare_instr,
     // else
     //   store_inst_count[instr]++;
 
-    TS *shadow_addr = (TS *)GET_SHADOW(addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2);
+    TS *shadow_addr = (TS *)GET_SHADOW_GRANULAR(
+        addr, DM_TIMESTAMP_SIZE_IN_BYTES_LOG2, granularity);
 
     timestamp_ts_u ts;
     ts.timestamp.instr = instr;
     ts.timestamp.timestamp = time_stamp;
 
-    for (uint32_t i = 0; i < size; i++) {
-      shadow_addr[i] = ts.ts;
-    }
+    slamp::shadow_fill(shadow_addr, ts.ts,
+                       slamp::shadow_slots(addr, size, granularity));
   });
 }
 
+// the entry also starts the first iteration, and its epoch
 void WholeProgramDependenceModule::loop_entry(uint32_t loop_id) {
   loop_hierarchy->enterLoop(loop_id, time_stamp);
-  initializeSets();
-
-  if (loop_iteration_count.find(loop_id) == loop_iteration_count.end())
-    loop_iteration_count[loop_id] = 0;
+  loop_hierarchy->getCurrentLoop().getItem().iterations =
+      &loop_iteration_count[loop_id];
 
   loop_iter();
 }
 
 void WholeProgramDependenceModule::loop_iter() {
   time_stamp++;
-  loop_hierarchy->loopIteration(time_stamp);
-  loop_iteration_count[loop_hierarchy->getCurrentLoop().loop_id]++;
-  initializeSets();
+  LoopInfoType &loop = loop_hierarchy->getCurrentLoop();
+  loop.iteration(time_stamp);
+
+  // only the whole program has no entry until its first iteration
+  LoopState &state = loop.getItem();
+  if (!state.iterations)
+    state.iterations = &loop_iteration_count[loop.loop_id];
+  (*state.iterations)++;
+  state.epoch = ++loop_epoch;
 }
 
 void WholeProgramDependenceModule::loop_exit(uint32_t loop_id) {
@@ -40,9 +40,15 @@ using lamp_stats_t = struct _lamp_stats_t {
 
 constexpr uint64_t MAX_DEP_DIST = 2;
 
-using DependenceSets = vector<DependenceSet>;
-using Loops =
-    LoopHierarchy<DependenceSets, Loop::DEFAULT_LOOP_DEPTH, MAX_DEP_DIST>;
+// what the module keeps for each active loop
+struct LoopState {
+  // of the current iteration
+  uint64_t epoch = 0;
+  // its entry of loop_iteration_count, so an iteration does not look it up
+  uint32_t *iterations = nullptr;
+};
+
+using Loops = LoopHierarchy<LoopState, Loop::DEFAULT_LOOP_DEPTH, MAX_DEP_DIST>;
 using LoopInfoType = Loops::LoopInfoType;
 using MemoryProfilerType = MemoryProfiler<MAX_DEP_DIST>;
 
@@ -58,6 +64,8 @@ private:
   int nested_level = 0;
 
   slamp::MemoryMap<MASK2> *smmap = nullptr;
+  // log2 of the data bytes per shadow slot
+  const unsigned granularity;
 
   uint32_t giNumLoops;
 
@@ -66,24 +74,40 @@ private:
   MemoryProfilerType *memoryProfiler;
   Loops *loop_hierarchy;
 
-  phmap::flat_hash_map<uint32_t, uint32_t> loop_iteration_count;
+  // node based, the active loops point into it
+  phmap::node_hash_map<uint32_t, uint32_t> loop_iteration_count;
 
   uint64_t time_stamp;
-  void initializeSets();
+  uint64_t loop_epoch = 0;
+  void startEpoch();
   LoopInfoType &fillInDependence(const timestamp_t value, Dependence &dep);
   void log(const timestamp_t ts, const uint32_t dst_inst);
   // void log(TS ts, const uint32_t dst_inst, const uint32_t bare_inst);
 
 public:
-  WholeProgramDependenceModule(uint32_t mask, uint32_t pattern)
-      : LocalWriteModule(mask, pattern) {
-    smmap =
-        new slamp::MemoryMap<MASK2>(mask, pattern, DM_TIMESTAMP_SIZE_IN_BYTES);
+  // exact as long as the accesses cover whole slots; otherwise the bytes of
+  // a slot share their last store
+  static constexpr unsigned MAX_SHADOW_GRANULARITY = 64;
+
+  WholeProgramDependenceModule(uint32_t mask, uint32_t pattern,
+                               unsigned granularity = 0)
+      : LocalWriteModule(mask, pattern,
+                         slamp::local_write_shift(
+                             DM_TIMESTAMP_SIZE_IN_BYTES_LOG2, granularity)),
+        granularity(granularity) {
+    smmap = new slamp::MemoryMap<MASK2>(
+        mask, pattern, DM_TIMESTAMP_SIZE_IN_BYTES, granularity);
   }
 
   ~WholeProgramDependenceModule() override { delete smmap; }
 
   void init(uint32_t max_inst, uint32_t pid);
+  // place the shadow memory on `node` (--numa-bind-shadow)
+  void bind_shadow(int node) { smmap->bind_to_node(node); }
+  void set_page_owners(slamp::PageOwners *o) override {
+    LocalWriteModule::set_page_owners(o);
+    smmap->set_page_owners(o);
+  }
   void fini(const char *filename);
   // always_inline attribute
   void load(uint32_t instr, const uint64_t addr, const uint32_t bare_instr,
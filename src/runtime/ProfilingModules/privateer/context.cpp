@@ -1,100 +1,86 @@
 #include "context.h"
 
-static void flatten(CtxHolder ctx, std::vector<CtxHolder> &result)
+ContextTable::ContextTable()
 {
-  if( ctx.is_null() )
-    return;
-
-  result.push_back( ctx );
-
-  flatten(ctx->parent, result);
+  Context top = { Top, Name(), 0, 0, 0 };
+  entries.push_back(top);
 }
 
-CtxHolder Context::innermostFunction()
+CtxId ContextTable::intern(CtxType type, Name name, CtxId parent)
 {
-  Context *c = this;
-  while( c->type == Loop )
-    c = *c->parent;
+  const CtxId recent = entries[parent].recent;
+  if( recent && entries[recent].type == type && entries[recent].name == name )
+    return recent;
 
-  return c;
-}
-
-CtxHolder Context::findCommon(const CtxHolder &other)
-{
-  std::vector<CtxHolder> a, b;
-  flatten(this,a);
-  flatten(other,b);
+  // an ID fits in 30 bits, as a Name does
+  const uint64_t key = ((uint64_t)parent << 34) | ((uint64_t)type << 32) | name.packed;
 
-  const unsigned N=a.size(), M=b.size();
-  unsigned lastGood = 0;
-  for(unsigned i=1; i<=std::min(N,M); ++i)
+  CtxId id;
+  auto found = index.find(key);
+  if( found != index.end() )
+    id = found->second;
+  else
   {
-    if( a[N-i] == b[M-i] )
-      lastGood = i;
-    else
-      return a[N-lastGood];
+    id = entries.size();
+    Context context = { type, name, parent, entries[parent].depth + 1, 0 };
+    entries.push_back(context);
+    index.emplace(key, id);
   }
 
-  return a[N-lastGood];
+  entries[parent].recent = id;
+  return id;
 }
 
-bool Context::operator==(const Context &other) const
+CtxId ContextTable::innermostFunction(CtxId id) const
 {
-  if( type != other.type )
-    return false;
-  else if( name != other.name )
-    return false;
-  else
-    return parent == other.parent;
+  while( entries[id].type == Loop )
+    id = entries[id].parent;
+  return id;
 }
 
-bool Context::operator<(const Context &other) const
+CtxId ContextTable::findCommon(CtxId a, CtxId b) const
 {
-  if( type < other.type )
-    return true;
-  else if( type > other.type )
-    return false;
-
-  else if( name < other.name )
-    return true;
-  else if( name > other.name )
-    return false;
-
-  else if( parent.is_null() && !other.parent.is_null() )
-    return true;
-  else if( !parent.is_null() && other.parent.is_null() )
-    return false;
+  while( entries[a].depth > entries[b].depth )
+    a = entries[a].parent;
+  while( entries[b].depth > entries[a].depth )
+    b = entries[b].parent;
+  while( a != b )
+  {
+    a = entries[a].parent;
+    b = entries[b].parent;
+  }
+  return a;
+}
 
-  else
-    return parent < other.parent;
+std::vector<CtxId> ContextTable::import(const ContextTable &other)
+{
+  // a parent is always interned before its children
+  std::vector<CtxId> ids(other.entries.size(), 0);
+  for(unsigned i=1; i<other.entries.size(); ++i)
+  {
+    const Context &context = other.entries[i];
+    ids[i] = intern(context.type, context.name, ids[ context.parent ]);
+  }
+  return ids;
 }
 
-void Context::print(std::ostream &fout) const
+void ContextTable::print_context(std::ostream &fout, CtxId id) const
 {
   static const char *types[] = {"TOP", "FUNCTION", "LOOP"};
 
-  fout << types[ type ];
-  if( type != Top )
+  const Context &context = entries[id];
+  fout << types[ context.type ];
+  if( context.type != Top )
   {
-    fout << ' ' << name;
-
-    if( !parent.is_null() )
-    {
-      fout << " WITHIN ";
-      parent->print(fout);
-    }
+    fout << ' ' << context.name << " WITHIN ";
+    print_context(fout, context.parent);
   }
 }
 
-std::ostream &operator<<(std::ostream &fout, const CtxHolder &ctx)
+void ContextTable::print(std::ostream &fout, CtxId id) const
 {
   fout << " CONTEXT { ";
-  if( !ctx.is_null() )
-    ctx->print(fout);
+  print_context(fout, id);
   fout << " } ";
-
-  return fout;
 }
 
-
-
@@ -6,36 +6,54 @@
 #include <ostream>
 #include <vector>
 
-#include "holder.h"
+#include "name.h"
+#include "../parallel_hashmap/phmap.h"
 
-// The active caller/loop context.
-struct Context;
-typedef Holder<Context> CtxHolder;
+// A caller/loop context.  Contexts are interned by (type, name, parent):
+// repeated calls from the same site share one node, known by its ID, and
+// two contexts are equal iff their IDs are.  0 is the top context.
+typedef uint32_t CtxId;
 
 enum CtxType { Top=0, Function, Loop };
-struct Context : public RefCount
+struct Context
 {
-  Context(CtxType t = Top) : RefCount(), type(t), name(0), parent(0) {}
-
   CtxType type;
-  const char *name;
-  CtxHolder parent;
+  Name name;
+  CtxId parent;
+  unsigned depth;
 
-  CtxHolder innermostFunction();
-  CtxHolder findCommon(const CtxHolder &other);
+  // The child most recently interned under this one; a loop re-enters the
+  // same iteration context, a caller often calls the same function again.
+  CtxId recent;
+};
 
-  bool operator==(const Context &other) const;
-  bool operator<(const Context &other) const;
+// All contexts of a profiler, in one vector.
+struct ContextTable
+{
+  ContextTable();
 
-  void print(std::ostream &fout) const;
+  CtxId intern(CtxType type, Name name, CtxId parent);
 
-  // This will actually contain only allocation units.
-  // However, that creates a static cycle among types :(
-  typedef std::vector<Holder< RefCount > > AUs;
-  AUs aus;
-};
+  const Context &operator[](CtxId id) const { return entries[id]; }
+
+  CtxId innermostFunction(CtxId id) const;
+  // The innermost context enclosing both.
+  CtxId findCommon(CtxId a, CtxId b) const;
 
-std::ostream &operator<<(std::ostream &fout, const CtxHolder &ctx);
+  // The IDs in this table of all the contexts of `other`.
+  std::vector<CtxId> import(const ContextTable &other);
+
+  size_t size() const { return entries.size(); }
+
+  // " CONTEXT { FUNCTION fn_1 WITHIN TOP } "
+  void print(std::ostream &fout, CtxId id) const;
+
+private:
+  std::vector<Context> entries;
+  phmap::flat_hash_map<uint64_t, CtxId> index;
+
+  void print_context(std::ostream &fout, CtxId id) const;
+};
 
 #endif
 
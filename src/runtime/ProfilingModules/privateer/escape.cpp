@@ -1,49 +1,78 @@
 #include "escape.h"
 
-void EscapeTable::report_escape(const AUHolder &au, const CtxHolder &ctx)
+#include <algorithm>
+
+void EscapeTable::report_escape(const AllocationUnit *au, CtxId ctx)
 {
-  Escape key(au,ctx);
+  if( au->attrs.replica )
+    return;
+
+  Escape key = { AUKey(au), ctx };
   ++escapeFrequencies[key];
 }
 
-void EscapeTable::report_local(const AUHolder &au, const CtxHolder &ctx)
+void EscapeTable::report_local(const AllocationUnit *au, CtxId ctx, const ContextTable &contexts)
 {
-  for(CtxHolder cc=ctx; !cc.is_null(); cc=cc->parent)
+  if( au->attrs.replica )
+    return;
+
+  Escape key = { AUKey(au), ctx };
+  for(;;)
   {
-    Escape key(au,cc);
     ++localFrequencies[key];
+    if( key.ctx == 0 )
+      break;
+    key.ctx = contexts[ key.ctx ].parent;
   }
 }
-void EscapeTable::print(std::ostream &fout) const
+
+static void merge_map(
+  phmap::flat_hash_map<Escape,unsigned> &into,
+  const phmap::flat_hash_map<Escape,unsigned> &from,
+  const std::vector<CtxId> &ctxmap)
 {
-  for(EscapeMap::const_iterator i=escapeFrequencies.begin(), e=escapeFrequencies.end(); i!=e; ++i)
+  for(auto i=from.begin(), e=from.end(); i!=e; ++i)
   {
-    AUHolder au = i->first.first;
-    CtxHolder ctx = i->first.second;
-    unsigned count = i->second;
-
-    fout << "ESCAPE OBJECT " << au << " ESCAPES " << ctx << " COUNT " << count << " ;\n";
+    Escape key = { i->first.au.translate(ctxmap), ctxmap[ i->first.ctx ] };
+    into[key] += i->second;
   }
+}
 
-  for(EscapeMap::const_iterator i=localFrequencies.begin(), e=localFrequencies.end(); i!=e; ++i)
-  {
-    Escape key = i->first;
-
-    if( escapeFrequencies.count(key) )
-      continue;
+void EscapeTable::merge(const EscapeTable &other, const std::vector<CtxId> &ctxmap)
+{
+  merge_map(escapeFrequencies, other.escapeFrequencies, ctxmap);
+  merge_map(localFrequencies, other.localFrequencies, ctxmap);
+}
 
-    unsigned count = i->second;
+// The hash maps have no order; print by AU, then context.
+static std::vector< std::pair<Escape,unsigned> > sorted(const phmap::flat_hash_map<Escape,unsigned> &map)
+{
+  std::vector< std::pair<Escape,unsigned> > entries(map.begin(), map.end());
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
 
-    fout << "LOCAL OBJECT " << key.first << " IS LOCAL TO " << key.second << " COUNT " << count << " ;\n";
+void EscapeTable::print(std::ostream &fout, const ContextTable &contexts) const
+{
+  for(const auto &i : sorted(escapeFrequencies))
+  {
+    fout << "ESCAPE OBJECT ";
+    i.first.au.print(fout, contexts);
+    fout << " ESCAPES ";
+    contexts.print(fout, i.first.ctx);
+    fout << " COUNT " << i.second << " ;\n";
   }
 
+  for(const auto &i : sorted(localFrequencies))
+  {
+    if( escapeFrequencies.count(i.first) )
+      continue;
 
+    fout << "LOCAL OBJECT ";
+    i.first.au.print(fout, contexts);
+    fout << " IS LOCAL TO ";
+    contexts.print(fout, i.first.ctx);
+    fout << " COUNT " << i.second << " ;\n";
+  }
 }
 
-std::ostream &operator<<(std::ostream &fout, const EscapeTable &et)
-{
-  et.print(fout);
-  return fout;
-}
-
-
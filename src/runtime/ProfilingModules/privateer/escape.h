@@ -1,27 +1,46 @@
 #ifndef SPECPRIV_ESCAPE_H
 #define SPECPRIV_ESCAPE_H
 
-#include "holder.h"
 #include "live.h"
 #include "context.h"
 
 #include <ostream>
+#include <vector>
 
-typedef std::pair<AUHolder, CtxHolder> Escape;
+// An AU escaping from, or local to, a context.
+struct Escape
+{
+  AUKey au;
+  CtxId ctx;
+
+  bool operator==(const Escape &other) const { return au == other.au && ctx == other.ctx; }
+  bool operator<(const Escape &other) const
+  {
+    if( !(au == other.au) )
+      return au < other.au;
+    return ctx < other.ctx;
+  }
+
+  friend size_t hash_value(const Escape &key)
+  {
+    return hash_value(key.au) * 0x9e3779b97f4a7c15ULL + key.ctx;
+  }
+};
 
 struct EscapeTable
 {
-  void report_escape(const AUHolder &, const CtxHolder &);
-  void report_local(const AUHolder &, const CtxHolder &);
+  void report_escape(const AllocationUnit *, CtxId);
+  // local to the context and all those enclosing it
+  void report_local(const AllocationUnit *, CtxId, const ContextTable &);
 
-  void print(std::ostream &fout) const;
+  void print(std::ostream &fout, const ContextTable &contexts) const;
+  // `ctxmap` translates the context IDs of `other` to ours.
+  void merge(const EscapeTable &other, const std::vector<CtxId> &ctxmap);
 
 private:
-  typedef std::map<Escape,unsigned> EscapeMap;
+  typedef phmap::flat_hash_map<Escape,unsigned> EscapeMap;
   EscapeMap escapeFrequencies, localFrequencies;
 };
 
-std::ostream &operator<<(std::ostream &fout, const EscapeTable &et);
-
 #endif
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 
@@ -20,23 +21,29 @@ void right_open_interval::print(std::ostream &fout) const
   fout << '[' << low << ", " << high << ')';
 }
 
-bool AllocationUnit::operator<(const AllocationUnit &other) const
+AllocationUnit *AllocationUnit::Null()
 {
-  if( type < other.type )
-    return true;
-  else if( type > other.type )
-    return false;
+  static AllocationUnit null(AU_Null);
+  return &null;
+}
 
-  else if( name < other.name )
-    return true;
-  else if( name > other.name )
-    return false;
+AllocationUnit *AllocationUnit::Unknown()
+{
+  static AllocationUnit unknown(AU_Unknown);
+  return &unknown;
+}
 
+bool AUKey::operator<(const AUKey &other) const
+{
+  if( type != other.type )
+    return type < other.type;
+  else if( name != other.name )
+    return name < other.name;
   else
     return creation < other.creation;
 }
 
-void AllocationUnit::print(std::ostream &fout) const
+void AUKey::print(std::ostream &fout, const ContextTable &contexts) const
 {
   const char *types[] = {
     "NULL", "UNKNOWN", "CONSTANT",
@@ -47,57 +54,165 @@ void AllocationUnit::print(std::ostream &fout) const
   {
     fout << name;
     if( type != AU_Global && type != AU_Constant)
-      fout << " FROM " << creation;
+    {
+      fout << " FROM ";
+      contexts.print(fout, creation);
+    }
   }
 }
 
-std::ostream &operator<<(std::ostream &fout, const AUHolder &au)
-{
-  if( au.is_null() )
-    fout << "BAD-AU";
-  else
-    au->print(fout);
-  return fout;
-}
-
-uint64_t operator-(void *ptr, const AUHolder &au)
+uint64_t AllocationUnit::offset(void *ptr) const
 {
-  if( au->type == AU_Unknown || au->type == AU_Null )
+  if( type == AU_Unknown || type == AU_Null )
     return 0;
 
   uint64_t addr = (uint64_t)ptr;
-  const right_open_interval &interval = au->extents;
+  const right_open_interval &interval = extents;
 
 //  trailing_assert( interval.low <= addr && addr < interval.high );
 
   return addr - interval.low;
 }
 
+// AUs come and go with every allocation of the profiled program, so they are
+// recycled instead of going through malloc.
+AllocationUnit *AllocationUnitTable::create(AUType type, const right_open_interval &extents, Name name, CtxId ctx)
+{
+  if( unused.empty() )
+  {
+    slabs.emplace_back( new AllocationUnit[SLAB_SIZE] );
+    AllocationUnit *slab = slabs.back().get();
+    for(unsigned i=SLAB_SIZE; i>0; --i)
+      unused.push_back( &slab[i-1] );
+  }
+
+  AllocationUnit *au = unused.back();
+  unused.pop_back();
+  *au = AllocationUnit(type,extents,name,ctx);
+  return au;
+}
+
+void AllocationUnitTable::release(AllocationUnit *au)
+{
+  unused.push_back(au);
+}
+
 bool AllocationUnitTable::count(const right_open_interval &key) const
 {
   return temporaries.count(key) || permanents.count(key);
 }
 
-AUHolder AllocationUnitTable::lookupPointer(void *ptr)
+void AllocationUnitTable::insert(AllocationUnitMap &map, AllocationUnit *au)
+{
+  map[ au->extents ] = au;
+
+  const right_open_interval &extents = au->extents;
+  if( extents.size() == 0 )
+    return;
+  const uint64_t first = extents.low >> PAGE_SHIFT;
+  const uint64_t last = (extents.high - 1) >> PAGE_SHIFT;
+  if( last - first >= DIRECTORY_MAX_PAGES )
+    return;
+
+  for(uint64_t page = first; page <= last; ++page)
+  {
+    PageEntry &entry = directory[page];
+    PageEntry::iterator j = std::upper_bound(entry.begin(), entry.end(), extents.low,
+      [](uint64_t low, const AllocationUnit *other) { return low < other->extents.low; });
+    entry.insert(j, au);
+  }
+}
+
+void AllocationUnitTable::erase(AllocationUnitMap &map, AllocationUnitMap::iterator i)
+{
+  forget( i->second );
+  map.erase(i);
+}
+
+// Drop an AU from the cache and the directory; must be called with the same
+// extents it was inserted with.
+void AllocationUnitTable::forget(AllocationUnit *au)
+{
+  AllocationUnit **end = std::remove(recentlyUsed, recentlyUsed + CACHE_SIZE, au);
+  std::fill(end, recentlyUsed + CACHE_SIZE, (AllocationUnit *) 0);
+
+  const right_open_interval &extents = au->extents;
+  if( extents.size() == 0 )
+    return;
+  const uint64_t first = extents.low >> PAGE_SHIFT;
+  const uint64_t last = (extents.high - 1) >> PAGE_SHIFT;
+  if( last - first >= DIRECTORY_MAX_PAGES )
+    return;
+
+  for(uint64_t page = first; page <= last; ++page)
+  {
+    PageDirectory::iterator j = directory.find(page);
+    if( j == directory.end() )
+      continue;
+    PageEntry &entry = j->second;
+    entry.erase( std::remove(entry.begin(), entry.end(), au), entry.end() );
+    if( entry.empty() )
+      directory.erase(j);
+  }
+}
+
+AllocationUnit *AllocationUnitTable::lookupDirectory(uint64_t iptr) const
+{
+  PageDirectory::const_iterator j = directory.find(iptr >> PAGE_SHIFT);
+  if( j == directory.end() )
+    return 0;
+
+  // the last AU starting at or before iptr
+  const PageEntry &entry = j->second;
+  PageEntry::const_iterator k = std::upper_bound(entry.begin(), entry.end(), iptr,
+    [](uint64_t ptr, const AllocationUnit *au) { return ptr < au->extents.low; });
+  if( k == entry.begin() )
+    return 0;
+  --k;
+  if( (*k)->extents.includes( (void *) iptr ) )
+    return *k;
+  return 0;
+}
+
+// Move an AU to the front of the cache.
+AllocationUnit *AllocationUnitTable::remember(AllocationUnit *au)
+{
+  AllocationUnit **pos = std::find(recentlyUsed, recentlyUsed + CACHE_SIZE - 1, au);
+  std::copy_backward(recentlyUsed, pos, pos + 1);
+  recentlyUsed[0] = au;
+  return au;
+}
+
+AllocationUnit *AllocationUnitTable::lookupPointer(void *ptr)
 {
   if( !ptr )
     return AllocationUnit::Null();
 
-  if( ! mostRecentlyUsed.is_null() )
-    if( mostRecentlyUsed->extents.includes(ptr) )
-      return mostRecentlyUsed;
+  for(unsigned c=0; c<CACHE_SIZE && recentlyUsed[c]; ++c)
+    if( recentlyUsed[c]->extents.includes(ptr) )
+    {
+      ++num_cache_hits;
+      return remember( recentlyUsed[c] );
+    }
+
+  if( AllocationUnit *au = lookupDirectory( (uint64_t)ptr ) )
+  {
+    ++num_directory_hits;
+    return remember(au);
+  }
 
+  ++num_tree_lookups;
   right_open_interval key(ptr);
 
   // First look for proper inclusion in temporary AUs...
   AllocationUnitMap::iterator i = temporaries.find( key );
   if( i != temporaries.end() )
-    return mostRecentlyUsed = i->second;
+    return remember( i->second );
 
   // ... proper inclusion in permanents...
   i = permanents.find( key );
   if( i != permanents.end() )
-    return mostRecentlyUsed = i->second;
+    return remember( i->second );
 
   // Some codes do ugly things, such as compute a pointer
   // just beyond an AU, and use that as an iteration
@@ -116,7 +231,7 @@ AUHolder AllocationUnitTable::lookupPointer(void *ptr)
       --i;
       uint64_t delta = ((uint64_t) ptr) - i->first.high;
       if( delta < 16 )
-        return mostRecentlyUsed = i->second;
+        return remember( i->second );
     }
   }
 
@@ -128,7 +243,7 @@ AUHolder AllocationUnitTable::lookupPointer(void *ptr)
       --i;
       uint64_t delta = ((uint64_t) ptr) - i->first.high;
       if( delta < 16 )
-        return mostRecentlyUsed = i->second;
+        return remember( i->second );
     }
 
   // Widen null a bit.
@@ -138,13 +253,12 @@ AUHolder AllocationUnitTable::lookupPointer(void *ptr)
   return AllocationUnit::Unknown();
 }
 
-AUHolder AllocationUnitTable::add_temporary(AUType type, const right_open_interval &extents, const char *name, const CtxHolder &ctx)
+AllocationUnit *AllocationUnitTable::add_temporary(AUType type, const right_open_interval &extents, Name name, CtxId ctx)
 {
-  AUHolder au = new AllocationUnit(type,extents,name,ctx);
-  return add_temporary(au);
+  return add_temporary( create(type,extents,name,ctx) );
 }
 
-AUHolder AllocationUnitTable::add_temporary(const AUHolder &au)
+AllocationUnit *AllocationUnitTable::add_temporary(AllocationUnit *au)
 {
   /* moved to Profiler::add_temporary_au
   AllocationUnitMap::iterator i = temporaries.find( au->extents  );
@@ -158,9 +272,10 @@ AUHolder AllocationUnitTable::add_temporary(const AUHolder &au)
     // times (which can happen, for instance, if lifetime.start/.end
     // intrinsics are placed in a way that allows you to visit
     // lifetime.start twice before lifetime.end...
-    if( au == i->second )
+    if( *au == *i->second )
     {
 //      std::cerr << "Warning: pesky lifetime.start/.end pattern\n";
+      release(au);
       return i->second; // okay
     }
 
@@ -168,7 +283,9 @@ AUHolder AllocationUnitTable::add_temporary(const AUHolder &au)
     // the excess after shrinking an object with realloc().
     else if( i->second->attrs.realloc_shrink_excess )
     {
-      temporaries.erase(i);
+      AllocationUnit *excess = i->second;
+      erase(temporaries, i);
+      release(excess);
     }
 
     else
@@ -190,17 +307,17 @@ AUHolder AllocationUnitTable::add_temporary(const AUHolder &au)
   }
 
   trailing_assert( !permanents.count( au->extents ) && "repeat address t-p" );
-  temporaries[ au->extents ] = au;
+  insert(temporaries, au);
   if( DEBUG )
-    fprintf(stderr, "+T [%lx, %lx)   %s\n", au->extents.low, au->extents.high, au->name);
+    fprintf(stderr, "+T [%lx, %lx)   %s\n", au->extents.low, au->extents.high, au->name.str().c_str());
   if( temporaries.size() > peak_temporaries )
     peak_temporaries = temporaries.size();
   return au;
 }
 
-AUHolder AllocationUnitTable::add_permanent(AUType type, const right_open_interval &extents, const char *name, const CtxHolder &ctx)
+AllocationUnit *AllocationUnitTable::add_permanent(AUType type, const right_open_interval &extents, Name name, CtxId ctx)
 {
-  AUHolder au = new AllocationUnit(type,extents,name,ctx);
+  AllocationUnit *au = create(type,extents,name,ctx);
   trailing_assert( !temporaries.count( au->extents ) && "repeat address p-t" );
 
   // Unfortunately, constant variables in llvm
@@ -231,7 +348,7 @@ AUHolder AllocationUnitTable::add_permanent(AUType type, const right_open_interv
       if( i == permanents.end() )
         break; // no more collisions :)
 
-      AUHolder collision = i->second;
+      AllocationUnit *collision = i->second;
       trailing_assert( collision->type == AU_Constant && "Collisions only acceptable among constants");
 
       ++num_split_constants;
@@ -239,12 +356,14 @@ AUHolder AllocationUnitTable::add_permanent(AUType type, const right_open_interv
       if( au->extents.is_wholly_within( collision->extents ) )
       {
         // easiest case: do not insert the new constant.
+        release(au);
         return collision;
       }
       else if( collision->extents.is_wholly_within( au->extents ) )
       {
         // slightly harder; replace old constant with new one.
-        permanents.erase( i );
+        erase( permanents, i );
+        release(collision);
       }
       else if( au->extents.low < collision->extents.low )
       {
@@ -254,33 +373,32 @@ AUHolder AllocationUnitTable::add_permanent(AUType type, const right_open_interv
       else
       {
         // Update the old AU's extents so it doesn't collide.
-        permanents.erase( i );
+        erase( permanents, i );
         collision->extents.high = au->extents.low;
-        permanents[ collision->extents ] = collision;
+        insert( permanents, collision );
       }
     }
   }
 
   trailing_assert( !permanents.count( au->extents ) && "repeat address p-p" );
-  permanents[ au->extents ] = au;
+  insert(permanents, au);
   if( DEBUG )
-    fprintf(stderr, "+P [%lx, %lx)   %s\n", au->extents.low, au->extents.high, au->name);
+    fprintf(stderr, "+P [%lx, %lx)   %s\n", au->extents.low, au->extents.high, au->name.str().c_str());
   if( permanents.size() > peak_permanents )
     peak_permanents = permanents.size();
   return au;
 }
 
-void AllocationUnitTable::remove(const AUHolder &au)
+void AllocationUnitTable::remove(AllocationUnit *au)
 {
   AllocationUnitMap::iterator i = temporaries.find( au->extents );
   trailing_assert( i != temporaries.end() && "Can't remove");
 
-  if( au == mostRecentlyUsed )
-    mostRecentlyUsed = 0;
-
-  temporaries.erase(i);
   if( DEBUG )
-    fprintf(stderr, "-T [%lx, %lx)   %s\n", au->extents.low, au->extents.high, au->name);
+    fprintf(stderr, "-T [%lx, %lx)   %s\n", au->extents.low, au->extents.high, au->name.str().c_str());
+  AllocationUnit *found = i->second;
+  erase(temporaries, i);
+  release(found);
 }
 
 void AllocationUnitTable::print(std::ostream &fout) const
@@ -288,6 +406,19 @@ void AllocationUnitTable::print(std::ostream &fout) const
   fout << "# Peak temporaries " << peak_temporaries << '\n';
   fout << "# Peak permanents " << peak_permanents << '\n';
   fout << "# Split constants " << num_split_constants << '\n';
+  fout << "# Lookup cache hits " << num_cache_hits << '\n';
+  fout << "# Directory hits " << num_directory_hits << '\n';
+  fout << "# Tree lookups " << num_tree_lookups << '\n';
+}
+
+void AllocationUnitTable::merge_stats(const AllocationUnitTable &other)
+{
+  peak_permanents = std::max(peak_permanents, other.peak_permanents);
+  peak_temporaries = std::max(peak_temporaries, other.peak_temporaries);
+  num_split_constants = std::max(num_split_constants, other.num_split_constants);
+  num_cache_hits += other.num_cache_hits;
+  num_directory_hits += other.num_directory_hits;
+  num_tree_lookups += other.num_tree_lookups;
 }
 
 std::ostream &operator<<(std::ostream &fout, const right_open_interval &roi)
@@ -4,10 +4,12 @@
 #include <cstdlib>
 #include <cassert>
 #include <map>
+#include <memory>
 #include <stdint.h>
 #include <ostream>
+#include <unordered_map>
+#include <vector>
 
-#include "holder.h"
 #include "context.h"
 
 
@@ -45,74 +47,158 @@ struct right_open_interval
 enum AUType { AU_Null=0, AU_Unknown, AU_Constant, AU_Global, AU_Stack, AU_Heap };
 struct AUAttributes
 {
-  AUAttributes() : realloc_shrink_excess(false) {}
+  AUAttributes() : realloc_shrink_excess(false), replica(false) {}
 
   bool                realloc_shrink_excess:1;
+  // Tracked by a shard that does not own the base address; another shard
+  // reports it.
+  bool                replica:1;
 };
-struct AllocationUnit : public RefCount
-{
-  AUType              type;
-  AUAttributes        attrs;
-  right_open_interval extents;
-  const char        * name;
-  CtxHolder           creation;
-  CtxHolder           deletion;
 
-  AllocationUnit(AUType t=AU_Unknown, const right_open_interval &e=(void*)0, const char *n=0, const CtxHolder &c=0)
-    : RefCount(), type(t), attrs(), extents(e), name(n), creation(c) {}
+struct AllocationUnit;
+
+// What the profile knows an AU by: AUs with the same type, name and
+// creation context are counted together.
+struct AUKey
+{
+  AUKey() : type(AU_Null), name(), creation(0) {}
+  AUKey(AUType t, Name n, CtxId c) : type(t), name(n), creation(c) {}
+  AUKey(const AllocationUnit *au);
 
-  static AllocationUnit *Null() { return new AllocationUnit(AU_Null); }
-  static AllocationUnit *Unknown() { return new AllocationUnit(AU_Unknown); }
+  AUType              type;
+  Name                name;
+  CtxId               creation;
 
-  bool operator==(const AllocationUnit &other) const
+  bool operator==(const AUKey &other) const
   {
     return type == other.type
     &&     name == other.name
-//    &&     extents == other.extents
     &&     creation == other.creation;
   }
 
-  bool operator<(const AllocationUnit &other) const;
+  bool operator<(const AUKey &other) const;
 
-  void print(std::ostream &fout) const;
+  // After merging the contexts of another shard.
+  AUKey translate(const std::vector<CtxId> &ctxmap) const
+  {
+    return AUKey(type, name, ctxmap[creation]);
+  }
+
+  void print(std::ostream &fout, const ContextTable &contexts) const;
+
+  friend size_t hash_value(const AUKey &key)
+  {
+    return ((uint64_t)key.creation << 35) ^ ((uint64_t)key.type << 32) ^ key.name.packed;
+  }
 };
 
-typedef Holder<AllocationUnit> AUHolder;
+struct AllocationUnit
+{
+  AUType              type;
+  AUAttributes        attrs;
+  right_open_interval extents;
+  Name                name;
+  CtxId               creation;
+  CtxId               deletion;
+  // When the profiler listed it in its creation context, 0 if it did not.
+  uint64_t            listed;
+
+  AllocationUnit(AUType t=AU_Unknown, const right_open_interval &e=(void*)0, Name n=Name(), CtxId c=0)
+    : type(t), attrs(), extents(e), name(n), creation(c), deletion(0), listed(0) {}
 
-std::ostream &operator<<(std::ostream &fout, const right_open_interval &roi);
-std::ostream &operator<<(std::ostream &fout, const AUHolder &au);
+  // Shared, they are never modified.
+  static AllocationUnit *Null();
+  static AllocationUnit *Unknown();
+
+  bool operator==(const AllocationUnit &other) const
+  {
+    return AUKey(this) == AUKey(&other);
+  }
+  bool operator!=(const AllocationUnit &other) const { return !(*this == other); }
 
+  // Determine offset of pointer within allocation unit.
+  uint64_t offset(void *ptr) const;
+};
 
-// Determine offset of pointer within allocation unit.
-uint64_t operator-(void *, const AUHolder &);
+inline AUKey::AUKey(const AllocationUnit *au) : type(au->type), name(au->name), creation(au->creation) {}
 
+std::ostream &operator<<(std::ostream &fout, const right_open_interval &roi);
+
+// The live AUs.  The table owns them: they are carved out of slabs, and
+// recycled when they are removed.
 struct AllocationUnitTable
 {
   AllocationUnitTable()
-    : permanents(), temporaries(), peak_permanents(0), peak_temporaries(0), num_split_constants(0) {}
+    : permanents(), temporaries(), directory(), recentlyUsed(),
+      slabs(), unused(),
+      peak_permanents(0), peak_temporaries(0), num_split_constants(0),
+      num_cache_hits(0), num_directory_hits(0), num_tree_lookups(0) {}
+
+  AllocationUnitTable(const AllocationUnitTable &) = delete;
+  AllocationUnitTable &operator=(const AllocationUnitTable &) = delete;
 
   // A binary tree of NON-OVERLAPPING intervals.
-  typedef std::map< right_open_interval, AUHolder > AllocationUnitMap;
+  typedef std::map< right_open_interval, AllocationUnit * > AllocationUnitMap;
 
 
   bool count(const right_open_interval &) const;
-  AUHolder lookupPointer(void *);
+  AllocationUnit *lookupPointer(void *);
 
-  AUHolder add_temporary(AUType,const right_open_interval &, const char *, const CtxHolder &);
-  AUHolder add_temporary(const AUHolder &);
-  AUHolder add_permanent(AUType,const right_open_interval &, const char *, const CtxHolder &);
+  // A new AU, not yet in the table.
+  AllocationUnit *create(AUType,const right_open_interval &, Name, CtxId);
 
-  void remove(const AUHolder &);
+  // If the AU is a repeat of a live one, it is released and the live one
+  // returned.
+  AllocationUnit *add_temporary(AUType,const right_open_interval &, Name, CtxId);
+  AllocationUnit *add_temporary(AllocationUnit *);
+  AllocationUnit *add_permanent(AUType,const right_open_interval &, Name, CtxId);
+
+  // Releases the AU.
+  void remove(AllocationUnit *);
+
+  template <class Visitor>
+  void for_each_temporary(Visitor visit) const
+  {
+    for(AllocationUnitMap::const_iterator i=temporaries.begin(), e=temporaries.end(); i!=e; ++i)
+      visit(i->second);
+  }
 
   void print(std::ostream &) const;
+  void merge_stats(const AllocationUnitTable &);
 
 private:
   AllocationUnitMap permanents, temporaries;
-  AUHolder  mostRecentlyUsed;
+
+  // Page -> the AUs overlapping it, sorted by their low address.  Only AUs up
+  // to DIRECTORY_MAX_PAGES pages are indexed; larger ones are found in the
+  // maps (and then stay in the cache).
+  static const unsigned PAGE_SHIFT = 12;
+  static const uint64_t DIRECTORY_MAX_PAGES = 16;
+  typedef std::vector<AllocationUnit *> PageEntry;
+  typedef std::unordered_map<uint64_t, PageEntry> PageDirectory;
+  PageDirectory directory;
+
+  // Recently resolved AUs, most recent first.
+  static const unsigned CACHE_SIZE = 8;
+  AllocationUnit *recentlyUsed[CACHE_SIZE];
+
+  // Slabs of AUs, and the free ones among them.
+  static const unsigned SLAB_SIZE = 1024;
+  std::vector< std::unique_ptr<AllocationUnit[]> > slabs;
+  std::vector<AllocationUnit *> unused;
+
+  void release(AllocationUnit *);
+
+  void insert(AllocationUnitMap &, AllocationUnit *);
+  void erase(AllocationUnitMap &, AllocationUnitMap::iterator);
+  void forget(AllocationUnit *);
+  AllocationUnit *lookupDirectory(uint64_t) const;
+  AllocationUnit *remember(AllocationUnit *);
 
   // statistics
   unsigned peak_permanents, peak_temporaries;
   unsigned num_split_constants;
+  uint64_t num_cache_hits, num_directory_hits, num_tree_lookups;
 };
 
 std::ostream &operator<<(std::ostream &fout, const AllocationUnitTable &aut);
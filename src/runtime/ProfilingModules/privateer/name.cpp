@@ -0,0 +1,35 @@
+#include "name.h"
+#include "../slamp_symbols.h"
+
+#include <sstream>
+
+static const char *prefixes[] = {"", "inst_", "fn_", "loop_"};
+static const slamp::SymbolKind kinds[] = {
+  slamp::SymbolKind::INSTRUCTION, slamp::SymbolKind::INSTRUCTION,
+  slamp::SymbolKind::FUNCTION, slamp::SymbolKind::LOOP};
+
+void Name::print(std::ostream &fout) const
+{
+  if( is_null() )
+    return;
+
+  // the name from the symbol table of the program, if it has one
+  std::string_view symbol = slamp::symbols().lookup(kinds[ kind() ], id());
+  if( !symbol.empty() )
+    fout << symbol;
+  else
+    fout << prefixes[ kind() ] << id();
+}
+
+std::string Name::str() const
+{
+  std::ostringstream sout;
+  print(sout);
+  return sout.str();
+}
+
+std::ostream &operator<<(std::ostream &fout, const Name &name)
+{
+  name.print(fout);
+  return fout;
+}
@@ -0,0 +1,37 @@
+#ifndef SPECPRIV_NAME_H
+#define SPECPRIV_NAME_H
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+
+// Instructions, functions and loops are known by their IDs.  The profile
+// spells them with the names of the program's symbol table, or "inst_12",
+// "fn_3" and "loop_7" without one, but that only happens when the results are
+// printed; until then they are packed integers.
+enum NameKind { NoName=0, InstName, FcnName, LoopName };
+
+struct Name
+{
+  static const unsigned ID_BITS = 30;
+
+  Name() : packed(0) {}
+  Name(NameKind kind, uint32_t id) : packed( ((uint32_t)kind << ID_BITS) | id ) {}
+
+  NameKind kind() const { return (NameKind)(packed >> ID_BITS); }
+  uint32_t id() const { return packed & ((1u << ID_BITS) - 1); }
+  bool is_null() const { return packed == 0; }
+
+  bool operator==(const Name &other) const { return packed == other.packed; }
+  bool operator!=(const Name &other) const { return packed != other.packed; }
+  bool operator<(const Name &other) const { return packed < other.packed; }
+
+  std::string str() const;
+  void print(std::ostream &fout) const;
+
+  uint32_t packed;
+};
+
+std::ostream &operator<<(std::ostream &fout, const Name &name);
+
+#endif
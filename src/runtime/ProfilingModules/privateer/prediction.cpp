@@ -1,38 +1,30 @@
 #include "trailing_assert.h"
 #include "prediction.h"
 
+#include <algorithm>
+
 void IntSample::receive(const IntSample &other)
 {
 //  trailing_assert( *this == other );
   frequency += other.frequency;
 }
 
-void IntSample::print(std::ostream &fout) const
+void IntSample::print(std::ostream &fout, const ContextTable &) const
 {
   fout << "INT " << value << " COUNT " << frequency;
 }
 
-void PtrSample::print(std::ostream &fout) const
+void PtrSample::print(std::ostream &fout, const ContextTable &contexts) const
 {
-  if( au.is_null() )
+  if( empty() )
   {
     fout << "NO-SAMPLE";
     return;
   }
 
-  fout << "OFFSET " << offset << " BASE " << au << " COUNT " << frequency;
-}
-
-std::ostream &operator<<(std::ostream &fout, const IntSample &sample)
-{
-  sample.print(fout);
-  return fout;
-}
-
-std::ostream &operator<<(std::ostream &fout, const PtrSample &sample)
-{
-  sample.print(fout);
-  return fout;
+  fout << "OFFSET " << offset << " BASE ";
+  au.print(fout, contexts);
+  fout << " COUNT " << frequency;
 }
 
 void PtrResidueSet::receive(void *sample)
@@ -45,6 +37,12 @@ void PtrResidueSet::receive(void *sample)
   residue_set |= bit_vector;
 }
 
+void PtrResidueSet::merge(const PtrResidueSet &other, const std::vector<CtxId> &)
+{
+  num_samples += other.num_samples;
+  residue_set |= other.residue_set;
+}
+
 std::ostream &operator<<(std::ostream &fout, const PtrResidueSet &residues)
 {
   residues.print(fout);
@@ -83,9 +81,9 @@ void PtrResidueSet::print(std::ostream &fout) const
 }
 
 PtrSample::PtrSample()
-  : au(0), offset(0), frequency(0) {}
+  : au(), offset(0), frequency(0) {}
 
-PtrSample::PtrSample(const AUHolder &AU, uint64_t off)
+PtrSample::PtrSample(const AllocationUnit *AU, uint64_t off)
   : au(AU), offset(off), frequency(1) {}
 
 bool PtrSample::operator==(const PtrSample &other) const
@@ -99,94 +97,127 @@ void PtrSample::receive(const PtrSample &other)
   frequency += other.frequency;
 }
 
-std::ostream &operator<<(std::ostream &fout, const PredictionTable &pt)
+PtrSample PtrSample::translate(const std::vector<CtxId> &ctxmap) const
 {
-  pt.print(fout);
-  return fout;
+  PtrSample sample(*this);
+  sample.au = au.translate(ctxmap);
+  return sample;
 }
 
-void PredictionTable::predict_int(const CtxHolder &ctx, const char *name, const IntSample &sample)
+void PredictionTable::predict_int(CtxId ctx, Name name, const IntSample &sample)
 {
-  CtxValue key(name,ctx);
-  intPredictions[key].receive(sample);
+  intPredictions[ key(ctx,name) ].receive(sample);
 }
 
-void PredictionTable::predict_ptr(const CtxHolder &ctx, const char *name, const PtrSample &sample)
+void PredictionTable::predict_ptr(CtxId ctx, Name name, const PtrSample &sample)
 {
-  CtxValue key(name,ctx);
-  ptrPredictions[key].receive(sample);
+  ptrPredictions[ key(ctx,name) ].receive(sample);
 }
 
-void PredictionTable::find_underlying_object(const CtxHolder &ctx, const char *name, const PtrSample &sample)
+void PredictionTable::find_underlying_object(CtxId ctx, Name name, const PtrSample &sample)
 {
-  CtxValue key(name,ctx);
-  objPredictions[key].receive(sample);
+  objPredictions[ key(ctx,name) ].receive(sample);
 }
 
-void PredictionTable::pointer_residue(const CtxHolder &ctx, const char *name, void *sample)
+void PredictionTable::pointer_residue(CtxId ctx, Name name, void *sample)
 {
-  CtxValue key(name,ctx);
-  ptrResidues[key].receive(sample);
+  ptrResidues[ key(ctx,name) ].receive(sample);
 }
 
-void PredictionTable::exit_ctx(const CtxHolder &ctx)
+void PredictionTable::exit_ctx(CtxId ctx)
 {
 }
 
+template <class MapTy>
+static void merge_map(MapTy &into, const MapTy &from, const std::vector<CtxId> &ctxmap)
+{
+  for(typename MapTy::const_iterator i=from.begin(), e=from.end(); i!=e; ++i)
+  {
+    const uint64_t name = i->first >> 32;
+    const CtxId ctx = ctxmap[ (uint32_t)i->first ];
+    into[ (name << 32) | ctx ].merge(i->second, ctxmap);
+  }
+}
+
+void PredictionTable::merge(const PredictionTable &other, const std::vector<CtxId> &ctxmap)
+{
+  merge_map(intPredictions, other.intPredictions, ctxmap);
+  merge_map(ptrPredictions, other.ptrPredictions, ctxmap);
+  merge_map(objPredictions, other.objPredictions, ctxmap);
+  merge_map(ptrResidues, other.ptrResidues, ctxmap);
+}
+
+// The hash maps have no order; print by name, then context.
+template <class MapTy>
+static std::vector<typename MapTy::const_pointer> sorted(const MapTy &map)
+{
+  std::vector<typename MapTy::const_pointer> entries;
+  entries.reserve(map.size());
+  for(typename MapTy::const_iterator i=map.begin(), e=map.end(); i!=e; ++i)
+    entries.push_back( &*i );
+  std::sort(entries.begin(), entries.end(),
+    [](typename MapTy::const_pointer a, typename MapTy::const_pointer b) { return a->first < b->first; });
+  return entries;
+}
+
+static Name name_of(uint64_t key)
+{
+  Name name;
+  name.packed = key >> 32;
+  return name;
+}
+
 template <class SetTy>
 void PredictionTable::print_samples(
   std::ostream &fout,
-  const char *key,
-  const SetTy &set) const
+  const char *kind,
+  const SetTy &set,
+  const ContextTable &contexts) const
 {
-  fout << "# " << key << " size " << set.size() << '\n';
+  fout << "# " << kind << " size " << set.size() << '\n';
 
-  for(typename SetTy::const_iterator i=set.begin(), e=set.end(); i!=e; ++i)
+  for(typename SetTy::const_pointer i : sorted(set))
   {
     const typename SetTy::mapped_type &samples = i->second;
     if( !samples.is_worth_printing() )
       continue;
 
-    const char *name = i->first.first;
-    CtxHolder ctx = i->first.second;
-
     // Comment-out bottom samples
     if( samples.is_bottom() )
       fout << '#';
 
-    fout << "PRED " << key
-         << ' ' << name
-         << " AT " << ctx
-         << " AS " << samples << " ;\n";
+    fout << "PRED " << kind
+         << ' ' << name_of(i->first)
+         << " AT ";
+    contexts.print(fout, (uint32_t)i->first);
+    fout << " AS ";
+    samples.print(fout, contexts);
+    fout << " ;\n";
   }
 }
 
-void PredictionTable::print_residues(std::ostream &fout) const
+void PredictionTable::print_residues(std::ostream &fout, const ContextTable &contexts) const
 {
   fout << "# residue map size " << ptrResidues.size() << '\n';
 
-  for(PtrResidueMap::const_iterator i=ptrResidues.begin(), e=ptrResidues.end(); i!=e; ++i)
+  for(PtrResidueMap::const_pointer i : sorted(ptrResidues))
   {
     const PtrResidueSet &residues = i->second;
     if( !residues.is_worth_printing() )
       continue;
 
-    const char *name = i->first.first;
-    CtxHolder ctx = i->first.second;
-
     fout << "PTR RESIDUES "
-         << name
-         << " AT " << ctx
-         << " AS " << residues << " ;\n";
+         << name_of(i->first)
+         << " AT ";
+    contexts.print(fout, (uint32_t)i->first);
+    fout << " AS " << residues << " ;\n";
   }
 }
 
-void PredictionTable::print(std::ostream &fout) const
+void PredictionTable::print(std::ostream &fout, const ContextTable &contexts) const
 {
-  print_samples(fout, "INT", intPredictions);
-  print_samples(fout, "PTR", ptrPredictions);
-  print_samples(fout, "OBJ", objPredictions);
-  print_residues(fout);
+  print_samples(fout, "INT", intPredictions, contexts);
+  print_samples(fout, "PTR", ptrPredictions, contexts);
+  print_samples(fout, "OBJ", objPredictions, contexts);
+  print_residues(fout, contexts);
 }
-
-
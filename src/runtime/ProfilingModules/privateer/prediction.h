@@ -6,6 +6,7 @@
 #include "live.h"
 
 #include <ostream>
+#include <vector>
 
 struct IntSample
 {
@@ -19,20 +20,19 @@ struct IntSample
   bool operator==(const IntSample &other) const { return value == other.value; }
 
   void receive(const IntSample &other);
+  IntSample translate(const std::vector<CtxId> &) const { return *this; }
 
-  void print(std::ostream &fout) const;
+  void print(std::ostream &fout, const ContextTable &) const;
 
   bool is_worth_printing() const { return frequency>0; }
 };
 
-std::ostream &operator<<(std::ostream &fout, const IntSample &sample);
-
 struct PtrSample
 {
   PtrSample();
-  PtrSample(const AUHolder &, uint64_t offs=0);
+  PtrSample(const AllocationUnit *, uint64_t offs=0);
 
-  AUHolder      au;
+  AUKey         au;
   uint64_t      offset;
 
   uint64_t      frequency;
@@ -41,21 +41,21 @@ struct PtrSample
   bool operator==(const PtrSample &other) const;
 
   void receive(const PtrSample &other);
+  PtrSample translate(const std::vector<CtxId> &ctxmap) const;
 
-  void print(std::ostream &fout) const;
+  void print(std::ostream &fout, const ContextTable &contexts) const;
 
   bool is_worth_printing() const { return frequency>0; }
 };
 
-std::ostream &operator<<(std::ostream &fout, const PtrSample &sample);
-
-// SampleType must support .empty(), ==, +=, <<, and .frequency
+// SampleType must support .empty(), ==, .receive(), .translate(), .print()
+// and .frequency
 template <class SampleType, const unsigned N>
 struct SampleSet
 {
   SampleSet() : bottom(false), numSamples(0) {}
 
-  void print(std::ostream &fout) const
+  void print(std::ostream &fout, const ContextTable &contexts) const
   {
     if( bottom )
       fout << "UNPREDICTABLE ";
@@ -80,7 +80,9 @@ struct SampleSet
           fout << " , ";
         first = false;
 
-        fout << " ( " << sample << " ) ";
+        fout << " ( ";
+        sample.print(fout, contexts);
+        fout << " ) ";
       }
 
     }
@@ -112,6 +114,18 @@ struct SampleSet
     }
   }
 
+  // Combine the samples of another shard; it is bottom if the two together
+  // have too many values.
+  void merge(const SampleSet &other, const std::vector<CtxId> &ctxmap)
+  {
+    const unsigned total = numSamples + other.numSamples;
+    for(unsigned i=0; i<N; ++i)
+      if( !other.observations[i].empty() )
+        receive(other.observations[i].translate(ctxmap));
+    numSamples = total;
+    bottom = bottom || other.bottom;
+  }
+
   bool is_bottom() const { return bottom; }
 
   bool is_worth_printing() const
@@ -130,13 +144,6 @@ private:
   SampleType observations[ N ];
 };
 
-template <class SampleType, const unsigned N>
-std::ostream &operator<<(std::ostream &fout, const SampleSet<SampleType,N> &pt)
-{
-  pt.print(fout);
-  return fout;
-}
-
 typedef SampleSet< IntSample, MAX_INT_PREDICTION_OBSERVATIONS > IntegerSamples;
 typedef SampleSet< PtrSample, MAX_POINTER_PREDICTION_OBSERVATIONS > PointerSamples;
 typedef SampleSet< PtrSample, MAX_UNDERLYING_OBJECT_OBSERVATIONS > UnderlyingObjectSamples;
@@ -148,6 +155,7 @@ struct PtrResidueSet
   void print(std::ostream &fout) const;
 
   void receive(void *sample);
+  void merge(const PtrResidueSet &other, const std::vector<CtxId> &ctxmap);
 
   bool is_bottom() const { return (residue_set == 0x0ffffu); }
   bool is_worth_printing() const { return true; }
@@ -159,25 +167,33 @@ private:
 
 std::ostream &operator<<(std::ostream &fout, const PtrResidueSet &residues);
 
+// Keyed by the instruction and the interned context; both are only
+// resolved to text when the table is printed.
 struct PredictionTable
 {
-  void print(std::ostream &fout) const;
+  void print(std::ostream &fout, const ContextTable &contexts) const;
 
-  void predict_int(const CtxHolder &ctx, const char *name, const IntSample &sample);
-  void predict_ptr(const CtxHolder &ctx, const char *name, const PtrSample &sample);
+  void predict_int(CtxId ctx, Name name, const IntSample &sample);
+  void predict_ptr(CtxId ctx, Name name, const PtrSample &sample);
 
-  void find_underlying_object(const CtxHolder &ctx, const char *name, const PtrSample &sample);
+  void find_underlying_object(CtxId ctx, Name name, const PtrSample &sample);
 
-  void pointer_residue(const CtxHolder &ctx, const char *name, void *sample);
+  void pointer_residue(CtxId ctx, Name name, void *sample);
 
-  void exit_ctx(const CtxHolder &ctx);
+  void exit_ctx(CtxId ctx);
+
+  // `ctxmap` translates the context IDs of `other` to ours.
+  void merge(const PredictionTable &other, const std::vector<CtxId> &ctxmap);
 
 private:
-  typedef std::pair<const char *, CtxHolder>          CtxValue;
-  typedef std::map<CtxValue, IntegerSamples>          IntPredictMap;
-  typedef std::map<CtxValue, PointerSamples>          PtrPredictMap;
-  typedef std::map<CtxValue, UnderlyingObjectSamples> ObjPredictMap;
-  typedef std::map<CtxValue, PtrResidueSet>           PtrResidueMap;
+  // (name, context), packed
+  typedef uint64_t CtxValue;
+  static CtxValue key(CtxId ctx, Name name) { return ((uint64_t)name.packed << 32) | ctx; }
+
+  typedef phmap::flat_hash_map<CtxValue, IntegerSamples>          IntPredictMap;
+  typedef phmap::flat_hash_map<CtxValue, PointerSamples>          PtrPredictMap;
+  typedef phmap::flat_hash_map<CtxValue, UnderlyingObjectSamples> ObjPredictMap;
+  typedef phmap::flat_hash_map<CtxValue, PtrResidueSet>           PtrResidueMap;
 
   IntPredictMap intPredictions;
   PtrPredictMap ptrPredictions;
@@ -187,13 +203,12 @@ private:
   template <class SetTy>
   void print_samples(
     std::ostream &fout,
-    const char *key,
-    const SetTy &set) const;
+    const char *kind,
+    const SetTy &set,
+    const ContextTable &contexts) const;
 
-  void print_residues(std::ostream &fout) const;
+  void print_residues(std::ostream &fout, const ContextTable &contexts) const;
 };
 
-std::ostream &operator<<(std::ostream &fout, const PredictionTable &pt);
-
 #endif
 
@@ -2,10 +2,71 @@
 #include "timer.h"
 #include "trailing_assert.h"
 
+#include <algorithm>
 #include <cstdio>
 
+Profiler::Profiler() {
+  frames.resize(1);
+  frames[0].ctx = 0;
+  frames[0].entered = 0;
+  depth = 1;
+  clock = 0;
+  shard_mask = 0;
+  shard_pattern = 0;
+
+  // statistics
+  evt_malloc = 0;
+  evt_free = 0;
+  evt_constant = 0;
+  evt_global = 0;
+  evt_stack = 0;
+  evt_begin_fcn = 0;
+  evt_end_fcn = 0;
+  evt_begin_iter = 0;
+  evt_end_iter = 0;
+  evt_fuo = 0;
+  evt_pred_int = 0;
+  evt_pred_ptr = 0;
+  evt_realloc = 0;
+  evt_ptr_residue = 0;
+
+#if TIMER
+  total_time_lookup_pointer = 0;
+  num_pointer_lookups = 0;
+  total_time_predict_int = 0;
+  num_predict_int = 0;
+  total_time_predict_ptr = 0;
+  num_predict_ptr = 0;
+  total_time_pointer_residue = 0;
+  num_pointer_residue = 0;
+  total_time_find_underlying_object = 0;
+  num_find_underlying_object = 0;
+#endif
+}
+
 void Profiler::begin() {}
 
+void Profiler::set_shard(uint32_t mask, uint32_t pattern) {
+  shard_mask = mask;
+  shard_pattern = pattern;
+}
+
+void Profiler::merge(Profiler &other) {
+  // every shard sees the AU and context events, but only the owner counts
+  // the instrumentation events
+  evt_fuo += other.evt_fuo;
+  evt_pred_int += other.evt_pred_int;
+  evt_pred_ptr += other.evt_pred_ptr;
+  evt_ptr_residue += other.evt_ptr_residue;
+
+  liveObjects.merge_stats(other.liveObjects);
+  const std::vector<CtxId> ctxmap = contexts.import(other.contexts);
+  escapes.merge(other.escapes, ctxmap);
+  predictions.merge(other.predictions, ctxmap);
+  possibleAllocationLeaks.insert(other.possibleAllocationLeaks.begin(),
+                                 other.possibleAllocationLeaks.end());
+}
+
 void Profiler::write_results() const {
   std::ofstream log("result.specpriv.profile.txt.tmp");
   print(log);
@@ -63,18 +124,18 @@ void Profiler::print(std::ostream &log) const {
     log << "INCOMPLETE ALLOCATION INFO " << *i << " ;\n";
 
   log << liveObjects;
-  log << escapes;
-  log << predictions;
+  escapes.print(log, contexts);
+  predictions.print(log, contexts);
 
   log << "END SPEC PRIV PROFILE\n";
 }
 
-void Profiler::malloc(const char *name, void *ptr, uint64_t size) {
+void Profiler::malloc(Name name, void *ptr, uint64_t size) {
   ++evt_malloc;
   add_temporary_au(AU_Heap, name, ptr, size);
 }
 
-void Profiler::realloc(const char *name, void *old_ptr, void *new_ptr,
+void Profiler::realloc(Name name, void *old_ptr, void *new_ptr,
                        uint64_t size) {
   ++evt_realloc;
 
@@ -82,14 +143,14 @@ void Profiler::realloc(const char *name, void *old_ptr, void *new_ptr,
 #if TIMER
     const uint64_t start = rdtsc();
 #endif
-    AUHolder au = liveObjects.lookupPointer(old_ptr);
+    AllocationUnit *au = liveObjects.lookupPointer(old_ptr);
 #if TIMER
     total_time_lookup_pointer += rdtsc() - start;
     ++num_pointer_lookups;
 #endif
 
-    const char *old_name = au->name;
-    CtxHolder old_creation = au->creation;
+    Name old_name = au->name;
+    CtxId old_creation = au->creation;
     const uint64_t old_size = au->extents.size();
     free(au);
 
@@ -113,10 +174,11 @@ void Profiler::realloc(const char *name, void *old_ptr, void *new_ptr,
         // freed.
         uint64_t base = size + (uint64_t)old_ptr;
         right_open_interval extents((void *)base, old_size - size);
-        AUHolder excess =
-            new AllocationUnit(AU_Heap, extents, old_name, old_creation);
+        AllocationUnit *excess =
+            liveObjects.create(AU_Heap, extents, old_name, old_creation);
         excess->attrs.realloc_shrink_excess = true;
-        excess->deletion = currentContext;
+        excess->attrs.replica = !owns(base);
+        excess->deletion = currentCtx();
 
         liveObjects.add_temporary(excess);
       }
@@ -126,12 +188,12 @@ void Profiler::realloc(const char *name, void *old_ptr, void *new_ptr,
     malloc(name, new_ptr, size);
 }
 
-void Profiler::free(const char *name, void *ptr, bool isAlloca) {
+void Profiler::free(Name name, void *ptr, bool isAlloca) {
   ++evt_free;
 #if TIMER
   const uint64_t start = rdtsc();
 #endif
-  AUHolder au = liveObjects.lookupPointer(ptr);
+  AllocationUnit *au = liveObjects.lookupPointer(ptr);
 #if TIMER
   total_time_lookup_pointer += rdtsc() - start;
   ++num_pointer_lookups;
@@ -142,7 +204,7 @@ void Profiler::free(const char *name, void *ptr, bool isAlloca) {
 
 static bool warnFreeHeapAsStackOnce = false, warnFreeStackAsHeapOnce = false;
 
-void Profiler::free(AUHolder &au, bool isAlloca) {
+void Profiler::free(AllocationUnit *au, bool isAlloca) {
   if (!isAlloca) // heap
   {
     if (au->type != AU_Heap) {
@@ -150,7 +212,7 @@ void Profiler::free(AUHolder &au, bool isAlloca) {
         fprintf(stderr,
                 "Warning: expected heap object, but free()d object %s not on "
                 "heap.\n",
-                au->name);
+                au->name.str().c_str());
         warnFreeStackAsHeapOnce = true;
       }
       return;
@@ -162,35 +224,35 @@ void Profiler::free(AUHolder &au, bool isAlloca) {
         fprintf(stderr,
                 "Warning: expected stack object, but free()d object %s is not "
                 "on stack.\n",
-                au->name);
+                au->name.str().c_str());
         warnFreeHeapAsStackOnce = true;
       }
       return;
     }
   }
 
-  au->deletion = currentContext;
+  au->deletion = currentCtx();
 
-  CtxHolder local = au->creation->findCommon(au->deletion);
+  CtxId local = contexts.findCommon(au->creation, au->deletion);
 
-  escapes.report_local(au, local);
-
-  liveObjects.remove(au);
+  escapes.report_local(au, local, contexts);
 
   remove_from_context(au);
+
+  liveObjects.remove(au);
 }
 
-void Profiler::report_constant(const char *name, void *base, uint64_t size) {
+void Profiler::report_constant(Name name, void *base, uint64_t size) {
   ++evt_constant;
   add_permanent_au(AU_Constant, name, base, size);
 }
 
-void Profiler::report_global(const char *name, void *base, uint64_t size) {
+void Profiler::report_global(Name name, void *base, uint64_t size) {
   ++evt_global;
   add_permanent_au(AU_Global, name, base, size);
 }
 
-void Profiler::report_stack(const char *name, void *base, uint64_t array_size,
+void Profiler::report_stack(Name name, void *base, uint64_t array_size,
                             uint64_t elt_size) {
   ++evt_stack;
   if (0 == array_size)
@@ -200,39 +262,39 @@ void Profiler::report_stack(const char *name, void *base, uint64_t array_size,
   add_temporary_au(AU_Stack, name, base, size);
 }
 
-void Profiler::begin_function(const char *name) {
+void Profiler::begin_function(Name name) {
   ++evt_begin_fcn;
   enter_ctx(Function, name);
 }
 
-void Profiler::end_function(const char *name) {
+void Profiler::end_function(Name name) {
   ++evt_end_fcn;
   free_stacks();
-  if (!name)
-    name = currentContext->name;
+  if (name.is_null())
+    name = currentContext().name;
   exit_ctx(Function, name);
 }
 
-void Profiler::begin_iter(const char *name) {
+void Profiler::begin_iter(Name name) {
   ++evt_begin_iter;
   enter_ctx(Loop, name);
 }
 
-void Profiler::end_iter(const char *name) {
+void Profiler::end_iter(Name name) {
   ++evt_end_iter;
-  if (!name)
-    name = currentContext->name;
+  if (name.is_null())
+    name = currentContext().name;
   exit_ctx(Loop, name);
 }
 
-static const char *name_of_last_unknown_object = 0;
+static Name name_of_last_unknown_object;
 
-void Profiler::find_underlying_object(const char *name, void *ptr) {
+void Profiler::find_underlying_object(Name name, void *ptr) {
   ++evt_fuo;
 #if TIMER
   const uint64_t start = rdtsc();
 #endif
-  AUHolder au = liveObjects.lookupPointer(ptr);
+  AllocationUnit *au = liveObjects.lookupPointer(ptr);
 #if TIMER
   total_time_lookup_pointer += rdtsc() - start;
   ++num_pointer_lookups;
@@ -241,7 +303,7 @@ void Profiler::find_underlying_object(const char *name, void *ptr) {
   if (DEBUG) {
     if (au->type == AU_Unknown) {
       if (name != name_of_last_unknown_object) {
-        fprintf(stderr, "Ptr '%s' to %p is unknown\n", name, ptr);
+        fprintf(stderr, "Ptr '%s' to %p is unknown\n", name.str().c_str(), ptr);
 
         if (STOP_ON_FIRST_UNKNOWN)
           abort();
@@ -255,43 +317,43 @@ void Profiler::find_underlying_object(const char *name, void *ptr) {
   const uint64_t middle = rdtsc();
 #endif
   PtrSample object(au);
-  predictions.find_underlying_object(currentContext, name, object);
+  predictions.find_underlying_object(currentCtx(), name, object);
 #if TIMER
   total_time_find_underlying_object += rdtsc() - middle;
   ++num_find_underlying_object;
 #endif
 }
 
-void Profiler::predict_int(const char *name, uint64_t value) {
+void Profiler::predict_int(Name name, uint64_t value) {
   ++evt_pred_int;
 
 #if TIMER
   const uint64_t start = rdtsc();
 #endif
   IntSample sample(value);
-  predictions.predict_int(currentContext, name, sample);
+  predictions.predict_int(currentCtx(), name, sample);
 #if TIMER
   total_time_predict_int += rdtsc() - start;
   ++num_predict_int;
 #endif
 }
 
-void Profiler::predict_ptr(const char *name, void *ptr) {
+void Profiler::predict_ptr(Name name, void *ptr, bool residue) {
   ++evt_pred_ptr;
 
 #if TIMER
   const uint64_t start = rdtsc();
 #endif
-  AUHolder au = liveObjects.lookupPointer(ptr);
+  AllocationUnit *au = liveObjects.lookupPointer(ptr);
 #if TIMER
   const uint64_t middle1 = rdtsc();
   total_time_lookup_pointer += middle1 - start;
   ++num_pointer_lookups;
 #endif
 
-  uint64_t offset = ptr - au;
+  uint64_t offset = au->offset(ptr);
   PtrSample sample = PtrSample(au, offset);
-  predictions.predict_ptr(currentContext, name, sample);
+  predictions.predict_ptr(currentCtx(), name, sample);
 
 #if TIMER
   const uint64_t middle2 = rdtsc();
@@ -300,7 +362,8 @@ void Profiler::predict_ptr(const char *name, void *ptr) {
 #endif
 
   // Also predict pointer residues
-  predictions.pointer_residue(currentContext, name, ptr);
+  if (residue)
+    predictions.pointer_residue(currentCtx(), name, ptr);
 
 #if TIMER
   total_time_pointer_residue += rdtsc() - middle2;
@@ -308,20 +371,20 @@ void Profiler::predict_ptr(const char *name, void *ptr) {
 #endif
 }
 
-void Profiler::pointer_residue(const char *name, void *ptr) {
+void Profiler::pointer_residue(Name name, void *ptr) {
   ++evt_ptr_residue;
 #if TIMER
   const uint64_t start = rdtsc();
 #endif
-  predictions.pointer_residue(currentContext, name, ptr);
+  predictions.pointer_residue(currentCtx(), name, ptr);
 #if TIMER
   total_time_pointer_residue += rdtsc() - start;
   ++num_pointer_residue;
 #endif
 }
 
-AUHolder Profiler::add_temporary_au(AUType type, const char *name, void *base,
-                                    uint64_t size) {
+AllocationUnit *Profiler::add_temporary_au(AUType type, Name name, void *base,
+                                           uint64_t size) {
   right_open_interval key(base, size);
 
   // Moved from AllocationUnitTable::add_temporary:
@@ -332,146 +395,186 @@ AUHolder Profiler::add_temporary_au(AUType type, const char *name, void *base,
   // (this can happen, for instance, because two allocas have non-overlapping
   //  lifetimes (as reported by llvm.lifetime.start, llvm.lifetime.end), and
   //  the backend merges them into a single alloca)
-  for (CtxHolder ctx = currentContext; !ctx.is_null(); ctx = ctx->parent) {
-    for (unsigned i = 0; i < ctx->aus.size(); ++i) {
-      AUHolder old = (AllocationUnit *)*ctx->aus[i];
+  const unsigned fcn = contexts[contexts.innermostFunction(currentCtx())].depth;
+  for (unsigned i = 0; i < frames[fcn].stack.size(); ++i) {
+    AllocationUnit *old = frames[fcn].stack[i];
 
-      if (old->type == AU_Stack && old->extents.includes(base)) {
-        free_one_stack(ctx, i);
-        --i;
-      }
+    if (old->extents.includes(base)) {
+      free_one_stack(fcn, i);
+      --i;
     }
-
-    if (ctx->type != Loop)
-      break;
   }
 
   // Add the new object, or find it if it was a repeat...
-  AUHolder au = liveObjects.add_temporary(type, key, name, currentContext);
-
-  // Add it to the context unless it was a repeat.
-  for (unsigned i = 0, N = currentContext->aus.size(); i < N; ++i)
-    if (au == (AUHolder &)currentContext->aus[i])
-      return (AUHolder &)currentContext->aus[i];
-  currentContext->aus.push_back(*au);
+  AllocationUnit *au =
+      liveObjects.add_temporary(type, key, name, currentCtx());
+  au->attrs.replica = !owns(au->extents.low);
+
+  // List it in the context unless it was a repeat.
+  AllocationUnit *&last = listed[AUKey(au)];
+  if (last && last->listed > currentFrame().entered)
+    return last;
+  if (au->listed)
+    return au;
+  last = au;
+  au->listed = ++clock;
+  if (type == AU_Stack)
+    frames[fcn].stack.push_back(au);
 
   return au;
 }
 
-void Profiler::add_permanent_au(AUType type, const char *name, void *base,
+void Profiler::add_permanent_au(AUType type, Name name, void *base,
                                 uint64_t size) {
   right_open_interval key(base, size);
-  liveObjects.add_permanent(type, key, name, currentContext);
-}
-
-// An AU is in the live-aus list of exactly one
-// live context.  Find and delete it.
-void Profiler::remove_from_context(const AUHolder &au) {
-  // Remove this au from the live objects list.
-  for (CtxHolder ctx = currentContext; !ctx.is_null(); ctx = ctx->parent) {
-    for (unsigned i = 0; i < ctx->aus.size(); ++i) {
-      AUHolder match = (AllocationUnit *)*ctx->aus[i];
-      if (*match == *au) // pointer compare!
-      {
-        ctx->aus[i] = ctx->aus.back();
-        ctx->aus.pop_back();
-        return;
-      }
-    }
+  AllocationUnit *au =
+      liveObjects.add_permanent(type, key, name, currentCtx());
+  au->attrs.replica = !owns(au->extents.low);
+}
+
+// The frame a listed AU has been passed up to: the outermost of those
+// active when it was listed which has not exited since.
+unsigned Profiler::frame_of(const AllocationUnit *au) const {
+  // frames[0..result] were entered before the AU, the rest after it
+  unsigned lo = 0, hi = std::min(contexts[au->creation].depth, depth - 1);
+  while (lo < hi) {
+    const unsigned mid = (lo + hi + 1) / 2;
+    if (frames[mid].entered < au->listed)
+      lo = mid;
+    else
+      hi = mid - 1;
   }
+  return lo;
 }
 
-void Profiler::enter_ctx(CtxType type, const char *name) {
-  Context *f = new Context(type);
-  f->name = name;
-  f->parent = currentContext;
-  currentContext = f;
+// The AU escaped the contexts from its creation up to, but not including,
+// `frame`; -1 includes the top.
+void Profiler::report_escapes(const AllocationUnit *au, int frame) {
+  for (CtxId ctx = au->creation; (int)contexts[ctx].depth > frame;
+       ctx = contexts[ctx].parent) {
+    escapes.report_escape(au, ctx);
+    if (ctx == 0)
+      break;
+  }
 }
 
-void Profiler::exit_ctx(CtxType type, const char *name) {
-  trailing_assert(currentContext->type == type && currentContext->name == name);
+void Profiler::unlist(AllocationUnit *au) {
+  auto i = listed.find(AUKey(au));
+  if (i != listed.end() && i->second == au)
+    listed.erase(i);
+  au->listed = 0;
+}
 
-  // All live aus in this context escape.
-  for (unsigned i = 0, N = currentContext->aus.size(); i < N; ++i) {
-    AUHolder au = (AllocationUnit *)*currentContext->aus[i];
-    escapes.report_escape(au, currentContext);
+// The AU leaves the context it is in, escaping those it was passed up from.
+void Profiler::remove_from_context(AllocationUnit *au) {
+  if (!au->listed)
+    return;
+
+  report_escapes(au, frame_of(au));
+
+  if (au->type == AU_Stack) {
+    const unsigned fcn =
+        contexts[contexts.innermostFunction(au->creation)].depth;
+    std::vector<AllocationUnit *> &stack = frames[fcn].stack;
+    for (unsigned i = 0; i < stack.size(); ++i) {
+      if (stack[i] == au) {
+        stack[i] = stack.back();
+        stack.pop_back();
+        break;
+      }
+    }
   }
 
-  // They are copied to the parent context.
-  CtxHolder parent = currentContext->parent;
-  parent->aus.insert(parent->aus.end(), currentContext->aus.begin(),
-                     currentContext->aus.end());
-  currentContext->aus.clear();
+  unlist(au);
+}
+
+void Profiler::enter_ctx(CtxType type, Name name) {
+  const CtxId ctx = contexts.intern(type, name, currentCtx());
+  if (depth == frames.size())
+    frames.emplace_back();
+  frames[depth].ctx = ctx;
+  frames[depth].entered = ++clock;
+  ++depth;
+}
+
+void Profiler::exit_ctx(CtxType type, Name name) {
+  trailing_assert(currentContext().type == type &&
+                  currentContext().name == name);
+
+  // Its live AUs escape; they are counted when they are freed.
 
   // Accumulate value predictions.
-  predictions.exit_ctx(currentContext);
+  predictions.exit_ctx(currentCtx());
 
   // pop context stack
-  currentContext = parent;
+  --depth;
 }
 
 void Profiler::free_stacks() {
-  Context::AUs &aus = currentContext->aus;
-  for (int i = aus.size() - 1; i >= 0; --i) {
-    AUHolder au = (AllocationUnit *)*aus[i];
-
-    // Is this an alloca?
-    if (au->type == AU_Stack &&
-        au->creation->innermostFunction() == currentContext) {
-      free_one_stack(currentContext, i);
-    }
-  }
+  std::vector<AllocationUnit *> &stack = currentFrame().stack;
+  for (int i = stack.size() - 1; i >= 0; --i)
+    free_one_stack(depth - 1, i);
 }
 
-void Profiler::free_one_stack(CtxHolder ctx, unsigned idx) {
-  Context::AUs &aus = ctx->aus;
-  AUHolder au = (AllocationUnit *)*aus[idx];
-
-  // Implicitly free()ed when function returns
-  au->deletion = currentContext;
-  liveObjects.remove(au);
-
-  escapes.report_local(au, currentContext->findCommon(ctx));
+void Profiler::free_one_stack(unsigned frame, unsigned idx) {
+  std::vector<AllocationUnit *> &stack = frames[frame].stack;
+  AllocationUnit *au = stack[idx];
 
   // Remove it from the AU list.
   // Swap with last, then pop-back
-  aus[idx] = aus.back();
-  aus.pop_back();
+  stack[idx] = stack.back();
+  stack.pop_back();
+
+  const unsigned in = frame_of(au);
+  report_escapes(au, in);
+  unlist(au);
+
+  // Implicitly free()ed when function returns
+  au->deletion = currentCtx();
+  escapes.report_local(au, frames[in].ctx, contexts);
+
+  liveObjects.remove(au);
 }
 
 void Profiler::end() {
+  finish();
+  write_results();
+}
+
+void Profiler::finish() {
   // We model a call to exit() as repeatedly returning
   // from all active functions.
-  while (currentContext->type != Top) {
-    if (currentContext->type == Function)
-      end_function(currentContext->name);
-    else if (currentContext->type == Loop)
-      end_iter(currentContext->name);
+  while (currentContext().type != Top) {
+    if (currentContext().type == Function)
+      end_function(currentContext().name);
+    else if (currentContext().type == Loop)
+      end_iter(currentContext().name);
   }
 
-  while (!currentContext->aus.empty()) {
-    AUHolder au = (AllocationUnit *)*currentContext->aus.back();
-    currentContext->aus.pop_back();
-
-    // Globals, constants always escape, we don't care about those.
-    if (au->type != AU_Global && au->type != AU_Constant)
-      escapes.report_escape(au, currentContext);
+  // Then everything still listed escapes the top, too.
+  std::vector<AllocationUnit *> remaining;
+  liveObjects.for_each_temporary([&](AllocationUnit *au) {
+    if (au->listed)
+      remaining.push_back(au);
+  });
+  for (AllocationUnit *au : remaining) {
+    report_escapes(au, -1);
+    unlist(au);
   }
-
-  write_results();
+  frames[0].stack.clear();
 }
 
-const char *name_of_last_assert_fail = 0;
+static Name name_of_last_assert_fail;
 
 // If the profiler ran in sanity check mode,
 // then it emits calls to this.  These check at profile collection
 // time that pointer arithmetic does not escape AU bounds.
-void Profiler::assert_in_bounds(const char *name, void *base, void *derived) {
+void Profiler::assert_in_bounds(Name name, void *base, void *derived) {
   if (DEBUG) {
 #if TIMER
     const uint64_t start = rdtsc();
 #endif
-    AUHolder base_au = liveObjects.lookupPointer(base);
+    AllocationUnit *base_au = liveObjects.lookupPointer(base);
 #if TIMER
     const uint64_t middle = rdtsc();
     total_time_lookup_pointer += middle - start;
@@ -481,24 +584,24 @@ void Profiler::assert_in_bounds(const char *name, void *base, void *derived) {
     if (base_au->type == AU_Unknown)
       return;
 
-    AUHolder derived_au = liveObjects.lookupPointer(base);
+    AllocationUnit *derived_au = liveObjects.lookupPointer(base);
 #if TIMER
     total_time_lookup_pointer += rdtsc() - middle;
     ++num_pointer_lookups;
 #endif
 
-    if (*base_au != *derived_au) {
+    if (base_au != derived_au) {
       if (name != name_of_last_assert_fail)
-        fprintf(stderr, "Assert in-bounds: failed on %s\n", name);
+        fprintf(stderr, "Assert in-bounds: failed on %s\n", name.str().c_str());
       name_of_last_assert_fail = name;
     }
   }
 }
 
-void Profiler::possible_allocation_leak(const char *name) {
+void Profiler::possible_allocation_leak(Name name) {
   if (DEBUG)
     if (!possibleAllocationLeaks.count(name))
-      fprintf(stderr, "Possible allocation leak: %s\n", name);
+      fprintf(stderr, "Possible allocation leak: %s\n", name.str().c_str());
 
   possibleAllocationLeaks.insert(name);
 }
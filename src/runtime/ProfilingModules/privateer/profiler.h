@@ -5,6 +5,7 @@
 #include <cassert>
 #include <map>
 #include <set>
+#include <vector>
 #include <fstream>
 
 #include <stdint.h>
@@ -17,33 +18,38 @@
 
 struct Profiler
 {
+  Profiler();
+
   void begin();
   void end();
+  // end() without writing the results, e.g., before merging shards
+  void finish();
 
   void write_results() const;
   void print(std::ostream &log) const;
-  void malloc(const char *name, void *ptr, uint64_t size);
-  void realloc(const char *name, void *old_ptr, void *new_ptr, uint64_t size);
-  void free(const char *name, void *ptr, bool isAlloca = false);
-  void free(AUHolder &au, bool isAlloca = false);
-  void report_constant(const char *name, void *base, uint64_t size);
-  void report_global(const char *name, void *base, uint64_t size);
-  void report_stack(const char *name, void *base, uint64_t array_size, uint64_t elt_size);
-  void begin_function(const char *name);
-  void end_function(const char *name);
-  void begin_iter(const char *name);
-  void end_iter(const char *name);
-  void predict_int(const char *name, uint64_t value);
-  void find_underlying_object(const char *name, void *ptr);
-
-  // Note: predict_ptr implies pointer_residue
-  void predict_ptr(const char *name, void *ptr);
-  void pointer_residue(const char *name, void *ptr);
-
-  void assert_in_bounds(const char *name, void *base, void *derived);
-  void possible_allocation_leak(const char *name);
-
-  // This is a  singleton class.
+  void malloc(Name name, void *ptr, uint64_t size);
+  void realloc(Name name, void *old_ptr, void *new_ptr, uint64_t size);
+  void free(Name name, void *ptr, bool isAlloca = false);
+  void free(AllocationUnit *au, bool isAlloca = false);
+  void report_constant(Name name, void *base, uint64_t size);
+  void report_global(Name name, void *base, uint64_t size);
+  void report_stack(Name name, void *base, uint64_t array_size, uint64_t elt_size);
+  void begin_function(Name name);
+  void end_function(Name name);
+  void begin_iter(Name name);
+  void end_iter(Name name);
+  void predict_int(Name name, uint64_t value);
+  void find_underlying_object(Name name, void *ptr);
+
+  // Note: predict_ptr implies pointer_residue, unless `residue` is false
+  void predict_ptr(Name name, void *ptr, bool residue = true);
+  void pointer_residue(Name name, void *ptr);
+
+  void assert_in_bounds(Name name, void *base, void *derived);
+  void possible_allocation_leak(Name name);
+
+  // The default instance; the shards of a multi-threaded consumer each
+  // create their own.
   static Profiler &getInstance()
   {
     if( !theInstance )
@@ -53,61 +59,83 @@ struct Profiler
 
   void timing_stats(std::ostream &log) const;
 
+  // Sharding across consumer threads by page, like LocalWriteModule.  Every
+  // shard tracks all AUs and contexts (the escape accounting depends on the
+  // order of allocations within a context), but only the shard owning the
+  // base address of an AU reports it.
+  //
+  // The replica costs each shard the memory and the allocation events of the
+  // whole table.  The listing order (`clock`) is already global, as every
+  // shard sees every event; what keeps the table per shard is that pointers
+  // are resolved against it while it changes.  Sharing it would take one
+  // writer and readers that wait for it at each allocation.
+  void set_shard(uint32_t mask, uint32_t pattern);
+  // fold in another (finished) shard
+  void merge(Profiler &other);
+
 private:
-  // SINGLETON
-  static Profiler *theInstance;
-  Profiler()
-  {
-    currentContext = new Context(Top);
-
-    // statistics
-    evt_malloc = 0;
-    evt_free = 0;
-    evt_constant = 0;
-    evt_global = 0;
-    evt_stack = 0;
-    evt_begin_fcn = 0;
-    evt_end_fcn = 0;
-    evt_begin_iter = 0;
-    evt_end_iter = 0;
-    evt_fuo = 0;
-    evt_pred_int = 0;
-    evt_pred_ptr = 0;
-    evt_realloc = 0;
-    evt_ptr_residue = 0;
+  static const unsigned SHARD_SHIFT = 12;
+  uint32_t shard_mask, shard_pattern;
 
-#if TIMER
-    total_time_lookup_pointer = 0;
-    num_pointer_lookups = 0;
-    total_time_predict_int = 0;
-    num_predict_int = 0;
-    total_time_predict_ptr = 0;
-    num_predict_ptr = 0;
-    total_time_pointer_residue = 0;
-    num_pointer_residue = 0;
-    total_time_find_underlying_object = 0;
-    num_find_underlying_object = 0;
-#endif
+  bool owns(uint64_t addr) const
+  {
+    return ((addr >> SHARD_SHIFT) & shard_mask) == shard_pattern;
   }
 
-  AUHolder add_temporary_au(AUType type, const char *name, void *base, uint64_t size);
-  void add_permanent_au(AUType type, const char *name, void *base, uint64_t size);
-  void remove_from_context(const AUHolder &au);
-  void enter_ctx(CtxType type, const char *name);
-  void exit_ctx(CtxType type, const char *name);
+  // SINGLETON
+  static Profiler *theInstance;
+
+  AllocationUnit *add_temporary_au(AUType type, Name name, void *base, uint64_t size);
+  void add_permanent_au(AUType type, Name name, void *base, uint64_t size);
+  void remove_from_context(AllocationUnit *au);
+  void enter_ctx(CtxType type, Name name);
+  void exit_ctx(CtxType type, Name name);
   void free_stacks();
-  void free_one_stack(CtxHolder ctx, unsigned idx);
+  void free_one_stack(unsigned frame, unsigned idx);
+
+  // Escapes are counted lazily.  A live AU is passed up to the enclosing
+  // context whenever its context exits, and escapes each context it is
+  // passed up from; instead of moving it, we find where it is when it is
+  // freed (or at the end), from when it and the active frames began.
+  unsigned frame_of(const AllocationUnit *au) const;
+  void report_escapes(const AllocationUnit *au, int frame);
+  void unlist(AllocationUnit *au);
+
+  // An activation of a context.  A function's frame also lists the stack
+  // AUs of the function and its loops, which are freed when it returns.
+  struct Frame
+  {
+    CtxId ctx;
+    uint64_t entered;
+    std::vector<AllocationUnit *> stack;
+  };
 
   // Runtime information
   AllocationUnitTable liveObjects;
-  CtxHolder currentContext;
+  ContextTable contexts;
+
+  // The active contexts, innermost last; the frame of a context is at its
+  // depth.  Frames past `depth` are kept, so their AU lists need not be
+  // allocated again.
+  std::vector<Frame> frames;
+  unsigned depth;
+
+  // Orders the frame entries and AU listings.
+  uint64_t clock;
+  // The AU listed last for each key; at most one per activation of a context
+  // is listed, the others are not counted as escaping.
+  phmap::flat_hash_map<AUKey, AllocationUnit *> listed;
+
+  Frame &currentFrame() { return frames[depth-1]; }
+  const Context &currentContext() const { return contexts[ frames[depth-1].ctx ]; }
+  CtxId currentCtx() const { return frames[depth-1].ctx; }
 
   // Tabulated results which will be saved
   PredictionTable predictions;
   EscapeTable escapes;
 
   // Possible allocation leaks
-  typedef std::set<const char *> FcnNameList;
+  typedef std::set<Name> FcnNameList;
   FcnNameList possibleAllocationLeaks;
 
 
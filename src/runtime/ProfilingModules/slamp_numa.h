@@ -0,0 +1,137 @@
+#ifndef SLAMPLIB_HOOKS_SLAMP_NUMA_H
+#define SLAMPLIB_HOOKS_SLAMP_NUMA_H
+
+// NUMA placement of the producer, the consumer threads and their memory
+//
+// The topology is read from sysfs and the memory is bound with the mbind
+// system call, so nothing links against libnuma. On a machine without NUMA
+// (or without sysfs) everything is on node 0 and binding is a no-op.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace slamp {
+namespace numa {
+
+// from <numaif.h>
+static constexpr int MPOL_BIND_ = 2;
+static constexpr unsigned MPOL_MF_MOVE_ = 1 << 1;
+
+/// "0-3,8,10-11", the format of the cpulist and online files of sysfs
+inline std::vector<int> parseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  const char *s = list.c_str();
+  while (*s) {
+    char *end;
+    long first = strtol(s, &end, 10);
+    if (end == s)
+      break;
+    long last = first;
+    if (*end == '-')
+      last = strtol(end + 1, &end, 10);
+    for (long cpu = first; cpu <= last; cpu++)
+      cpus.push_back(static_cast<int>(cpu));
+    s = *end == ',' ? end + 1 : end;
+  }
+  return cpus;
+}
+
+inline std::string readLine(const std::string &path) {
+  std::ifstream is(path);
+  std::string line;
+  std::getline(is, line);
+  return line;
+}
+
+/// highest online node plus one
+inline int nodeCount() {
+  auto nodes = parseCpuList(readLine("/sys/devices/system/node/online"));
+  return nodes.empty() ? 1 : nodes.back() + 1;
+}
+
+/// the node of `cpu`, from the nodeN link in its sysfs directory
+inline int nodeOfCpu(int cpu) {
+  auto path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR *dir = opendir(path.c_str());
+  if (!dir)
+    return 0;
+
+  int node = 0;
+  while (auto *entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' &&
+        entry->d_name[4] <= '9') {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+inline std::vector<int> cpusOfNode(int node) {
+  auto cpus = parseCpuList(readLine("/sys/devices/system/node/node" +
+                                    std::to_string(node) + "/cpulist"));
+  // no sysfs: all the cpus of the process
+  if (cpus.empty() && node == 0) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &set))
+          cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+/// the node the calling thread runs on now
+inline int currentNode() {
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    return 0;
+  return static_cast<int>(node);
+}
+
+inline bool pinThread(pthread_t thread, int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+inline bool pinCurrentThread(int cpu) { return pinThread(pthread_self(), cpu); }
+
+/// Place [addr, addr + len) on `node`. The pages not touched yet are
+/// allocated there; with `move`, the ones already touched are migrated
+inline bool bindMemory(void *addr, size_t len, int node, bool move = false) {
+  if (node < 0 || len == 0)
+    return false;
+
+  const uint64_t pagesize = getpagesize();
+  auto begin = reinterpret_cast<uint64_t>(addr) & ~(pagesize - 1);
+  auto end = reinterpret_cast<uint64_t>(addr) + len;
+
+  constexpr unsigned BITS = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(node / BITS + 1, 0);
+  mask[node / BITS] |= 1UL << (node % BITS);
+  // the kernel reads one bit less than `maxnode`
+  const unsigned long maxnode = mask.size() * BITS + 1;
+
+  return syscall(SYS_mbind, begin, end - begin, MPOL_BIND_, mask.data(),
+                 maxnode, move ? MPOL_MF_MOVE_ : 0) == 0;
+}
+
+} // namespace numa
+} // namespace slamp
+
+#endif
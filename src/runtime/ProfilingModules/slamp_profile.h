@@ -0,0 +1,451 @@
+#ifndef SLAMPLIB_HOOKS_SLAMP_PROFILE_H
+#define SLAMPLIB_HOOKS_SLAMP_PROFILE_H
+
+// Binary profile container
+//
+// A profile is laid out as
+//   ProfileHeader | SectionHeader[num_sections] | section payloads
+// Each payload is an array of fixed-width records, aligned to
+// PROFILE_ALIGNMENT and sorted by the record key, so readers can mmap the file
+// and use the records in place (binary search, no parsing).
+//
+// Contexts are stored once in a shared table: CONTEXT_INDEX holds a
+// ContextRange per context, pointing into the ContextElement array of
+// CONTEXT_POOL. Context 0 is the empty context.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace slamp {
+
+static constexpr char PROFILE_MAGIC[8] = {'P', 'R', 'O', 'M', 'P', 'T', 'P', 'F'};
+static constexpr uint32_t PROFILE_VERSION = 1;
+static constexpr uint64_t PROFILE_ALIGNMENT = 64;
+
+enum class ProfileSection : uint32_t {
+  DEPENDENCE = 1,
+  LOADED_VALUE,
+  POINTS_TO,
+  LOOP_CONTEXTS,
+  LOCAL_OBJECTS,
+  CONTEXT_INDEX,
+  CONTEXT_POOL,
+  NONLOCAL_OBJECTS,
+  SYMBOLS,
+  SYMBOL_STRINGS,
+  VALUE_PATTERN,
+};
+
+enum ProfileSectionFlags : uint32_t {
+  PROFILE_HAS_COUNT = 1 << 0,
+  PROFILE_HAS_MIN_DISTANCE = 1 << 1,
+};
+
+struct ProfileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_sections;
+  uint64_t file_size;
+};
+
+struct SectionHeader {
+  ProfileSection kind;
+  uint32_t record_size;
+  uint32_t loop_id;
+  uint32_t flags;
+  uint64_t offset; // from the beginning of the file
+  uint64_t count;
+};
+
+// sorted by (src, dst, dst_bare, cross), the order of KEYComp
+struct DependenceRecord {
+  uint32_t src;
+  uint32_t dst;
+  uint32_t dst_bare;
+  uint32_t cross;
+  uint64_t count;
+  uint32_t min_distance;
+  uint32_t reserved;
+};
+
+// the value of a load that is not constant, HTMap_IsConstant::MAGIC_INVALID
+static constexpr uint64_t PROFILE_VALUE_INVALID = 0xbeefdeadbeefdead;
+
+// sorted by (instr, bare_instr)
+struct ValueRecord {
+  uint32_t instr;
+  uint32_t bare_instr;
+  uint64_t value;
+};
+
+// the state of a ValuePattern, sorted by (instr, stream)
+enum ValueStream : uint32_t {
+  STREAM_VALUE = 0,
+  STREAM_ADDR,
+};
+
+enum ValuePatternFlags : uint32_t {
+  PATTERN_CONSTANT = 1 << 0,
+  PATTERN_LINEAR = 1 << 1,
+  PATTERN_STRIDE = 1 << 2,
+  PATTERN_SLOPE_KNOWN = 1 << 3, // `slope` is set, from two iterations
+};
+
+struct ValuePatternRecord {
+  uint32_t instr;
+  uint32_t stream;
+  uint32_t flags;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t first_iter;
+  uint64_t first;
+  uint64_t last_iter;
+  uint64_t last;
+  int64_t stride;
+  int64_t slope;
+};
+
+// the special AUs of PointsToModule
+enum PointsToAU : int32_t {
+  PT_AU_NOT_CONSTANT = -3,
+  PT_AU_UNMANAGED = -2,
+  PT_AU_NULL = -1,
+};
+
+// sorted by (instr, context)
+struct PointsToRecord {
+  uint32_t instr;
+  uint32_t context;
+  int32_t au; // allocation instruction or PointsToAU
+  uint32_t au_context;
+};
+
+// sorted by (instr, context), for both LOCAL_OBJECTS and NONLOCAL_OBJECTS
+struct LocalObjectRecord {
+  uint32_t instr;
+  uint32_t context;
+};
+
+struct LoopContextRecord {
+  uint32_t context;
+};
+
+struct ContextRange {
+  uint32_t begin;
+  uint32_t size;
+};
+
+// one ContextId (type, metaId), innermost last
+struct ContextElement {
+  uint32_t type;
+  uint32_t id;
+
+  bool operator<(const ContextElement &other) const {
+    return type < other.type || (type == other.type && id < other.id);
+  }
+};
+
+static_assert(sizeof(ProfileHeader) == 24, "stable on-disk layout");
+static_assert(sizeof(SectionHeader) == 32, "stable on-disk layout");
+static_assert(sizeof(DependenceRecord) == 32, "stable on-disk layout");
+static_assert(sizeof(ValuePatternRecord) == 72, "stable on-disk layout");
+
+/// Collects sections in memory and dumps them with one mmap'ed write
+class ProfileWriter {
+  struct Section {
+    SectionHeader header;
+    std::vector<char> data;
+  };
+  std::vector<Section> sections;
+
+  std::map<std::vector<ContextElement>, uint32_t> contextIds;
+  std::vector<ContextRange> contextIndex;
+  std::vector<ContextElement> contextPool;
+
+  static uint64_t align(uint64_t offset) {
+    return (offset + PROFILE_ALIGNMENT - 1) & ~(PROFILE_ALIGNMENT - 1);
+  }
+
+public:
+  ProfileWriter() {
+    // context 0 is the empty context
+    contextIds[{}] = 0;
+    contextIndex.push_back({0, 0});
+  }
+
+  /// records are sorted with `comp` before they are stored
+  template <typename T, typename Comp>
+  void addSortedSection(ProfileSection kind, std::vector<T> &records,
+                        Comp comp, uint32_t loop_id = 0, uint32_t flags = 0) {
+    std::sort(records.begin(), records.end(), comp);
+    addSection(kind, records, loop_id, flags);
+  }
+
+  template <typename T>
+  void addSection(ProfileSection kind, const std::vector<T> &records,
+                  uint32_t loop_id = 0, uint32_t flags = 0) {
+    Section section;
+    section.header.kind = kind;
+    section.header.record_size = sizeof(T);
+    section.header.loop_id = loop_id;
+    section.header.flags = flags;
+    section.header.offset = 0;
+    section.header.count = records.size();
+    auto *begin = reinterpret_cast<const char *>(records.data());
+    section.data.assign(begin, begin + records.size() * sizeof(T));
+    sections.push_back(std::move(section));
+  }
+
+  /// intern a context, `ContextIdT` has `type` and `metaId`
+  template <typename ContextIdT>
+  uint32_t addContext(const std::vector<ContextIdT> &context) {
+    std::vector<ContextElement> elements;
+    elements.reserve(context.size());
+    for (auto &c : context)
+      elements.push_back({static_cast<uint32_t>(c.type),
+                          static_cast<uint32_t>(c.metaId)});
+
+    auto it = contextIds.find(elements);
+    if (it != contextIds.end())
+      return it->second;
+
+    uint32_t id = contextIndex.size();
+    contextIndex.push_back(
+        {static_cast<uint32_t>(contextPool.size()),
+         static_cast<uint32_t>(elements.size())});
+    contextPool.insert(contextPool.end(), elements.begin(), elements.end());
+    contextIds.emplace(std::move(elements), id);
+    return id;
+  }
+
+  /// the profile is written to a temporary file and renamed, so `filename`
+  /// can still be mapped by a reader (e.g., when accumulating)
+  bool write(const char *filename) {
+    addSection(ProfileSection::CONTEXT_INDEX, contextIndex);
+    addSection(ProfileSection::CONTEXT_POOL, contextPool);
+
+    const std::string tmpname = std::string(filename) + ".tmp";
+    bool success = dump(tmpname.c_str());
+    if (success && rename(tmpname.c_str(), filename) != 0) {
+      perror(filename);
+      success = false;
+    }
+
+    // drop the context table again, a later write adds it back
+    sections.pop_back();
+    sections.pop_back();
+    return success;
+  }
+
+private:
+  bool dump(const char *filename) {
+    uint64_t offset = align(sizeof(ProfileHeader) +
+                            sections.size() * sizeof(SectionHeader));
+    for (auto &section : sections) {
+      section.header.offset = offset;
+      offset = align(offset + section.data.size());
+    }
+    const uint64_t file_size = offset;
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      perror(filename);
+      return false;
+    }
+    if (ftruncate(fd, file_size) != 0) {
+      perror(filename);
+      close(fd);
+      return false;
+    }
+    auto *base = static_cast<char *>(
+        mmap(nullptr, file_size, PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    if (base == MAP_FAILED) {
+      perror(filename);
+      return false;
+    }
+
+    ProfileHeader header;
+    memcpy(header.magic, PROFILE_MAGIC, sizeof(header.magic));
+    header.version = PROFILE_VERSION;
+    header.num_sections = sections.size();
+    header.file_size = file_size;
+    memcpy(base, &header, sizeof(header));
+
+    auto *table = base + sizeof(ProfileHeader);
+    for (auto &section : sections) {
+      memcpy(table, &section.header, sizeof(SectionHeader));
+      table += sizeof(SectionHeader);
+      if (!section.data.empty())
+        memcpy(base + section.header.offset, section.data.data(),
+               section.data.size());
+    }
+
+    munmap(base, file_size);
+    return true;
+  }
+};
+
+template <typename T> struct ProfileSpan {
+  const T *data = nullptr;
+  uint64_t count = 0;
+
+  const T *begin() const { return data; }
+  const T *end() const { return data + count; }
+  uint64_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  const T &operator[](uint64_t i) const { return data[i]; }
+};
+
+/// Maps a profile read-only; the records are used in place
+class ProfileReader {
+  const char *base = nullptr;
+  uint64_t size = 0;
+  const ProfileHeader *header = nullptr;
+  const SectionHeader *table = nullptr;
+
+  ProfileSpan<ContextRange> contextIndex;
+  ProfileSpan<ContextElement> contextPool;
+
+public:
+  ProfileReader() = default;
+  ProfileReader(const ProfileReader &) = delete;
+  ProfileReader &operator=(const ProfileReader &) = delete;
+
+  ~ProfileReader() {
+    if (base)
+      munmap(const_cast<char *>(base), size);
+  }
+
+  bool open(const char *filename) {
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+      perror(filename);
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ProfileHeader)) {
+      fprintf(stderr, "%s: not a PROMPT profile\n", filename);
+      ::close(fd);
+      return false;
+    }
+    size = st.st_size;
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      perror(filename);
+      return false;
+    }
+    base = static_cast<const char *>(p);
+
+    header = reinterpret_cast<const ProfileHeader *>(base);
+    if (memcmp(header->magic, PROFILE_MAGIC, sizeof(PROFILE_MAGIC)) != 0 ||
+        header->file_size != size) {
+      fprintf(stderr, "%s: not a PROMPT profile\n", filename);
+      return false;
+    }
+    if (header->version != PROFILE_VERSION) {
+      fprintf(stderr, "%s: unsupported profile version %u\n", filename,
+              header->version);
+      return false;
+    }
+    table = reinterpret_cast<const SectionHeader *>(base + sizeof(ProfileHeader));
+
+    // a truncated or corrupt profile must not be read past the mapping
+    if (header->num_sections >
+        (size - sizeof(ProfileHeader)) / sizeof(SectionHeader)) {
+      fprintf(stderr, "%s: corrupt section table\n", filename);
+      return false;
+    }
+    for (auto &section : sections()) {
+      if (section.offset > size ||
+          (section.count != 0 &&
+           (section.record_size == 0 ||
+            section.count > (size - section.offset) / section.record_size))) {
+        fprintf(stderr, "%s: corrupt section %u\n", filename,
+                (unsigned)section.kind);
+        return false;
+      }
+    }
+
+    auto *index = findSection(ProfileSection::CONTEXT_INDEX);
+    auto *pool = findSection(ProfileSection::CONTEXT_POOL);
+    if ((index && index->record_size != sizeof(ContextRange)) ||
+        (pool && pool->record_size != sizeof(ContextElement))) {
+      fprintf(stderr, "%s: corrupt context sections\n", filename);
+      return false;
+    }
+    contextIndex = records<ContextRange>(ProfileSection::CONTEXT_INDEX);
+    contextPool = records<ContextElement>(ProfileSection::CONTEXT_POOL);
+    for (auto &range : contextIndex) {
+      if ((uint64_t)range.begin + range.size > contextPool.size()) {
+        fprintf(stderr, "%s: corrupt context index\n", filename);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  ProfileSpan<SectionHeader> sections() const {
+    return {table, header ? header->num_sections : 0};
+  }
+
+  const SectionHeader *findSection(ProfileSection kind) const {
+    for (auto &section : sections())
+      if (section.kind == kind)
+        return &section;
+    return nullptr;
+  }
+
+  template <typename T> ProfileSpan<T> records(const SectionHeader &section) const {
+    if (section.record_size != sizeof(T)) {
+      fprintf(stderr,
+              "Profile section %u has records of %u bytes, expected %zu\n",
+              (unsigned)section.kind, section.record_size, sizeof(T));
+      exit(EXIT_FAILURE);
+    }
+    return {reinterpret_cast<const T *>(base + section.offset), section.count};
+  }
+
+  template <typename T> ProfileSpan<T> records(ProfileSection kind) const {
+    auto *section = findSection(kind);
+    if (!section)
+      return {};
+    return records<T>(*section);
+  }
+
+  /// the elements of a context, innermost last
+  ProfileSpan<ContextElement> context(uint32_t id) const {
+    if (id >= contextIndex.size())
+      return {};
+    auto &range = contextIndex[id];
+    return {contextPool.data + range.begin, range.size};
+  }
+
+  /// rebuild the ContextIds of a module, the inverse of `addContext`
+  template <typename ContextIdT>
+  std::vector<ContextIdT> decodeContext(uint32_t id) const {
+    std::vector<ContextIdT> decoded;
+    for (auto &e : context(id))
+      decoded.emplace_back(static_cast<decltype(ContextIdT::type)>(e.type),
+                           e.id);
+    return decoded;
+  }
+};
+
+} // namespace slamp
+
+#endif
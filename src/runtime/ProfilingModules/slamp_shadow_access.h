@@ -0,0 +1,79 @@
+#pragma once
+// Multi-byte accesses on a shadow of one time stamp per byte. A 4- or 8-byte
+// access covers 4 or 8 stamps; they are nearly always the same (the last
+// store wrote them all), so the common case is one vector compare.
+//
+// With AVX2 (-DRUNTIME_AVX2=ON, or e.g. -march=native) the stamps are handled
+// 4 at a time, without it the scalar loops do the same.
+#include <cstdint>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "slamp_timestamp.h"
+
+namespace slamp {
+
+/// the slots an access of `size` bytes covers, a slot per 2^`granularity`
+/// bytes
+inline uint32_t shadow_slots(const uint64_t addr, const uint32_t size,
+                             const unsigned granularity) {
+  if (size == 0)
+    return 0;
+  return ((addr + size - 1) >> granularity) - (addr >> granularity) + 1;
+}
+
+/// the stamps of a store of `n` bytes
+inline void shadow_fill(TS *s, const TS ts, const uint32_t n) {
+  uint32_t i = 0;
+#ifdef __AVX2__
+  const __m256i v = _mm256_set1_epi64x(ts);
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(s + i), v);
+
+  // the last 1-3, the masked lanes are not touched even across a page
+  if (i < n) {
+    const __m256i tail = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - i),
+                                            _mm256_setr_epi64x(0, 1, 2, 3));
+    _mm256_maskstore_epi64(reinterpret_cast<long long *>(s + i), tail, v);
+  }
+#else
+  for (; i < n; i++)
+    s[i] = ts;
+#endif
+}
+
+/// calls `f` with each stamp of a load of `n` bytes, skipping the bytes never
+/// stored to and a stamp repeated by the next byte. Only runs are collapsed:
+/// stamps A B A call `f` with A twice
+template <typename F>
+inline void shadow_for_each_stamp(const TS *s, const uint32_t n, F &&f) {
+  TS last = 0;
+  auto visit = [&](const TS ts) {
+    if (ts != last) {
+      last = ts;
+      if (ts != 0)
+        f(ts);
+    }
+  };
+
+  uint32_t i = 0;
+#ifdef __AVX2__
+  for (; i + 4 <= n; i += 4) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+    const __m256i same = _mm256_cmpeq_epi64(v, _mm256_set1_epi64x(s[i]));
+    if (_mm256_movemask_epi8(same) == -1) {
+      visit(s[i]);
+      continue;
+    }
+    for (uint32_t j = i; j < i + 4; j++)
+      visit(s[j]);
+  }
+#endif
+  for (; i < n; i++)
+    visit(s[i]);
+}
+
+} // namespace slamp
@@ -15,6 +15,9 @@
 #include <set>
 #include <unordered_map>
 
+#include "PageOwners.h"
+#include "slamp_numa.h"
+
 // higher half of canonical region cannot be used
 
 /// left shift by `shift`, mask 47 LSB, toggle #45 bit?
@@ -28,30 +31,73 @@
   (((((uint64_t)(addr)) << (shift)) & MASK1) ^ MASK2_PT)
 #define GET_SHADOW_OL(addr, shift)                                                \
   (((((uint64_t)(addr)) << (shift)) & MASK1) ^ MASK2_OL)
+/// GET_SHADOW with one slot per 2^`granularity` bytes of data
+#define GET_SHADOW_GRANULAR(addr, shift, granularity)                          \
+  ((((((uint64_t)(addr)) >> (granularity)) << (shift)) & MASK1) ^ MASK2)
 
 namespace slamp {
 
+/// log2 of the data bytes per shadow slot (--shadow-granularity): 1, 4, 8 or
+/// 64 bytes, -1 for the others
+inline int granularity_shift(unsigned bytes) {
+  switch (bytes) {
+  case 1:
+    return 0;
+  case 4:
+    return 2;
+  case 8:
+    return 3;
+  case 64:
+    return 6;
+  default:
+    return -1;
+  }
+}
+
+/// the data pages the LocalWriteModule threads own, as a shift; when the
+/// shadow of a page is shorter than a page, a thread owns all the pages
+/// that share a shadow page, so no two threads map it
+inline uint32_t local_write_shift(unsigned ratio_shift, unsigned granularity) {
+  return 12 + (granularity > ratio_shift ? granularity - ratio_shift : 0);
+}
+
 template <uint64_t MASK2_VAL=MASK2>
 class MemoryMap {
 private:
   inline uint64_t get_shadow(uint64_t addr, uint64_t shift) {
-    return (((addr << shift) & MASK1) ^ MASK2_VAL);
+    return ((((addr >> granularity) << shift) & MASK1) ^ MASK2_VAL);
   }
   // TODO: fix this redundant info as the LocalWriteModule
   const uint32_t LOCALWRITE_MASK{};
   const uint32_t LOCALWRITE_PATTERN{};
-  static constexpr uint32_t LOCALWRITE_SHIFT = 12; // PAGE SIZE 4096 = 2^12
+  const uint32_t LOCALWRITE_SHIFT; // PAGE SIZE 4096 = 2^12, or wider
+  PageOwners *owners = nullptr;
 
   bool local_write_cond(uint64_t addr) {
+    if (owners)
+      return owners->owner(addr >> LOCALWRITE_SHIFT) == LOCALWRITE_PATTERN;
     if (((addr >> LOCALWRITE_SHIFT) & LOCALWRITE_MASK) == LOCALWRITE_PATTERN)
       return true;
     return false;
   }
 
+  // whether a page of the group of `page` is allocated already, so its shared
+  // shadow page is mapped; `pages` is the same in every thread, while the
+  // thread that mapped it may have handed the group over since
+  bool group_allocated(uint64_t page) {
+    const uint64_t first = page >> LOCALWRITE_SHIFT << LOCALWRITE_SHIFT;
+    auto it = pages.lower_bound(first);
+    return it != pages.end() && *it < first + (1ULL << LOCALWRITE_SHIFT);
+  }
+
 public:
   uint64_t heapStart = 0;
-  MemoryMap(uint32_t mask, uint32_t pattern, unsigned r)
-      : LOCALWRITE_MASK(mask), LOCALWRITE_PATTERN(pattern), ratio(r), ratio_shift(0)  {
+  /// `r` bytes of shadow per slot, a slot per 2^`granularity` bytes of data
+  MemoryMap(uint32_t mask, uint32_t pattern, unsigned r,
+            unsigned granularity = 0)
+      : LOCALWRITE_MASK(mask), LOCALWRITE_PATTERN(pattern),
+        LOCALWRITE_SHIFT(local_write_shift(__builtin_ctz(r), granularity)),
+        ratio(r), ratio_shift(0), granularity(granularity) {
     // ratio expected to be a power of 2
     assert((r & (r - 1)) == 0);
 
@@ -65,20 +111,36 @@ public:
     // get the page size of the host system
     pagesize = getpagesize();
     pagemask = ~(pagesize - 1);
+
+    // a shadow page is shared by the pages of data next to each other
+    shared_shadow = granularity > ratio_shift;
+    page_shadow_size =
+        shared_shadow ? pagesize : (pagesize >> granularity) * ratio;
   }
 
   ~MemoryMap() {
     // freeing all remaining shadow addresses
+    if (shared_shadow) {
+      for (auto s : shared_shadow_pages)
+        munmap(reinterpret_cast<void *>(s), pagesize);
+      return;
+    }
     for (auto page : pages) {
       if (!local_write_cond(page))
         continue;
       uint64_t s = get_shadow(page, ratio_shift);
-      munmap(reinterpret_cast<void *>(s), pagesize * ratio);
+      munmap(reinterpret_cast<void *>(s), page_shadow_size);
     }
   }
 
   unsigned get_ratio() { return ratio; }
 
+  /// bind the shadow pages allocated from now on to `n`
+  void bind_to_node(int n) { node = n; }
+
+  /// own the pages through `o` (LocalWriteModule::set_page_owners)
+  void set_page_owners(PageOwners *o) { owners = o; }
+
   bool is_allocated(void *addr) {
     auto a = reinterpret_cast<uint64_t>(addr);
     uint64_t page = a & pagemask;
@@ -106,8 +168,14 @@ public:
         continue;
 
       uint64_t s = get_shadow(page, ratio_shift);
+      if (shared_shadow) {
+        s &= pagemask;
+        if (shared_shadow_pages.count(s) || group_allocated(page) ||
+            shadow_pages.count(reinterpret_cast<void *>(s)))
+          continue;
+      }
       // create a shadow page for the page
-      void *p = mmap(reinterpret_cast<void *>(s), pagesize * ratio,
+      void *p = mmap(reinterpret_cast<void *>(s), page_shadow_size,
                      PROT_WRITE | PROT_READ,
                      // So do not replace the orignal program memory by accident
                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
@@ -124,6 +192,8 @@ public:
           break;
         // }
       } else {
+        if (node >= 0)
+          numa::bindMemory(p, page_shadow_size, node);
         shadow_pages.insert(p);
       }
     }
@@ -131,6 +201,9 @@ public:
     if (success) {
       for (uint64_t page = pagebegin; page <= pageend; page += pagesize)
         pages.insert(page);
+      if (shared_shadow)
+        for (auto *shadow_page : shadow_pages)
+          shared_shadow_pages.insert(reinterpret_cast<uint64_t>(shadow_page));
       uint64_t pagebegin = a & pagemask;
       uint64_t pageend = (a + size - 1) & pagemask;
 
@@ -140,15 +213,17 @@ public:
     } else {
       // cleanup
       for (auto shadow_page : shadow_pages)
-        munmap(shadow_page, pagesize * ratio);
+        munmap(shadow_page, page_shadow_size);
       return nullptr;
     }
   }
 
   // free the shadow pages
   void deallocate_pages(uint64_t page, unsigned cnt) {
-    munmap(reinterpret_cast<void *>(get_shadow(page, ratio_shift)),
-           pagesize * ratio * cnt);
+    // a shared shadow page may still hold the neighbours, it stays
+    if (!shared_shadow)
+      munmap(reinterpret_cast<void *>(get_shadow(page, ratio_shift)),
+             page_shadow_size * cnt);
 
     // fprintf(stderr, "deallocate_pages: %lx %d\n", get_shadow(page, ratio_shift), cnt);
 
@@ -158,9 +233,10 @@ public:
 
   /// for realloc; the dependence carries over
   void copy(void *dst, void *src, size_t size) {
-    size_t shadow_size = size * ratio;
-    void *shadow_dst = (void *)get_shadow(dst, ratio_shift);
-    void *shadow_src = (void *)get_shadow(src, ratio_shift);
+    size_t shadow_size =
+        ((size + (1 << granularity) - 1) >> granularity) * ratio;
+    void *shadow_dst = (void *)get_shadow((uint64_t)dst, ratio_shift);
+    void *shadow_src = (void *)get_shadow((uint64_t)src, ratio_shift);
     memcpy(shadow_dst, shadow_src, shadow_size);
   }
 
@@ -242,6 +318,16 @@ private:
 
   unsigned ratio; // (size of metadata) / (size of real data)
   unsigned ratio_shift;
+  // log2 of the data bytes per slot
+  unsigned granularity;
+  // the shadow mapped for a page of data; with `shared_shadow` it is the
+  // whole shadow page the neighbouring pages share, mapped once
+  uint64_t page_shadow_size;
+  bool shared_shadow;
+  std::set<uint64_t> shared_shadow_pages;
+  // the shadow pages are bound to this node, -1 to leave them where they are
+  // first touched
+  int node = -1;
   uint64_t pagesize;
   uint64_t pagemask;
 };
@@ -0,0 +1,123 @@
+#ifndef SLAMPLIB_HOOKS_SLAMP_SPECPRIV_H
+#define SLAMPLIB_HOOKS_SLAMP_SPECPRIV_H
+
+// SpecPriv profile of the PROMPT modules
+//
+// Spells the points-to, object-lifetime and loaded-value results the way the
+// SpecPriv clients read them, naming the IDs with the symbol table. A context
+// is any indexable range of elements with `type` and `id` (ContextElement),
+// innermost last, as the binary profile stores it.
+
+#include <iostream>
+#include <vector>
+
+#include "slamp_profile.h"
+#include "slamp_symbols.h"
+
+namespace slamp {
+
+class SpecPrivEmitter {
+  std::ostream &os;
+  const SymbolTable &symbols;
+
+  // the target loop, where the objects are local and the values predicted
+  std::vector<ContextElement> loopContext;
+  bool hasLoopContext = false;
+
+  void name(uint32_t id, std::string_view symbol) {
+    if (symbol.empty())
+      os << id;
+    else
+      os << symbol;
+  }
+
+  template <typename Context> void context(const Context &context) {
+    os << "CONTEXT { ";
+    for (auto i = context.size(); i > 0; i--)
+      symbols.printContextElement(os, context[i - 1].type, context[i - 1].id);
+    os << " }";
+  }
+
+  void loop() {
+    if (hasLoopContext)
+      context(loopContext);
+    else
+      os << "CONTEXT { TOP }";
+  }
+
+public:
+  SpecPrivEmitter(std::ostream &os, const SymbolTable &symbols)
+      : os(os), symbols(symbols) {}
+
+  void begin() {
+    os << "BEGIN SPEC PRIV PROFILE\n";
+    os << "COMPLETE ALLOCATION INFO ;\n";
+  }
+
+  void end() { os << "END SPEC PRIV PROFILE\n"; }
+
+  /// only one target loop is supported, the first context is kept
+  template <typename Context> void addLoopContext(const Context &context) {
+    if (hasLoopContext) {
+      std::cerr << "SpecPriv: more than one loop context, using the first\n";
+      return;
+    }
+    for (uint64_t i = 0; i < context.size(); i++)
+      loopContext.push_back({context[i].type, context[i].id});
+    hasLoopContext = true;
+  }
+
+  /// `au` is an allocation instruction or a PointsToAU
+  template <typename Context, typename AUContext>
+  void predictObject(uint32_t uoId, const Context &uoContext, int32_t au,
+                     const AUContext &auContext) {
+    // more than one AU, nothing to predict
+    if (au == PT_AU_NOT_CONSTANT)
+      return;
+
+    os << "PRED OBJ ";
+    name(uoId, symbols.underlying(uoId));
+    os << " AT ";
+    context(uoContext);
+    os << " AS PREDICTABLE 1 SAMPLES OVER 1 VALUES { ( OFFSET 0 BASE ";
+    if (au == PT_AU_UNMANAGED) {
+      os << "AU HEAP UNMANAGED fopen FROM CONTEXT { TOP }";
+    } else if (au == PT_AU_NULL) {
+      os << "AU NULL";
+    } else {
+      os << "AU HEAP ";
+      name(au, symbols.lookup(SymbolKind::INSTRUCTION, au));
+      os << " FROM ";
+      context(auContext);
+    }
+    os << " COUNT 1 ) } ;\n";
+  }
+
+  template <typename Context>
+  void localObject(uint32_t instr, const Context &creation) {
+    os << "LOCAL OBJECT AU HEAP ";
+    name(instr, symbols.lookup(SymbolKind::INSTRUCTION, instr));
+    os << " FROM ";
+    context(creation);
+    os << " IS LOCAL TO ";
+    loop();
+    os << " COUNT 1 ;\n";
+  }
+
+  /// only the integer loads are predicted this way; the pointers are
+  /// predicted by the points-to module
+  void predictValue(uint32_t instr, uint64_t value) {
+    auto symbol = symbols.lookup(SymbolKind::INTEGER_LOAD, instr);
+    if (symbol.empty())
+      return;
+
+    os << "PRED INT " << symbol << " AT ";
+    loop();
+    os << " AS PREDICTABLE 1 SAMPLES OVER 1 VALUES { ( INT " << value
+       << " COUNT 1 ) } ;\n";
+  }
+};
+
+} // namespace slamp
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef SLAMPLIB_HOOKS_SLAMP_SYMBOLS_H
+#define SLAMPLIB_HOOKS_SLAMP_SYMBOLS_H
+
+// Symbol table of an instrumented program
+//
+// The SLAMP pass knows instructions, functions and loops by the IDs of the
+// Namer; it writes what the IDs stand for next to the program
+// (-slamp-symbols, result.slamp.symbols by default). The table is a profile
+// container (slamp_profile.h): SYMBOLS holds a SymbolRecord per ID, sorted by
+// (kind, id), pointing into the characters of SYMBOL_STRINGS. Readers map it
+// and resolve a name only when they print it.
+
+#include <cstdlib>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "slamp_profile.h"
+
+namespace slamp {
+
+static constexpr const char *SYMBOLS_DEFAULT_FILE = "result.slamp.symbols";
+
+enum class SymbolKind : uint32_t {
+  INSTRUCTION = 1, // "fcn block name", or "fcn block $offset" if unnamed
+  ARGUMENT,        // by underlying-object ID, "argument fcn %no"
+  FUNCTION,        // "fcn"
+  LOOP,            // "fcn header depth"
+  INTEGER_LOAD,    // a load of an integer, its value can be predicted
+};
+
+// sorted by (kind, id)
+struct SymbolRecord {
+  uint32_t kind;
+  uint32_t id;
+  uint32_t offset; // into SYMBOL_STRINGS
+  uint32_t size;
+};
+
+static_assert(sizeof(SymbolRecord) == 16, "stable on-disk layout");
+
+// the IDs the runtime uses for underlying objects, see FORMAT_INST_ARG and
+// FORMAT_INST_INST of the PointsToModule
+inline uint32_t underlyingArgId(uint32_t fcnId, uint32_t argId) {
+  return fcnId << 5 | ((0x1f & (argId << 4)) | 0x1);
+}
+inline uint32_t underlyingInstId(uint32_t instId) { return instId << 1; }
+
+/// Collects the names of one module, the first name of an ID wins
+class SymbolTableWriter {
+  std::map<std::pair<uint32_t, uint32_t>, std::string> names;
+
+public:
+  void add(SymbolKind kind, uint32_t id, std::string name) {
+    names.emplace(std::make_pair(static_cast<uint32_t>(kind), id),
+                  std::move(name));
+  }
+
+  bool write(const char *filename) const {
+    std::vector<SymbolRecord> records;
+    std::vector<char> strings;
+    records.reserve(names.size());
+    for (auto &[key, name] : names) {
+      records.push_back({key.first, key.second,
+                         static_cast<uint32_t>(strings.size()),
+                         static_cast<uint32_t>(name.size())});
+      strings.insert(strings.end(), name.begin(), name.end());
+    }
+
+    // `names` is ordered by (kind, id) already
+    ProfileWriter writer;
+    writer.addSection(ProfileSection::SYMBOLS, records);
+    writer.addSection(ProfileSection::SYMBOL_STRINGS, strings);
+    return writer.write(filename);
+  }
+};
+
+/// Maps a symbol table read-only. A table that is not open resolves nothing,
+/// the callers then fall back to the IDs
+class SymbolTable {
+  ProfileReader reader;
+  ProfileSpan<SymbolRecord> records;
+  ProfileSpan<char> strings;
+
+public:
+  bool open(const char *filename) {
+    if (!reader.open(filename))
+      return false;
+    records = reader.records<SymbolRecord>(ProfileSection::SYMBOLS);
+    strings = reader.records<char>(ProfileSection::SYMBOL_STRINGS);
+    return true;
+  }
+
+  bool empty() const { return records.empty(); }
+
+  /// empty if the ID has no name
+  std::string_view lookup(SymbolKind kind, uint32_t id) const {
+    const SymbolRecord key = {static_cast<uint32_t>(kind), id, 0, 0};
+    auto it = std::lower_bound(
+        records.begin(), records.end(), key,
+        [](const SymbolRecord &a, const SymbolRecord &b) {
+          return a.kind < b.kind || (a.kind == b.kind && a.id < b.id);
+        });
+    if (it == records.end() || it->kind != key.kind || it->id != id)
+      return {};
+    return {strings.data + it->offset, it->size};
+  }
+
+  /// an underlying-object ID, of an instruction or an argument
+  std::string_view underlying(uint32_t uoId) const {
+    if (uoId & 0x1)
+      return lookup(SymbolKind::ARGUMENT, uoId);
+    return lookup(SymbolKind::INSTRUCTION, uoId >> 1);
+  }
+
+  /// the name, or the ID if it has none
+  void print(std::ostream &os, SymbolKind kind, uint32_t id) const {
+    auto name = lookup(kind, id);
+    if (name.empty())
+      os << id;
+    else
+      os << name;
+  }
+
+  /// one element of a SpecPriv context, "LOOP main for.cond 1 WITHIN ",
+  /// `type` as in SpecPrivContextType
+  void printContextElement(std::ostream &os, uint32_t type, uint32_t id) const {
+    switch (type) {
+    case 1:
+      os << "FUNCTION ";
+      print(os, SymbolKind::FUNCTION, id);
+      os << " WITHIN ";
+      break;
+    case 2:
+      os << "LOOP ";
+      print(os, SymbolKind::LOOP, id);
+      os << " WITHIN ";
+      break;
+    default:
+      os << "TOP";
+      break;
+    }
+  }
+};
+
+/// Where `symbols()` finds the table: $SLAMP_SYMBOLS, or SYMBOLS_DEFAULT_FILE
+/// in the working directory; set it before the first use to override
+inline std::string &symbolsPath() {
+  static std::string path = [] {
+    const char *env = getenv("SLAMP_SYMBOLS");
+    return std::string(env ? env : SYMBOLS_DEFAULT_FILE);
+  }();
+  return path;
+}
+
+/// The symbols of the profiled program, mapped on first use. Without a table
+/// the profiles keep the IDs
+inline const SymbolTable &symbols() {
+  static const SymbolTable *table = [] {
+    auto *t = new SymbolTable();
+    if (access(symbolsPath().c_str(), R_OK) == 0)
+      t->open(symbolsPath().c_str());
+    return t;
+  }();
+  return *table;
+}
+
+} // namespace slamp
+
+#endif
@@ -1,6 +1,3 @@
-#include <boost/interprocess/allocators/allocator.hpp>
-#include <boost/interprocess/interprocess_fwd.hpp>
-#include <boost/interprocess/managed_shared_memory.hpp>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
@@ -8,14 +5,22 @@
 #include <sstream>
 #include <xmmintrin.h>
 
+#include "ProfilingModules/BatchDependenceModule.h"
+#include "ProfilingModules/ControlTimeline.h"
 #include "ProfilingModules/DependenceModule.h"
 #include "ProfilingModules/DependenceWithContextModule.h"
 #include "ProfilingModules/LoadedValueModule.h"
 #include "ProfilingModules/ObjectLifetimeModule.h"
+#include "ProfilingModules/PageOwners.h"
 #include "ProfilingModules/PointsToModule.h"
 #include "ProfilingModules/PrivateerProfiler.h"
+#include "ProfilingModules/ValuePatternModule.h"
 #include "ProfilingModules/WholeProgramDependenceModule.h"
+#include "ProfilingModules/slamp_numa.h"
+#include "ProfilingModules/slamp_profile.h"
+#include "ProfilingModules/slamp_symbols.h"
 #include "sw_queue_astream.h"
+#include "sw_queue_shm.h"
 
 #include "cxxopts.hpp"
 
@@ -23,8 +28,6 @@
 #define CONSUME_LOOP_ATTRIBUTES                                                \
   ATTRIBUTE(noinline) ATTRIBUTE(hot) ATTRIBUTE(aligned(4096))
 
-namespace bip = boost::interprocess;
-
 static inline uint64_t rdtsc() {
   uint64_t a, d;
   __asm__ volatile("rdtsc" : "=a"(a), "=d"(d));
@@ -67,7 +70,9 @@ enum AvailableModules {
   WHOLE_PROGRAM_DEPENDENCE_MODULE = 4,
   PRIVATEER_PROFILER = 5,
   DEPENDENCE_WITH_CONTEXT_MODULE = 6,
-  NUM_MODULES = 7
+  VALUE_PATTERN_MODULE = 7,
+  BATCH_DEPENDENCE_MODULE = 8,
+  NUM_MODULES = 9
 };
 constexpr AvailableModules DEFAULT_MODULE = DEPENDENCE_MODULE;
 constexpr unsigned DEFAULT_THREAD_COUNT = 8;
@@ -86,8 +91,91 @@ static uint64_t load_time(0);
 static uint64_t store_time(0);
 static uint64_t alloc_time(0);
 
-// create segment and corresponding allocator
-bip::fixed_managed_shared_memory *segment;
+// set with `--format binary`, all modules dump into one binary profile
+static slamp::ProfileWriter *profileWriter = nullptr;
+static std::string binaryProfile = "prompt.prof";
+// set with `--accumulate`, the profile of the previous runs
+static slamp::ProfileReader *previousProfile = nullptr;
+
+// set with `--cpus`, consumer thread `id` runs on consumerCpus[id % size];
+// with `--numa-bind-shadow` the shadow memory of its module is on the node of
+// that cpu
+static std::vector<int> consumerCpus;
+static bool numaBindShadow = false;
+
+static void pin_consumer(unsigned id) {
+  if (consumerCpus.empty())
+    return;
+  const int cpu = consumerCpus[id % consumerCpus.size()];
+  if (!slamp::numa::pinCurrentThread(cpu))
+    std::cout << "Cannot pin consumer thread " << id << " to cpu " << cpu
+              << std::endl;
+}
+
+// set with `--shadow-granularity`, log2 of the data bytes per shadow slot
+static unsigned shadowGranularity = 0;
+
+// each module declares the coarsest shadow its results hold with
+template <typename Module> static void check_granularity() {
+  if ((1u << shadowGranularity) > Module::MAX_SHADOW_GRANULARITY) {
+    std::cout << "--shadow-granularity: the module takes at most "
+              << Module::MAX_SHADOW_GRANULARITY << " bytes per slot"
+              << std::endl;
+    exit(-1);
+  }
+}
+
+// the dependence modules own their pages through a table, so any number of
+// threads works; with `--rebalance` the hot page groups move to the idle
+// threads at each buffer swap
+static slamp::PageOwners *pageOwners = nullptr;
+static bool rebalancePages = false;
+
+static void rebalance_pages(const uint32_t *data, uint64_t size) {
+  pageOwners->rebalance();
+}
+
+template <typename Module>
+static void share_pages(Module **mods, DoubleQueue **dqs, unsigned threads) {
+  if (threads == 1)
+    return;
+  pageOwners = new slamp::PageOwners(threads);
+  for (unsigned i = 0; i < threads; i++) {
+    mods[i]->set_page_owners(pageOwners);
+    if (rebalancePages)
+      dqs[i]->on_buffer = rebalance_pages;
+  }
+}
+
+static void report_rebalance() {
+  if (pageOwners && rebalancePages)
+    std::cout << "Rebalanced " << pageOwners->rebalance_count()
+              << " times, moved " << pageOwners->groups_moved()
+              << " page groups" << std::endl;
+}
+
+template <typename Module> static void place_shadow(Module &mod, unsigned id) {
+  if (!numaBindShadow)
+    return;
+  mod.bind_shadow(
+      slamp::numa::nodeOfCpu(consumerCpus[id % consumerCpus.size()]));
+}
+
+// write the result of a module as text to `filename`, or into the binary
+// profile
+template <typename Module>
+static void write_profile(Module &mod, const char *filename) {
+  if (previousProfile) {
+    auto added = mod.accumulate(*previousProfile);
+    std::cout << "Accumulated into " << binaryProfile << ": " << added
+              << " new entries" << std::endl;
+  }
+
+  if (profileWriter)
+    mod.dump(*profileWriter);
+  else
+    mod.fini(filename);
+}
 
 // measure time with lambda action
 auto measure_time = [](uint64_t &time, auto action) {
@@ -102,6 +190,54 @@ auto measure_time = [](uint64_t &time, auto action) {
   }
 };
 
+#ifdef UNIFIED_WORKFLOW
+// The control events are replayed once per buffer, by the thread handing the
+// buffer out; the module threads look the state up with `control_stamp`.
+static ControlTimeline controlTimeline;
+
+static void scan_control(const uint32_t *data, uint64_t size) {
+  controlTimeline.clear();
+  for (uint64_t index = 0; index < size; index += 4) {
+    auto action = static_cast<Action>(data[index] & 0xFF);
+    switch (action) {
+    case Action::LOAD:
+    case Action::REALLOC:
+      // two packets
+      index += 4;
+      break;
+    case Action::TARGET_LOOP_INVOC:
+      controlTimeline.loop_invoc(index);
+      break;
+    case Action::TARGET_LOOP_ITER:
+      controlTimeline.loop_iter(index);
+      break;
+    case Action::TARGET_LOOP_EXIT:
+      controlTimeline.loop_exit(index);
+      break;
+    case Action::LOOP_ENTRY:
+      controlTimeline.loop_entry(index, data[index + 1]);
+      break;
+    case Action::LOOP_EXIT:
+      controlTimeline.loop_exit(index, data[index + 1]);
+      break;
+    case Action::FUNC_ENTRY:
+      controlTimeline.func_entry(index, data[index + 1]);
+      break;
+    case Action::FUNC_EXIT:
+      controlTimeline.func_exit(index, data[index + 1]);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+// the control state after the event just consumed from `dq`
+static const ControlStamp &control_stamp(DoubleQueue &dq) {
+  return controlTimeline.at(dq.packetIndex(), dq.cursor);
+}
+#endif
+
 void consume_loop_lv(DoubleQueue &dq,
                      LoadedValueModule &lvMod) CONSUME_LOOP_ATTRIBUTES {
   uint64_t rdtsc_start = 0;
@@ -144,7 +280,6 @@ void consume_loop_lv(DoubleQueue &dq,
 
 #ifdef UNIFIED_WORKFLOW
       dq.unpack_32_64(instr, addr);
-      dq.check();
       dq.consumePacket();
       dq.unpack_64(value);
 #else
@@ -155,11 +290,15 @@ void consume_loop_lv(DoubleQueue &dq,
       break;
     };
 #ifdef UNIFIED_WORKFLOW
+    case Action::REALLOC:
+      dq.skipPacket();
+      break;
     case Action::STORE:
     case Action::ALLOC:
     case Action::FREE:
-    case Action::LOOP_INVOC:
+    case Action::TARGET_LOOP_INVOC:
     case Action::TARGET_LOOP_ITER:
+    case Action::TARGET_LOOP_EXIT:
     case Action::LOOP_ENTRY:
     case Action::LOOP_EXIT:
     case Action::LOOP_ITER_CTX:
@@ -200,7 +339,7 @@ void consume_loop_lv(DoubleQueue &dq,
                 << std::endl;
 
       for (int i = 0; i < 101; i++) {
-        std::cout << dq.qNow->data[dq.index - 100 + i] << " ";
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
       }
       exit(-1);
     }
@@ -215,6 +354,121 @@ void consume_loop_lv(DoubleQueue &dq,
   }
 }
 
+void consume_loop_vp(DoubleQueue &dq,
+                     ValuePatternModule &vpMod) CONSUME_LOOP_ATTRIBUTES {
+  uint64_t rdtsc_start = 0;
+  uint64_t counter = 0;
+  uint32_t loop_id;
+
+  bool finished = false;
+  while (true) {
+    dq.check();
+    uint32_t v;
+    v = dq.consumePacket();
+    counter++;
+
+    // convert v to action
+    auto action = static_cast<Action>(v);
+
+    switch (action) {
+    case Action::INIT: {
+      uint32_t pid;
+      dq.unpack_32_32(loop_id, pid);
+      rdtsc_start = rdtsc();
+
+      if (CONSUME_DEBUG) {
+        std::cout << "INIT: " << loop_id << " " << pid << std::endl;
+      }
+      if (ACTION) {
+        vpMod.init(loop_id, pid);
+      }
+      break;
+    };
+    case Action::LOAD: {
+      uint32_t size;
+      uint32_t instr;
+      uint64_t addr;
+      uint64_t value;
+
+      // the value is the first word of the second packet
+      dq.unpack_24_32_64_64(size, instr, addr, value);
+
+      if (CONSUME_DEBUG) {
+        std::cout << "LOAD: " << instr << " " << addr << " " << value
+                  << std::endl;
+      }
+      if (ACTION) {
+        vpMod.load(instr, addr, value);
+      }
+      break;
+    };
+    case Action::TARGET_LOOP_INVOC: {
+      if (CONSUME_DEBUG) {
+        std::cout << "LOOP_INVOC" << std::endl;
+      }
+      if (ACTION) {
+        vpMod.loop_invoc();
+      }
+      break;
+    };
+    case Action::TARGET_LOOP_ITER: {
+      if (CONSUME_DEBUG) {
+        std::cout << "LOOP_ITER" << std::endl;
+      }
+      if (ACTION) {
+        vpMod.loop_iter();
+      }
+      break;
+    };
+#ifdef UNIFIED_WORKFLOW
+    case Action::REALLOC:
+      dq.skipPacket();
+      break;
+    case Action::STORE:
+    case Action::ALLOC:
+    case Action::FREE:
+    case Action::TARGET_LOOP_EXIT:
+    case Action::LOOP_ENTRY:
+    case Action::LOOP_EXIT:
+    case Action::LOOP_ITER_CTX:
+    case Action::FUNC_ENTRY:
+    case Action::FUNC_EXIT:
+    case Action::POINTS_TO_INST:
+    case Action::POINTS_TO_ARG:
+      break;
+#endif
+    case Action::FINISHED: {
+      uint64_t rdtsc_end = rdtsc();
+      // total cycles
+      uint64_t total_cycles = rdtsc_end - rdtsc_start;
+      std::cout << "Finished loop: " << loop_id << " after " << counter
+                << " events" << std::endl;
+      // print time in seconds
+      std::cout << "Total time: " << total_cycles / 2.6e9 << " s" << std::endl;
+      finished = true;
+      break;
+    };
+    default:
+      std::cout << "Unknown action: " << (uint64_t)v << std::endl;
+
+      std::cout << "Is ready to read?:" << dq.qNow->ready_to_read << " "
+                << "Is ready to write?:" << dq.qNow->ready_to_write
+                << std::endl;
+      std::cout << "Index: " << dq.index << " Size:" << dq.qNow->size
+                << std::endl;
+
+      for (int i = 0; i < 101; i++) {
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
+      }
+      exit(-1);
+    }
+
+    if (finished) {
+      break;
+    }
+  }
+}
+
 void consume_loop_ol(DoubleQueue &dq,
                      ObjectLifetimeModule &olMod) CONSUME_LOOP_ATTRIBUTES {
   uint64_t rdtsc_start = 0;
@@ -269,6 +523,9 @@ void consume_loop_ol(DoubleQueue &dq,
       uint64_t addr;
       uint32_t size;
       dq.unpack_24_32_64(instr, size, addr);
+#ifdef UNIFIED_WORKFLOW
+      dq.skipPacket(); // new_ptr
+#endif
 
       if (CONSUME_DEBUG) {
         std::cout << "REALLOC: " << addr << " " << size << std::endl;
@@ -297,6 +554,17 @@ void consume_loop_ol(DoubleQueue &dq,
       }
       break;
     };
+#ifdef UNIFIED_WORKFLOW
+    case Action::TARGET_LOOP_INVOC:
+    case Action::TARGET_LOOP_ITER:
+    case Action::TARGET_LOOP_EXIT:
+    case Action::FUNC_ENTRY:
+    case Action::FUNC_EXIT:
+      if (ACTION) {
+        olMod.set_control(control_stamp(dq));
+      }
+      break;
+#else
     case Action::TARGET_LOOP_INVOC: {
       if (CONSUME_DEBUG) {
         std::cout << "LOOP_INVOC" << std::endl;
@@ -347,13 +615,14 @@ void consume_loop_ol(DoubleQueue &dq,
       }
       break;
     };
+#endif
 #ifdef UNIFIED_WORKFLOW
     case Action::LOAD:
-      dq.check();
-      dq.consumePacket();
+      dq.skipPacket();
       break;
     case Action::STORE:
     case Action::LOOP_ENTRY:
+    case Action::LOOP_EXIT:
     case Action::LOOP_ITER_CTX:
     case Action::POINTS_TO_INST:
     case Action::POINTS_TO_ARG:
@@ -373,11 +642,6 @@ void consume_loop_ol(DoubleQueue &dq,
         std::cout << "Alloc time: " << alloc_time / 2.6e9 << " s" << std::endl;
       }
       finished = true;
-
-      if (ACTION) {
-        olMod.fini("ollog.txt");
-      }
-
       break;
     };
     default:
@@ -390,7 +654,7 @@ void consume_loop_ol(DoubleQueue &dq,
                 << std::endl;
 
       for (int i = 0; i < 101; i++) {
-        std::cout << dq.qNow->data[dq.index - 100 + i] << " ";
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
       }
       exit(-1);
     }
@@ -459,6 +723,9 @@ void consume_loop_pt(DoubleQueue &dq,
       uint64_t addr;
       uint32_t size;
       dq.unpack_24_32_64(instr, size, addr);
+#ifdef UNIFIED_WORKFLOW
+      dq.skipPacket(); // new_ptr
+#endif
 
       if (CONSUME_DEBUG) {
         std::cout << "ALLOC: " << addr << " " << size << std::endl;
@@ -483,6 +750,19 @@ void consume_loop_pt(DoubleQueue &dq,
       }
       break;
     };
+#ifdef UNIFIED_WORKFLOW
+    case Action::TARGET_LOOP_INVOC:
+    case Action::TARGET_LOOP_ITER:
+    case Action::TARGET_LOOP_EXIT:
+    case Action::LOOP_ENTRY:
+    case Action::LOOP_EXIT:
+    case Action::FUNC_ENTRY:
+    case Action::FUNC_EXIT:
+      if (ACTION) {
+        ptMod.set_control(control_stamp(dq));
+      }
+      break;
+#else
     case Action::TARGET_LOOP_INVOC: {
       if (CONSUME_DEBUG) {
         std::cout << "LOOP_INVOC" << std::endl;
@@ -546,6 +826,7 @@ void consume_loop_pt(DoubleQueue &dq,
       }
       break;
     };
+#endif
 
     case Action::POINTS_TO_ARG: {
       uint32_t fcnId;
@@ -580,8 +861,7 @@ void consume_loop_pt(DoubleQueue &dq,
     };
 #ifdef UNIFIED_WORKFLOW
     case Action::LOAD:
-      dq.check();
-      dq.consumePacket();
+      dq.skipPacket();
       break;
     case Action::STORE:
     case Action::LOOP_ITER_CTX:
@@ -614,7 +894,7 @@ void consume_loop_pt(DoubleQueue &dq,
                 << std::endl;
 
       for (int i = 0; i < 101; i++) {
-        std::cout << dq.qNow->data[dq.index - 100 + i] << " ";
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
       }
       exit(-1);
     }
@@ -841,12 +1121,7 @@ void consume_loop_privateer(DoubleQueue &dq, PrivateerProfiler &privateer)
       break;
     };
 #ifdef UNIFIED_WORKFLOW
-    case Action::LOAD:
-      dq.check();
-      dq.consumePacket();
-      break;
     case Action::STORE:
-    case Action::LOOP_ITER_CTX:
       break;
 #endif
     case Action::FINISHED: {
@@ -864,10 +1139,7 @@ void consume_loop_privateer(DoubleQueue &dq, PrivateerProfiler &privateer)
       }
       finished = true;
 
-      if (ACTION) {
-        privateer.fini("privateer.txt");
-      }
-
+      // the shards are merged and written by the caller
       break;
     };
     default:
@@ -880,7 +1152,7 @@ void consume_loop_privateer(DoubleQueue &dq, PrivateerProfiler &privateer)
                 << std::endl;
 
       for (int i = 0; i < 101; i++) {
-        std::cout << dq.qNow->data[dq.index - 100 + i] << " ";
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
       }
       exit(-1);
     }
@@ -1042,7 +1314,7 @@ void consume_loop_whole_program_dep(DoubleQueue &dq,
                 << std::endl;
 
       for (int i = 0; i < 101; i++) {
-        std::cout << dq.qNow->data[dq.index - 100 + i] << " ";
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
       }
       exit(-1);
     }
@@ -1065,8 +1337,9 @@ void consume_loop_whole_program_dep(DoubleQueue &dq,
 #endif
 }
 
-void consume_loop(DoubleQueue &dq,
-                  DependenceModule &depMod) CONSUME_LOOP_ATTRIBUTES {
+// batch mode: the target loop events carry the loop they belong to
+void consume_loop_batch_dep(DoubleQueue &dq, BatchDependenceModule &depMod)
+    CONSUME_LOOP_ATTRIBUTES {
   uint64_t rdtsc_start = 0;
   uint64_t counter = 0;
   uint32_t loop_id;
@@ -1077,18 +1350,10 @@ void consume_loop(DoubleQueue &dq,
     uint32_t v;
     v = dq.consumePacket();
     counter++;
-#ifdef COLLECT_TRACE_EVENT
-    if (event_trace_idx < event_trace_size) {
-      event_trace.push_back(dq.packet);
-      event_trace_idx++;
-    }
-#endif
     auto action = static_cast<Action>(v);
     switch (action) {
     case Action::INIT: {
       uint32_t pid;
-      // loop_id = (uint32_t)dq.consume();
-      // pid = (uint32_t)dq.consume();
       dq.unpack_32_32(loop_id, pid);
       rdtsc_start = rdtsc();
 
@@ -1101,61 +1366,36 @@ void consume_loop(DoubleQueue &dq,
       break;
     };
     case Action::LOAD: {
+      uint32_t size;
       uint32_t instr;
       uint64_t addr;
-      // uint32_t bare_instr;
-
-#ifdef UNIFIED_WORKFLOW
-      dq.unpack_32_64(instr, addr);
-      dq.check();
-      dq.consumePacket();
-      // dq.unpack_64(value);
-#else
-      dq.unpack_32_64(instr, addr);
-#endif
+      dq.unpack_24_32_64(size, instr, addr);
 
       if (CONSUME_DEBUG) {
-        std::cout << "LOAD: " << instr << " " << addr // << " " << bare_instr
+        std::cout << "LOAD: " << instr << " " << addr << " " << size
                   << std::endl;
       }
       if (ACTION) {
-        measure_time(load_time, [&]() { depMod.load(instr, addr, instr); });
-        // [&]() { depMod.load(instr, addr, bare_instr, value); });
+        measure_time(load_time, [&]() { depMod.load(instr, addr, size); });
       }
-
       break;
     };
     case Action::STORE: {
+      uint32_t size;
       uint32_t instr;
-      // uint32_t bare_instr;
       uint64_t addr;
-      dq.unpack_32_64(instr, addr);
+      dq.unpack_24_32_64(size, instr, addr);
 
       if (CONSUME_DEBUG) {
-        std::cout << "STORE: " << instr << " " << addr // << " " << bare_instr
+        std::cout << "STORE: " << instr << " " << addr << " " << size
                   << std::endl;
       }
       if (ACTION) {
-        measure_time(store_time, [&]() { depMod.store(instr, instr, addr); });
-        // [&]() { depMod.store(instr, bare_instr, addr); });
-      }
-      break;
-    };
-    case Action::ALLOC: {
-      uint64_t addr;
-      uint32_t size;
-      dq.unpack_32_64(size, addr);
-
-      if (CONSUME_DEBUG) {
-        std::cout << "ALLOC: " << addr << " " << size << std::endl;
-      }
-      if (ACTION) {
-        measure_time(alloc_time, [&]() {
-          depMod.allocate(reinterpret_cast<void *>(addr), size);
-        });
+        measure_time(store_time, [&]() { depMod.store(instr, addr, size); });
       }
       break;
     };
+    case Action::ALLOC:
     case Action::REALLOC: {
       // FIXME: handle realloc
       uint64_t addr;
@@ -1173,43 +1413,238 @@ void consume_loop(DoubleQueue &dq,
       break;
     };
     case Action::TARGET_LOOP_INVOC: {
+      uint32_t target;
+      dq.unpack_32(target);
       if (CONSUME_DEBUG) {
-        std::cout << "LOOP_INVOC" << std::endl;
+        std::cout << "LOOP_INVOC: " << target << std::endl;
       }
-
       if (ACTION) {
-        depMod.loop_invoc();
+        depMod.loop_invoc(target);
       }
       break;
     };
     case Action::TARGET_LOOP_ITER: {
+      uint32_t target;
+      dq.unpack_32(target);
       if (CONSUME_DEBUG) {
-        std::cout << "LOOP_ITER" << std::endl;
+        std::cout << "LOOP_ITER: " << target << std::endl;
       }
       if (ACTION) {
-        depMod.loop_iter();
+        depMod.loop_iter(target);
       }
       break;
     };
     case Action::TARGET_LOOP_EXIT: {
-      depMod.loop_exit();
-      break;
-    }
-    case Action::FUNC_ENTRY: {
-      uint32_t func_id;
-      dq.unpack_32(func_id);
-      depMod.func_entry(func_id);
+      uint32_t target;
+      dq.unpack_32(target);
+      if (CONSUME_DEBUG) {
+        std::cout << "LOOP_EXIT: " << target << std::endl;
+      }
+      if (ACTION) {
+        depMod.loop_exit(target);
+      }
       break;
     };
-    case Action::FUNC_EXIT: {
-      uint32_t func_id;
+    case Action::FINISHED: {
+      uint64_t rdtsc_end = rdtsc();
+      // total cycles
+      uint64_t total_cycles = rdtsc_end - rdtsc_start;
+      std::cout << "Finished batch after " << counter << " events"
+                << std::endl;
+      // print time in seconds
+      std::cout << "Total time: " << total_cycles / 2.6e9 << " s" << std::endl;
+      if (MEASURE_TIME) {
+        std::cout << "Load time: " << load_time / 2.6e9 << " s" << std::endl;
+        std::cout << "Store time: " << store_time / 2.6e9 << " s" << std::endl;
+        std::cout << "Alloc time: " << alloc_time / 2.6e9 << " s" << std::endl;
+      }
+      finished = true;
+
+      break;
+    };
+    default:
+      std::cout << "Unknown action: " << (uint64_t)v << std::endl;
+
+      std::cout << "Is ready to read?:" << dq.qNow->ready_to_read << " "
+                << "Is ready to write?:" << dq.qNow->ready_to_write
+                << std::endl;
+      std::cout << "Index: " << dq.index << " Size:" << dq.qNow->size
+                << std::endl;
+
+      for (int i = 0; i < 101; i++) {
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
+      }
+      exit(-1);
+    }
+
+    if (finished) {
+      break;
+    }
+  }
+}
+
+void consume_loop(DoubleQueue &dq,
+                  DependenceModule &depMod) CONSUME_LOOP_ATTRIBUTES {
+  uint64_t rdtsc_start = 0;
+  uint64_t counter = 0;
+  uint32_t loop_id;
+
+  bool finished = false;
+  while (true) {
+    dq.check();
+    uint32_t v;
+    v = dq.consumePacket();
+    counter++;
+#ifdef COLLECT_TRACE_EVENT
+    if (event_trace_idx < event_trace_size) {
+      event_trace.push_back(dq.packet);
+      event_trace_idx++;
+    }
+#endif
+    auto action = static_cast<Action>(v);
+    switch (action) {
+    case Action::INIT: {
+      uint32_t pid;
+      // loop_id = (uint32_t)dq.consume();
+      // pid = (uint32_t)dq.consume();
+      dq.unpack_32_32(loop_id, pid);
+      rdtsc_start = rdtsc();
+
+      if (CONSUME_DEBUG) {
+        std::cout << "INIT: " << loop_id << " " << pid << std::endl;
+      }
+      if (ACTION) {
+        depMod.init(loop_id, pid);
+      }
+      break;
+    };
+    case Action::LOAD: {
+      uint32_t size;
+      uint32_t instr;
+      uint64_t addr;
+      // uint32_t bare_instr;
+
+#ifdef UNIFIED_WORKFLOW
+      dq.unpack_24_32_64(size, instr, addr);
+      dq.skipPacket();
+      // dq.unpack_64(value);
+#else
+      dq.unpack_24_32_64(size, instr, addr);
+#endif
+
+      if (CONSUME_DEBUG) {
+        std::cout << "LOAD: " << instr << " " << addr << " " << size
+                  << std::endl;
+      }
+      if (ACTION) {
+        measure_time(load_time,
+                     [&]() { depMod.load(instr, addr, instr, size); });
+        // [&]() { depMod.load(instr, addr, bare_instr, value); });
+      }
+
+      break;
+    };
+    case Action::STORE: {
+      uint32_t size;
+      uint32_t instr;
+      // uint32_t bare_instr;
+      uint64_t addr;
+      dq.unpack_24_32_64(size, instr, addr);
+
+      if (CONSUME_DEBUG) {
+        std::cout << "STORE: " << instr << " " << addr << " " << size
+                  << std::endl;
+      }
+      if (ACTION) {
+        measure_time(store_time,
+                     [&]() { depMod.store(instr, instr, addr, size); });
+        // [&]() { depMod.store(instr, bare_instr, addr); });
+      }
+      break;
+    };
+    case Action::ALLOC: {
+      uint64_t addr;
+      uint32_t size;
+      dq.unpack_32_64(size, addr);
+
+      if (CONSUME_DEBUG) {
+        std::cout << "ALLOC: " << addr << " " << size << std::endl;
+      }
+      if (ACTION) {
+        measure_time(alloc_time, [&]() {
+          depMod.allocate(reinterpret_cast<void *>(addr), size);
+        });
+      }
+      break;
+    };
+    case Action::REALLOC: {
+      // FIXME: handle realloc
+      uint64_t addr;
+      uint32_t size;
+      dq.unpack_32_64(size, addr);
+#ifdef UNIFIED_WORKFLOW
+      dq.skipPacket(); // new_ptr
+#endif
+
+      if (CONSUME_DEBUG) {
+        std::cout << "ALLOC: " << addr << " " << size << std::endl;
+      }
+      if (ACTION) {
+        measure_time(alloc_time, [&]() {
+          depMod.allocate(reinterpret_cast<void *>(addr), size);
+        });
+      }
+      break;
+    };
+#ifdef UNIFIED_WORKFLOW
+    case Action::TARGET_LOOP_INVOC:
+    case Action::TARGET_LOOP_ITER:
+    case Action::TARGET_LOOP_EXIT:
+    case Action::FUNC_ENTRY:
+    case Action::FUNC_EXIT:
+      depMod.set_control(control_stamp(dq));
+      break;
+#else
+    case Action::TARGET_LOOP_INVOC: {
+      if (CONSUME_DEBUG) {
+        std::cout << "LOOP_INVOC" << std::endl;
+      }
+
+      if (ACTION) {
+        depMod.loop_invoc();
+      }
+      break;
+    };
+    case Action::TARGET_LOOP_ITER: {
+      if (CONSUME_DEBUG) {
+        std::cout << "LOOP_ITER" << std::endl;
+      }
+      if (ACTION) {
+        depMod.loop_iter();
+      }
+      break;
+    };
+    case Action::TARGET_LOOP_EXIT: {
+      depMod.loop_exit();
+      break;
+    }
+    case Action::FUNC_ENTRY: {
+      uint32_t func_id;
+      dq.unpack_32(func_id);
+      depMod.func_entry(func_id);
+      break;
+    };
+    case Action::FUNC_EXIT: {
+      uint32_t func_id;
       dq.unpack_32(func_id);
       depMod.func_exit(func_id);
       break;
     };
+#endif
 #ifdef UNIFIED_WORKFLOW
     case Action::FREE:
     case Action::LOOP_ENTRY:
+    case Action::LOOP_EXIT:
     case Action::LOOP_ITER_CTX:
     case Action::POINTS_TO_INST:
     case Action::POINTS_TO_ARG:
@@ -1249,7 +1684,7 @@ void consume_loop(DoubleQueue &dq,
                 << std::endl;
 
       for (int i = 0; i < 101; i++) {
-        std::cout << dq.qNow->data[dq.index - 100 + i] << " ";
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
       }
       exit(-1);
     }
@@ -1314,8 +1749,7 @@ void consume_loop_dep_with_context(DoubleQueue &dq,
 
 #ifdef UNIFIED_WORKFLOW
       dq.unpack_32_64(instr, addr);
-      dq.check();
-      dq.consumePacket();
+      dq.skipPacket();
       // dq.unpack_64(value);
 #else
       dq.unpack_32_64(instr, addr);
@@ -1456,7 +1890,7 @@ void consume_loop_dep_with_context(DoubleQueue &dq,
                 << std::endl;
 
       for (int i = 0; i < 101; i++) {
-        std::cout << dq.qNow->data[dq.index - 100 + i] << " ";
+        std::cout << dq.qNow->data()[dq.index - 100 + i] << " ";
       }
       exit(-1);
     }
@@ -1494,13 +1928,142 @@ int main(int argc, char **argv) {
       cxxopts::value<int>()->default_value(std::to_string(DEFAULT_MODULE)))(
       "t,threads", "Number of threads to use",
       cxxopts::value<unsigned>()->default_value(
-          std::to_string(DEFAULT_THREAD_COUNT)));
+          std::to_string(DEFAULT_THREAD_COUNT)))(
+      "merge", "Merge the given deplogs, comma separated (e.g., epoch-parallel "
+               "slices), into deplog.txt instead of consuming a queue",
+      cxxopts::value<std::vector<std::string>>())(
+      "f,format",
+      "Output format of the dependence, points-to, loaded value, value pattern "
+      "and object lifetime modules: text or binary (prompt.prof)",
+      cxxopts::value<std::string>()->default_value("text"))(
+      "a,accumulate",
+      "Fold the result into the given binary profile (e.g., across inputs); "
+      "the profile is created if it does not exist",
+      cxxopts::value<std::string>())(
+      "spill-budget",
+      "Memory budget of the dependence module in MB; beyond it the "
+      "dependences are spilled to sorted runs and merged at the end (0: off)",
+      cxxopts::value<uint64_t>()->default_value("0"))(
+      "spill-dir", "Directory of the spilled runs",
+      cxxopts::value<std::string>()->default_value("."))(
+      "s,symbols",
+      "Symbol table of the program (-slamp-symbols of the pass); the text "
+      "profiles name the IDs with it. Default: $SLAMP_SYMBOLS or " +
+          std::string(slamp::SYMBOLS_DEFAULT_FILE) + " if it exists",
+      cxxopts::value<std::string>())(
+      "cpus",
+      "Pin the consumer threads to these cpus, in order (e.g., 0-7,16-23)",
+      cxxopts::value<std::string>())(
+      "numa-bind-shadow",
+      "Bind the shadow memory of each module to the NUMA node of its "
+      "thread's cpu (with --cpus)")(
+      "queue-node",
+      "Place the queue buffers on this NUMA node. Default: the node of "
+      "$SLAMP_PRODUCER_CPU, where the producer pins itself, if it is set",
+      cxxopts::value<int>())(
+      "shadow-granularity",
+      "Data bytes per shadow slot: 1, 4, 8 or 64. A coarser slot cuts the "
+      "shadow memory; the dependences stay exact while the accesses cover "
+      "whole slots (the dependence modules only)",
+      cxxopts::value<unsigned>()->default_value("1"))(
+      "rebalance",
+      "Move hot page groups from the busiest consumer thread to the idlest "
+      "at each buffer swap (the dependence modules only)");
 
   auto result = options.parse(argc, argv);
+  if (!result.unmatched().empty()) {
+    std::cout << "Unexpected argument: " << result.unmatched().front()
+              << std::endl;
+    exit(-1);
+  }
 
   const AvailableModules MODULE =
       static_cast<AvailableModules>(result["module"].as<int>());
   const unsigned THREAD_COUNT = result["threads"].as<unsigned>();
+  const uint64_t SPILL_BUDGET = result["spill-budget"].as<uint64_t>() << 20;
+  const auto SPILL_DIR = result["spill-dir"].as<std::string>();
+
+  const auto FORMAT = result["format"].as<std::string>();
+  if (FORMAT == "binary") {
+    profileWriter = new slamp::ProfileWriter();
+  } else if (FORMAT != "text") {
+    std::cout << "Unknown format: " << FORMAT << std::endl;
+    exit(-1);
+  }
+
+  if (result.count("accumulate")) {
+    binaryProfile = result["accumulate"].as<std::string>();
+    if (!profileWriter)
+      profileWriter = new slamp::ProfileWriter();
+
+    if (access(binaryProfile.c_str(), F_OK) == 0) {
+      previousProfile = new slamp::ProfileReader();
+      if (!previousProfile->open(binaryProfile.c_str()))
+        exit(-1);
+    }
+  }
+
+  if (result.count("symbols"))
+    slamp::symbolsPath() = result["symbols"].as<std::string>();
+
+  if (result.count("cpus")) {
+    consumerCpus = slamp::numa::parseCpuList(result["cpus"].as<std::string>());
+    if (consumerCpus.empty()) {
+      std::cout << "No cpu in --cpus" << std::endl;
+      exit(-1);
+    }
+  }
+  if (result.count("numa-bind-shadow")) {
+    if (consumerCpus.empty()) {
+      std::cout << "--numa-bind-shadow requires --cpus" << std::endl;
+      exit(-1);
+    }
+    numaBindShadow = true;
+  }
+
+  const int granularity =
+      slamp::granularity_shift(result["shadow-granularity"].as<unsigned>());
+  if (granularity < 0) {
+    std::cout << "--shadow-granularity must be 1, 4, 8 or 64" << std::endl;
+    exit(-1);
+  }
+  shadowGranularity = granularity;
+
+  // the other modules split the pages (or the instructions) with a mask
+  const bool ownedPages = MODULE == DEPENDENCE_MODULE ||
+                          MODULE == BATCH_DEPENDENCE_MODULE ||
+                          MODULE == DEPENDENCE_WITH_CONTEXT_MODULE ||
+                          MODULE == WHOLE_PROGRAM_DEPENDENCE_MODULE;
+  if (!ownedPages && (THREAD_COUNT & (THREAD_COUNT - 1))) {
+    std::cout << "The module needs a power-of-two thread count" << std::endl;
+    exit(-1);
+  }
+  if (result.count("rebalance")) {
+    if (!ownedPages) {
+      std::cout << "--rebalance only supports the dependence modules"
+                << std::endl;
+      exit(-1);
+    }
+    rebalancePages = true;
+  }
+
+  if (result.count("merge")) {
+    if (MODULE != DEPENDENCE_MODULE) {
+      std::cout << "--merge only supports the dependence module" << std::endl;
+      exit(-1);
+    }
+
+    DependenceModule merged(0, 0);
+    for (auto &log : result["merge"].as<std::vector<std::string>>()) {
+      DependenceModule slice(0, 0);
+      slice.load_log(log.c_str());
+      merged.merge_dep(slice);
+    }
+    write_profile(merged, "deplog.txt");
+    if (profileWriter)
+      profileWriter->write(binaryProfile.c_str());
+    return 0;
+  }
 
   char *env = getenv("SLAMP_QUEUE_ID");
   if (env == nullptr) {
@@ -1511,28 +2074,30 @@ int main(int argc, char **argv) {
   }
 
   // Create the queue in shared memory
-  auto queue_name = std::string("slamp_queue_") + env;
-
-  // FIXME: no need to have fixed address for custom queue any more
-  segment = new bip::fixed_managed_shared_memory(
-      bip::open_or_create, queue_name.c_str(), sizeof(uint32_t) * QSIZE * 4,
-      (void *)(1UL << 32));
-  // print the address of the shared memory segment
-  std::cout << "Shared memory segment address: " << segment->get_address()
-            << std::endl;
+  auto queue_name = QueueSegment::name(env);
+  auto *segment = QueueSegment::create(queue_name);
+  if (!segment)
+    exit(-1);
 
-  Queue_p dqA, dqB;
   // double buffering
-  dqA = segment->construct<Queue>("DQ_A")(Queue());
-  dqB = segment->construct<Queue>("DQ_B")(Queue());
-  auto dataA = segment->construct<uint32_t>("DQ_Data_A")[QSIZE]();
-  auto dataB = segment->construct<uint32_t>("DQ_Data_B")[QSIZE]();
-
-  // find the first 16byte alignment
-  dataA = (uint32_t *)(((uint64_t)dataA + 15) & ~15);
-  dataB = (uint32_t *)(((uint64_t)dataB + 15) & ~15);
-  dqA->init(dataA);
-  dqB->init(dataB);
+  Queue_p dqA = segment->queueA();
+  Queue_p dqB = segment->queueB();
+
+  // the producer writes the queue, the consumer threads only read it once
+  int queueNode = -1;
+  if (result.count("queue-node"))
+    queueNode = result["queue-node"].as<int>();
+  else if (auto *cpu = getenv("SLAMP_PRODUCER_CPU"))
+    queueNode = slamp::numa::nodeOfCpu(atoi(cpu));
+  if (queueNode >= 0) {
+    // the queue headers are touched already, their pages are moved
+    if (slamp::numa::bindMemory(segment, QueueSegment::BYTES, queueNode,
+                                true))
+      std::cout << "Queue on node " << queueNode << std::endl;
+    else
+      std::cout << "Cannot bind the queue to node " << queueNode << ": "
+                << strerror(errno) << std::endl;
+  }
 
   const unsigned MASK = THREAD_COUNT - 1;
 
@@ -1544,6 +2109,11 @@ int main(int argc, char **argv) {
   DoubleQueue *dqs[THREAD_COUNT];
 
 #ifdef UNIFIED_WORKFLOW
+  // the points-to and object lifetime modules need a shadow slot per byte
+  check_granularity<PointsToModule>();
+  // the module threads are fixed; the swaps already scan the control events
+  if (rebalancePages)
+    std::cout << "--rebalance is ignored in the unified workflow" << std::endl;
   constexpr unsigned THREADS_DEP = 4;
   constexpr unsigned THREADS_PT = 2; // 4;
   constexpr unsigned THREADS_LV = 4; // 4;
@@ -1567,6 +2137,9 @@ int main(int argc, char **argv) {
     dqs_unified[thread_idx++] =
         new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
     depMods[i] = new DependenceModule(MASK_DEP, i);
+    place_shadow(*depMods[i], thread_idx - 1);
+    if (SPILL_BUDGET)
+      depMods[i]->set_spill_budget(SPILL_BUDGET / THREADS_DEP, SPILL_DIR);
   }
 
   auto MASK_PT = THREADS_PT - 1;
@@ -1574,6 +2147,7 @@ int main(int argc, char **argv) {
     dqs_unified[thread_idx++] =
         new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
     ptMods[i] = new PointsToModule(MASK_PT, i);
+    place_shadow(*ptMods[i], thread_idx - 1);
   }
 
   auto MASK_LV = THREADS_LV - 1;
@@ -1588,12 +2162,18 @@ int main(int argc, char **argv) {
     dqs_unified[thread_idx++] =
         new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
     olMods[i] = new ObjectLifetimeModule(MASK_OL, i);
+    place_shadow(*olMods[i], thread_idx - 1);
+  }
+
+  for (unsigned i = 0; i < THREADS; i++) {
+    dqs_unified[i]->on_buffer = scan_control;
   }
 
   thread_idx = 0;
   for (unsigned i = 0; i < THREADS_DEP; i++) {
     threads.emplace_back(std::thread(
         [&](unsigned thread_id, unsigned id) {
+          pin_consumer(thread_id);
           consume_loop(*dqs_unified[thread_id], *depMods[id]);
         },
         thread_idx++, i));
@@ -1602,6 +2182,7 @@ int main(int argc, char **argv) {
   for (unsigned i = 0; i < THREADS_PT; i++) {
     threads.emplace_back(std::thread(
         [&](unsigned thread_id, unsigned id) {
+          pin_consumer(thread_id);
           consume_loop_pt(*dqs_unified[thread_id], *ptMods[id]);
         },
         thread_idx++, i));
@@ -1610,6 +2191,7 @@ int main(int argc, char **argv) {
   for (unsigned i = 0; i < THREADS_LV; i++) {
     threads.emplace_back(std::thread(
         [&](unsigned thread_id, unsigned id) {
+          pin_consumer(thread_id);
           consume_loop_lv(*dqs_unified[thread_id], *lvMods[id]);
         },
         thread_idx++, i));
@@ -1618,6 +2200,7 @@ int main(int argc, char **argv) {
   for (unsigned i = 0; i < THREADS_OL; i++) {
     threads.emplace_back(std::thread(
         [&](unsigned thread_id, unsigned id) {
+          pin_consumer(thread_id);
           consume_loop_ol(*dqs_unified[thread_id], *olMods[id]);
         },
         thread_idx++, i));
@@ -1627,6 +2210,14 @@ int main(int argc, char **argv) {
     t.join();
   }
 
+  // the contexts were encoded once, by the control timeline
+  for (unsigned i = 0; i < THREADS_PT; i++) {
+    ptMods[i]->adopt_contexts(controlTimeline.contexts);
+  }
+  for (unsigned i = 0; i < THREADS_OL; i++) {
+    olMods[i]->adopt_contexts(controlTimeline.fcnContexts);
+  }
+
   for (unsigned i = 0; i < THREADS_DEP; i++) {
     if (i != 0) {
       depMods[0]->merge_dep(*depMods[i]);
@@ -1634,7 +2225,7 @@ int main(int argc, char **argv) {
   }
 
   if (THREADS_DEP > 0) {
-    depMods[0]->fini("deplog.txt");
+    write_profile(*depMods[0], "deplog.txt");
   }
 
   for (unsigned i = 0; i < THREADS_PT; i++) {
@@ -1644,7 +2235,7 @@ int main(int argc, char **argv) {
   }
 
   if (THREADS_PT > 0) {
-    ptMods[0]->fini("ptlog.txt");
+    write_profile(*ptMods[0], "ptlog.txt");
   }
 
   for (unsigned i = 0; i < THREADS_LV; i++) {
@@ -1653,38 +2244,53 @@ int main(int argc, char **argv) {
     }
   }
   if (THREADS_LV > 0) {
-    lvMods[0]->fini("lvlog.txt");
+    write_profile(*lvMods[0], "lvlog.txt");
   }
 
+  for (unsigned i = 1; i < THREADS_OL; i++) {
+    olMods[0]->merge(*olMods[i]);
+  }
   if (THREADS_OL > 0) {
-    olMods[0]->fini("ollog.txt");
+    write_profile(*olMods[0], "ollog.txt");
   }
 
 #else
   if (MODULE == DEPENDENCE_MODULE) {
     DependenceModule *depMods[THREAD_COUNT];
+    check_granularity<DependenceModule>();
 
     for (unsigned i = 0; i < THREAD_COUNT; i++) {
       dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
-      depMods[i] = new DependenceModule(MASK, i);
+      depMods[i] = new DependenceModule(MASK, i, shadowGranularity);
+      place_shadow(*depMods[i], i);
+      if (SPILL_BUDGET)
+        depMods[i]->set_spill_budget(SPILL_BUDGET / THREAD_COUNT, SPILL_DIR);
     }
 
+    share_pages(depMods, dqs, THREAD_COUNT);
+
     if (THREAD_COUNT == 1) {
       std::cout << "Running in main thread" << std::endl;
       // single threaded, easy to debug
+      pin_consumer(0);
       consume_loop(*dqs[0], *depMods[0]);
 
-      depMods[0]->fini("deplog.txt");
+      write_profile(*depMods[0], "deplog.txt");
     } else {
       std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         threads.emplace_back(
-            [&](unsigned id) { consume_loop(*dqs[id], *depMods[id]); }, i);
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop(*dqs[id], *depMods[id]);
+            },
+            i);
       }
 
       for (auto &t : threads) {
         t.join();
       }
+      report_rebalance();
 
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         if (i != 0) {
@@ -1692,9 +2298,54 @@ int main(int argc, char **argv) {
         }
       }
 
-      depMods[0]->fini("deplog.txt");
+      write_profile(*depMods[0], "deplog.txt");
+    }
+
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      delete depMods[i];
+    }
+  }
+
+  if (MODULE == BATCH_DEPENDENCE_MODULE) {
+    BatchDependenceModule *depMods[THREAD_COUNT];
+    check_granularity<BatchDependenceModule>();
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
+      depMods[i] = new BatchDependenceModule(MASK, i, shadowGranularity);
+      place_shadow(*depMods[i], i);
+    }
+
+    share_pages(depMods, dqs, THREAD_COUNT);
+
+    if (THREAD_COUNT == 1) {
+      std::cout << "Running in main thread" << std::endl;
+      // single threaded, easy to debug
+      pin_consumer(0);
+      consume_loop_batch_dep(*dqs[0], *depMods[0]);
+    } else {
+      std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
+      for (unsigned i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back(
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop_batch_dep(*dqs[id], *depMods[id]);
+            },
+            i);
+      }
+
+      for (auto &t : threads) {
+        t.join();
+      }
+      report_rebalance();
+
+      for (unsigned i = 1; i < THREAD_COUNT; i++) {
+        depMods[0]->merge_dep(*depMods[i]);
+      }
     }
 
+    // all the loops in one deplog
+    write_profile(*depMods[0], "deplog.txt");
+
     for (unsigned i = 0; i < THREAD_COUNT; i++) {
       delete depMods[i];
     }
@@ -1702,15 +2353,20 @@ int main(int argc, char **argv) {
 
   if (MODULE == DEPENDENCE_WITH_CONTEXT_MODULE) {
     DependenceWithContextModule *depMods[THREAD_COUNT];
+    check_granularity<DependenceWithContextModule>();
 
     for (unsigned i = 0; i < THREAD_COUNT; i++) {
       dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
       depMods[i] = new DependenceWithContextModule(MASK, i);
+      place_shadow(*depMods[i], i);
     }
 
+    share_pages(depMods, dqs, THREAD_COUNT);
+
     if (THREAD_COUNT == 1) {
       std::cout << "Running in main thread" << std::endl;
       // single threaded, easy to debug
+      pin_consumer(0);
       consume_loop_dep_with_context(*dqs[0], *depMods[0]);
 
       depMods[0]->fini("deplog.txt");
@@ -1718,12 +2374,17 @@ int main(int argc, char **argv) {
       std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         threads.emplace_back(
-            [&](unsigned id) { consume_loop_dep_with_context(*dqs[id], *depMods[id]); }, i);
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop_dep_with_context(*dqs[id], *depMods[id]);
+            },
+            i);
       }
 
       for (auto &t : threads) {
         t.join();
       }
+      report_rebalance();
 
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         if (i != 0) {
@@ -1741,15 +2402,21 @@ int main(int argc, char **argv) {
 
   if (MODULE == WHOLE_PROGRAM_DEPENDENCE_MODULE) {
     WholeProgramDependenceModule *depMods[THREAD_COUNT];
+    check_granularity<WholeProgramDependenceModule>();
 
     for (unsigned i = 0; i < THREAD_COUNT; i++) {
       dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
-      depMods[i] = new WholeProgramDependenceModule(MASK, i);
+      depMods[i] =
+          new WholeProgramDependenceModule(MASK, i, shadowGranularity);
+      place_shadow(*depMods[i], i);
     }
 
+    share_pages(depMods, dqs, THREAD_COUNT);
+
     if (THREAD_COUNT == 1) {
       std::cout << "Running in main thread" << std::endl;
       // single threaded, easy to debug
+      pin_consumer(0);
       consume_loop_whole_program_dep(*dqs[0], *depMods[0]);
 
       depMods[0]->fini("deplog.txt");
@@ -1758,6 +2425,7 @@ int main(int argc, char **argv) {
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         threads.emplace_back(
             [&](unsigned id) {
+              pin_consumer(id);
               consume_loop_whole_program_dep(*dqs[id], *depMods[id]);
             },
             i);
@@ -1766,6 +2434,7 @@ int main(int argc, char **argv) {
       for (auto &t : threads) {
         t.join();
       }
+      report_rebalance();
 
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         if (i != 0) {
@@ -1783,27 +2452,34 @@ int main(int argc, char **argv) {
 
   if (MODULE == POINTS_TO_MODULE) {
     PointsToModule *ptMods[THREAD_COUNT];
+    check_granularity<PointsToModule>();
 
     for (unsigned i = 0; i < THREAD_COUNT; i++) {
       dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
       // ptMods[i] = new PointsToModule(MASK, i);
       ptMods[i] = new PointsToModule(MASK, i);
+      place_shadow(*ptMods[i], i);
     }
 
     if (THREAD_COUNT == 1) {
 
       std::cout << "Running in main thread" << std::endl;
       // single threaded, easy to debug
+      pin_consumer(0);
       consume_loop_pt(*dqs[0], *ptMods[0]);
 
       // FIXME: hack!
       ptMods[0]->decode_all();
-      ptMods[0]->fini("ptlog.txt");
+      write_profile(*ptMods[0], "ptlog.txt");
     } else {
       std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         threads.emplace_back(
-            [&](unsigned id) { consume_loop_pt(*dqs[id], *ptMods[id]); }, i);
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop_pt(*dqs[id], *ptMods[id]);
+            },
+            i);
       }
 
       for (auto &t : threads) {
@@ -1818,7 +2494,7 @@ int main(int argc, char **argv) {
         }
       }
 
-      ptMods[0]->fini("ptlog.txt");
+      write_profile(*ptMods[0], "ptlog.txt");
     }
 
     for (unsigned i = 0; i < THREAD_COUNT; i++) {
@@ -1827,11 +2503,45 @@ int main(int argc, char **argv) {
   }
 
   if (MODULE == OBJECT_LIFETIME_MODULE) {
-    assert(running_threads == 1 && "Object lifetime only supports 1 thread");
-    DoubleQueue dq(dqA, dqB, true, running_threads, m, cv);
+    ObjectLifetimeModule *olMods[THREAD_COUNT];
+    check_granularity<ObjectLifetimeModule>();
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
+      olMods[i] = new ObjectLifetimeModule(MASK, i);
+      place_shadow(*olMods[i], i);
+    }
 
-    ObjectLifetimeModule olMod(0, 0);
-    consume_loop_ol(dq, olMod);
+    if (THREAD_COUNT == 1) {
+      std::cout << "Running in main thread" << std::endl;
+      pin_consumer(0);
+      consume_loop_ol(*dqs[0], *olMods[0]);
+    } else {
+      std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
+      for (unsigned i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back(
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop_ol(*dqs[id], *olMods[id]);
+            },
+            i);
+      }
+
+      for (auto &t : threads) {
+        t.join();
+      }
+
+      for (unsigned i = 1; i < THREAD_COUNT; i++) {
+        olMods[0]->merge(*olMods[i]);
+      }
+    }
+
+    if (ACTION) {
+      write_profile(*olMods[0], "ollog.txt");
+    }
+
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      delete olMods[i];
+    }
   }
 
   if (MODULE == LOADED_VALUE_MODULE) {
@@ -1844,14 +2554,19 @@ int main(int argc, char **argv) {
     if (THREAD_COUNT == 1) {
       std::cout << "Running in main thread" << std::endl;
       // single threaded, easy to debug
+      pin_consumer(0);
       consume_loop_lv(*dqs[0], *lvMods[0]);
 
-      lvMods[0]->fini("lvlog.txt");
+      write_profile(*lvMods[0], "lvlog.txt");
     } else {
       std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
       for (unsigned i = 0; i < THREAD_COUNT; i++) {
         threads.emplace_back(
-            [&](unsigned id) { consume_loop_lv(*dqs[id], *lvMods[id]); }, i);
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop_lv(*dqs[id], *lvMods[id]);
+            },
+            i);
       }
 
       for (auto &t : threads) {
@@ -1864,7 +2579,7 @@ int main(int argc, char **argv) {
         }
       }
 
-      lvMods[0]->fini("lvlog.txt");
+      write_profile(*lvMods[0], "lvlog.txt");
     }
 
     for (unsigned i = 0; i < THREAD_COUNT; i++) {
@@ -1872,15 +2587,92 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (MODULE == VALUE_PATTERN_MODULE) {
+    ValuePatternModule *vpMods[THREAD_COUNT];
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
+      vpMods[i] = new ValuePatternModule(MASK, i);
+    }
+
+    if (THREAD_COUNT == 1) {
+      std::cout << "Running in main thread" << std::endl;
+      // single threaded, easy to debug
+      pin_consumer(0);
+      consume_loop_vp(*dqs[0], *vpMods[0]);
+    } else {
+      std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
+      for (unsigned i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back(
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop_vp(*dqs[id], *vpMods[id]);
+            },
+            i);
+      }
+
+      for (auto &t : threads) {
+        t.join();
+      }
+
+      for (unsigned i = 1; i < THREAD_COUNT; i++) {
+        vpMods[0]->merge_patterns(*vpMods[i]);
+      }
+    }
+
+    write_profile(*vpMods[0], "vplog.txt");
+
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      delete vpMods[i];
+    }
+  }
+
   if (MODULE == PRIVATEER_PROFILER) {
-    assert(running_threads == 1 && "Privateer profiler only supports 1 thread");
-    DoubleQueue dq(dqA, dqB, true, running_threads, m, cv);
+    PrivateerProfiler *privateerMods[THREAD_COUNT];
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      dqs[i] = new DoubleQueue(dqA, dqB, true, running_threads, m, cv);
+      privateerMods[i] = new PrivateerProfiler(MASK, i);
+    }
+
+    if (THREAD_COUNT == 1) {
+      std::cout << "Running in main thread" << std::endl;
+      pin_consumer(0);
+      consume_loop_privateer(*dqs[0], *privateerMods[0]);
+    } else {
+      std::cout << "Running in " << THREAD_COUNT << " threads" << std::endl;
+      for (unsigned i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back(
+            [&](unsigned id) {
+              pin_consumer(id);
+              consume_loop_privateer(*dqs[id], *privateerMods[id]);
+            },
+            i);
+      }
+
+      for (auto &t : threads) {
+        t.join();
+      }
+
+      for (unsigned i = 1; i < THREAD_COUNT; i++) {
+        privateerMods[0]->merge(*privateerMods[i]);
+      }
+    }
 
-    PrivateerProfiler privateerMod(0, 0);
-    consume_loop_privateer(dq, privateerMod);
+    if (ACTION) {
+      privateerMods[0]->fini("privateer.txt");
+    }
+
+    for (unsigned i = 0; i < THREAD_COUNT; i++) {
+      delete privateerMods[i];
+    }
   }
 #endif
 
+  if (profileWriter) {
+    profileWriter->write(binaryProfile.c_str());
+    delete profileWriter;
+  }
+  delete previousProfile;
+
   // remove the shared memory file
-  bip::shared_memory_object::remove(queue_name.c_str());
+  QueueSegment::remove(queue_name);
 }
@@ -57,13 +57,21 @@ struct UnderlyingQueue {
   PAD(2, sizeof(bool));
   uint64_t size;
   PAD(3, sizeof(uint64_t));
-  uint32_t *data;
+  // of the buffer from the queue itself; the producer and the consumer map
+  // the queue at different addresses
+  int64_t data_offset;
 
   void init(uint32_t *data) {
     this->ready_to_read = false;
     this->ready_to_write = true;
     this->size = 0;
-    this->data = data;
+    this->data_offset =
+        reinterpret_cast<char *>(data) - reinterpret_cast<char *>(this);
+  }
+
+  uint32_t *data() {
+    return reinterpret_cast<uint32_t *>(reinterpret_cast<char *>(this) +
+                                        data_offset);
   }
 };
 
@@ -75,6 +83,11 @@ struct DoubleQueue {
   uint64_t index = 0;
   uint64_t size = 0;
   uint32_t *data;
+  // called on each new buffer by the thread handing it out, before the
+  // others are released (e.g., to build the control timeline)
+  void (*on_buffer)(const uint32_t *data, uint64_t size) = nullptr;
+  // position of the thread in the per-buffer state of `on_buffer`
+  uint64_t cursor = 0;
 
   std::mutex &m;
   std::condition_variable &cv;
@@ -101,7 +114,7 @@ struct DoubleQueue {
       this->qOther = dqB;
     }
 
-    this->data = qNow->data;
+    this->data = qNow->data();
   }
 
   void swap() {
@@ -112,7 +125,7 @@ struct DoubleQueue {
       qNow = qA;
       qOther = qB;
     }
-    data = qNow->data;
+    data = qNow->data();
   }
 
   void check() __attribute__((always_inline)) {
@@ -130,6 +143,8 @@ struct DoubleQueue {
           usleep(10);
         }
         qOther->ready_to_write = false;
+        if (on_buffer)
+          on_buffer(qOther->data(), qOther->size);
         // std::cerr << "Thread " << std::this_thread::get_id() << " ready for
         // queue" << std::endl;
         running_threads = ALL_THREADS;
@@ -154,6 +169,7 @@ struct DoubleQueue {
       }
       swap();
       index = 0;
+      cursor = 0;
       size = qNow->size;
       // // make sure all pending writes are visible
       // _mm_mfence();
@@ -185,6 +201,13 @@ struct DoubleQueue {
     // return packet[0];
   }
 
+  // skip the second packet of a two-packet event; the producer never splits
+  // one across buffers
+  void skipPacket() { index += 4; }
+
+  // index of the last consumed packet
+  uint64_t packetIndex() const { return index - 4; }
+
   void unpack_32(uint32_t &a) { a = _mm_extract_epi32(packet, 1); }
 
   void unpack_64(uint64_t &c) { c = _mm_extract_epi64(packet, 1); }
@@ -239,7 +262,7 @@ struct DoubleQueue_Producer {
     this->qNow = dqA;
     this->qOther = dqB;
 
-    this->data = qNow->data;
+    this->data = qNow->data();
   }
 
   void swap() {
@@ -250,7 +273,7 @@ struct DoubleQueue_Producer {
       qNow = qA;
       qOther = qB;
     }
-    data = qNow->data;
+    data = qNow->data();
   }
 
   void flush() {
@@ -330,6 +353,7 @@ struct DoubleQueue_Producer {
     data[index] = xy;
     data[index + 1] = z;
     *((uint64_t *)&data[index + 2]) = w;
+    *((uint64_t *)&data[index + 4]) = v;
 #endif
     index += 8;
 
@@ -447,7 +471,7 @@ void init(Queue_p dqA, Queue_p dqB) {
   qNow = dqA;
   qOther = dqB;
 
-  dq_data = qNow->data;
+  dq_data = qNow->data();
 }
 
 void swap() {
@@ -458,7 +482,7 @@ void swap() {
     qNow = qA;
     qOther = qB;
   }
-  dq_data = qNow->data;
+  dq_data = qNow->data();
 }
 
 void flush() {
@@ -544,6 +568,7 @@ void produce_8_24_32_64_64(uint8_t x, uint32_t y, uint32_t z, uint64_t w,
   dq_data[dq_index] = xy;
   dq_data[dq_index + 1] = z;
   *((uint64_t *)&dq_data[dq_index + 2]) = w;
+  *((uint64_t *)&dq_data[dq_index + 4]) = v;
 #endif
   dq_index += 8;
 
@@ -0,0 +1,125 @@
+/** ***********************************************/
+/** *** Shared memory segment of the SW Queue *****/
+/** ***********************************************/
+#pragma once
+
+// The two queues of the double buffering and their buffers, in one POSIX
+// shared memory object (/dev/shm/slamp_queue_$SLAMP_QUEUE_ID). The queues
+// address their buffers by offset, so each process maps the segment wherever
+// the kernel puts it.
+//
+// Either side may come first: both create the object if it does not exist
+// yet, the consumer initializes the queues and then publishes `ready`, and
+// the producer sleeps on `ready` as a futex until then. The object is never
+// replaced, so a stale one must not be left under the same name; the driver
+// picks an unused id and the consumer removes the object when it is done.
+//
+// The buffers start on huge page boundaries and are advised to use
+// transparent huge pages (effective with shmem_enabled=advise or always).
+// With $SLAMP_QUEUE_HUGETLBFS set to a hugetlbfs mount, the segment is a
+// file there instead, backed by the reserved huge pages.
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "sw_queue_astream.h"
+
+struct QueueSegment {
+  static constexpr uint64_t HUGE_PAGE = 1 << 21;
+  static constexpr uint64_t BUFFER_BYTES =
+      (QSIZE * sizeof(QTYPE) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+  // the header takes the first huge page
+  static constexpr uint64_t BYTES = HUGE_PAGE + 2 * BUFFER_BYTES;
+
+  // set last by the consumer, the queues are initialized then; a futex
+  volatile uint32_t ready;
+  PAD(1, sizeof(uint32_t));
+  Queue queues[2];
+
+  Queue_p queueA() { return &queues[0]; }
+  Queue_p queueB() { return &queues[1]; }
+
+  static std::string name(const char *queue_id) {
+    return std::string("slamp_queue_") + queue_id;
+  }
+
+  /// consumer: initialize the segment and wake up the producer
+  static QueueSegment *create(const std::string &name) {
+    auto *segment = open_and_map(name);
+    if (!segment)
+      return nullptr;
+
+    // the object is zero-filled, the buffers are only touched by the queue
+    auto *base = reinterpret_cast<char *>(segment);
+    segment->queues[0].init(reinterpret_cast<uint32_t *>(base + HUGE_PAGE));
+    segment->queues[1].init(
+        reinterpret_cast<uint32_t *>(base + HUGE_PAGE + BUFFER_BYTES));
+    __atomic_store_n(&segment->ready, 1, __ATOMIC_RELEASE);
+    futex(&segment->ready, FUTEX_WAKE, INT_MAX);
+    return segment;
+  }
+
+  /// producer: sleeps until the consumer has initialized the segment
+  static QueueSegment *attach(const std::string &name) {
+    auto *segment = open_and_map(name);
+    if (!segment)
+      return nullptr;
+
+    // the wait returns right away if `ready` is not 0 anymore
+    while (__atomic_load_n(&segment->ready, __ATOMIC_ACQUIRE) == 0)
+      futex(&segment->ready, FUTEX_WAIT, 0);
+    return segment;
+  }
+
+  static void remove(const std::string &name) {
+    if (auto *dir = getenv("SLAMP_QUEUE_HUGETLBFS"))
+      unlink((std::string(dir) + "/" + name).c_str());
+    else
+      shm_unlink(("/" + name).c_str());
+  }
+
+private:
+  static int open(const std::string &name, int flags) {
+    if (auto *dir = getenv("SLAMP_QUEUE_HUGETLBFS"))
+      return ::open((std::string(dir) + "/" + name).c_str(), flags, 0600);
+    return shm_open(("/" + name).c_str(), flags, 0600);
+  }
+
+  /// create the object, or open the one of the other side
+  static QueueSegment *open_and_map(const std::string &name) {
+    int fd = open(name, O_CREAT | O_RDWR);
+    // both sides truncate to the same size, the second one is a no-op
+    if (fd < 0 || ftruncate(fd, BYTES) != 0) {
+      perror(name.c_str());
+      if (fd >= 0)
+        close(fd);
+      return nullptr;
+    }
+    return map(fd, name);
+  }
+
+  static QueueSegment *map(int fd, const std::string &name) {
+    void *p = mmap(nullptr, BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      perror(name.c_str());
+      return nullptr;
+    }
+    madvise(p, BYTES, MADV_HUGEPAGE);
+    return static_cast<QueueSegment *>(p);
+  }
+
+  // shared between processes, not FUTEX_PRIVATE_FLAG
+  static long futex(volatile uint32_t *word, int op, uint32_t value) {
+    return syscall(SYS_futex, word, op, value, nullptr, nullptr, 0);
+  }
+};
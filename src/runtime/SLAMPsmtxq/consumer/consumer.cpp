@@ -123,7 +123,8 @@ int main() {
                   << " " << value << std::endl;
       }
 #if ACTION
-      depMod.load(instr, addr, instr);
+      // the queue does not carry the size, the first byte stands for it
+      depMod.load(instr, addr, instr, 1);
       // DepMod::load(instr, addr, bare_instr, value);
 #endif
 
@@ -139,7 +140,7 @@ int main() {
                   << std::endl;
       }
 #if ACTION
-      depMod.store(instr, bare_instr, addr);
+      depMod.store(instr, bare_instr, addr, 1);
 #endif
       break;
     };
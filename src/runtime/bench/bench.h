@@ -0,0 +1,134 @@
+// A small harness shared by the runtime benchmarks: every case runs
+// `--repeats` times (after an untimed setup), the median is reported in ns
+// per operation, and all cases of a run can be written as JSON to be compared
+// across commits.
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cxxopts.hpp"
+
+namespace bench {
+
+// keep a value alive, so the computation of it is not optimized away
+template <typename T> inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+  std::string name;
+  std::string detail;     // e.g., the events sharing a packet layout
+  uint64_t ops;           // per repeat
+  uint64_t bytes_per_op;  // 0 if it is not a throughput case
+  std::vector<double> ns; // per repeat, sorted
+
+  double median() const { return ns[ns.size() / 2]; }
+};
+
+class Suite {
+  std::string name;
+  unsigned repeats;
+  uint64_t seed;
+  std::string filter, json;
+  std::vector<Result> results;
+
+public:
+  // the common options, add them before parsing
+  static void add_options(cxxopts::Options &options) {
+    options.add_options("bench")(
+        "r,repeats", "Repeats of each case (the median is reported)",
+        cxxopts::value<unsigned>()->default_value("5"))(
+        "s,seed", "Seed of the generated inputs",
+        cxxopts::value<uint64_t>()->default_value("42"))(
+        "j,json", "Write the results as JSON to the file",
+        cxxopts::value<std::string>()->default_value(""))(
+        "f,filter", "Only run the cases whose name contains this",
+        cxxopts::value<std::string>()->default_value(""));
+  }
+
+  Suite(std::string name, const cxxopts::ParseResult &result)
+      : name(std::move(name)), repeats(result["repeats"].as<unsigned>()),
+        seed(result["seed"].as<uint64_t>()),
+        filter(result["filter"].as<std::string>()),
+        json(result["json"].as<std::string>()) {
+    if (repeats == 0)
+      repeats = 1;
+  }
+
+  ~Suite() { write_json(); }
+
+  uint64_t get_seed() const { return seed; }
+
+  bool enabled(const std::string &caseName) const {
+    return filter.empty() || caseName.find(filter) != std::string::npos;
+  }
+
+  // time `f` over `ops` operations, `setup` and `teardown` run around each
+  // repeat and are not timed
+  template <typename Setup, typename F, typename Teardown>
+  void run(const std::string &caseName, uint64_t ops, Setup setup, F f,
+           Teardown teardown, uint64_t bytes_per_op = 0,
+           const std::string &detail = "") {
+    if (!enabled(caseName))
+      return;
+
+    Result r{caseName, detail, ops, bytes_per_op, {}};
+    for (unsigned i = 0; i < repeats; i++) {
+      setup();
+      auto start = std::chrono::steady_clock::now();
+      f();
+      auto end = std::chrono::steady_clock::now();
+      teardown();
+      r.ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    std::sort(r.ns.begin(), r.ns.end());
+
+    std::cout << std::left << std::setw(40) << caseName << std::right
+              << std::fixed << std::setprecision(2) << std::setw(12)
+              << r.median() / ops << " ns/op";
+    if (bytes_per_op)
+      std::cout << std::setw(12) << bytes_per_op * ops / r.median() * 1e3
+                << " MB/s";
+    if (!detail.empty())
+      std::cout << "  (" << detail << ")";
+    std::cout << std::endl;
+
+    results.push_back(std::move(r));
+  }
+
+  template <typename F> void run(const std::string &caseName, uint64_t ops, F f) {
+    run(caseName, ops, [] {}, f, [] {});
+  }
+
+  void write_json() const {
+    if (json.empty())
+      return;
+
+    std::ofstream os(json);
+
+    os << "{\n  \"suite\": \"" << name << "\",\n  \"seed\": " << seed
+       << ",\n  \"repeats\": " << repeats << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+      auto &r = results[i];
+      os << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\"";
+      if (!r.detail.empty())
+        os << ", \"detail\": \"" << r.detail << "\"";
+      os << ", \"ops\": " << r.ops << std::setprecision(3) << std::fixed
+         << ", \"ns_per_op\": " << r.median() / r.ops
+         << ", \"min_ns_per_op\": " << r.ns.front() / r.ops
+         << ", \"max_ns_per_op\": " << r.ns.back() / r.ops;
+      if (r.bytes_per_op)
+        os << ", \"mb_per_s\": " << r.bytes_per_op * r.ops / r.median() * 1e3;
+      os << "}";
+    }
+    os << "\n  ]\n}\n";
+  }
+};
+
+} // namespace bench
@@ -0,0 +1,106 @@
+// The SLAMPboost queue (a boost::lockfree::spsc_queue of bytes behind the
+// LocalBuffer of BoostSend.cpp): the cost of a push on the profiled side, and
+// the end-to-end throughput with a consumer popping every byte.
+#include <boost/lockfree/spsc_queue.hpp>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "bench.h"
+
+using ring_buffer =
+    boost::lockfree::spsc_queue<char, boost::lockfree::capacity<4194304>>;
+
+#define LOCAL_BUFFER_SIZE 2097152
+
+// as in BoostSend.cpp
+struct LocalBuffer {
+  char buffer[LOCAL_BUFFER_SIZE];
+  ring_buffer *queue;
+  unsigned counter = 0;
+
+  LocalBuffer(ring_buffer *queue) : queue(queue) {}
+
+  template <typename T> LocalBuffer *push(T value) {
+    size_t size = sizeof(T);
+    if (counter + size > LOCAL_BUFFER_SIZE) {
+      flush();
+    }
+    for (unsigned i = 0; i < size; i++) {
+      // lsb first
+      buffer[counter++] = (value >> (i << 3)) & 0xFF;
+    }
+    return this;
+  }
+
+  void flush() {
+    unsigned long pushed = 0;
+    while (pushed < counter) {
+      pushed += queue->push(buffer + pushed, counter - pushed);
+    }
+    counter = 0;
+  }
+};
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("boost_queue_bench", "SLAMPboost producer and queue");
+  options.add_options()("n,events", "Events per case",
+                        cxxopts::value<uint64_t>()->default_value("50000000"));
+  bench::Suite::add_options(options);
+  auto result = options.parse(argc, argv);
+  const auto N = result["events"].as<uint64_t>();
+  bench::Suite suite("boost_queue_bench", result);
+
+  auto queue = std::make_unique<ring_buffer>();
+  auto local = std::make_unique<LocalBuffer>(queue.get());
+  std::thread consumer;
+  uint64_t consumed = 0;
+
+  // a LOAD as BoostSend.cpp sends it: action, instr, addr, bare_instr
+  const uint64_t EVENT_BYTES = sizeof(char) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+  auto setup = [&]() {
+    consumer = std::thread([&]() {
+      auto buffer = std::make_unique<char[]>(LOCAL_BUFFER_SIZE);
+      uint64_t sum = 0, left = N * EVENT_BYTES;
+      while (left) {
+        size_t n = queue->pop(buffer.get(), LOCAL_BUFFER_SIZE);
+        for (size_t i = 0; i < n; i++)
+          sum += buffer[i];
+        left -= n;
+      }
+      consumed = sum;
+    });
+  };
+  auto finish = [&]() {
+    local->flush();
+    consumer.join();
+    bench::keep(consumed);
+  };
+
+  const uint64_t base = 0x7f0000000000;
+  const uint64_t mask = (1 << 24) - 1;
+  auto produce = [&](uint64_t i) {
+    local->push((char)(i & 0x7))
+        ->push((uint32_t)i)
+        ->push(base + ((i << 3) & mask))
+        ->push((uint32_t)i);
+  };
+
+  suite.run(
+      "push", N, setup,
+      [&]() {
+        for (uint64_t i = 0; i < N; i++)
+          produce(i);
+      },
+      finish, 0, "LOAD: action, instr, addr, bare_instr");
+
+  suite.run(
+      "throughput", N, setup,
+      [&]() {
+        for (uint64_t i = 0; i < N; i++)
+          produce(i);
+        finish();
+      },
+      [] {}, EVENT_BYTES, "push to the consumer");
+  return 0;
+}
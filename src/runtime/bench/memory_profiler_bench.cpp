@@ -0,0 +1,110 @@
+// Compare the whole-program dependence profile (MemoryProfiler) against the
+// previous structure: a KeyDistanceProfiler (vector of vectors of std::map)
+// plus an unordered_set of the dependences seen in each loop iteration.
+//
+// The dependences are drawn from `--seed`, a new epoch (loop iteration)
+// starts every `--epoch` dependences.
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "MemoryProfile.h"
+#include "Profile.h"
+#include "bench.h"
+
+using namespace Profiling;
+
+constexpr int MAX_DIST = 2;
+
+struct Event {
+  Dependence dep;
+  uint64_t epoch;
+};
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("memory_profiler_bench",
+                           "Flat vs. map-based whole-program dependences");
+  options.add_options()(
+      "n,events", "Number of dependences",
+      cxxopts::value<uint64_t>()->default_value("10000000"))(
+      "i,instrs", "Number of instructions",
+      cxxopts::value<uint32_t>()->default_value("100000"))(
+      "k,keys", "Number of distinct dependences",
+      cxxopts::value<uint32_t>()->default_value("65536"))(
+      "l,loops", "Number of loops",
+      cxxopts::value<uint32_t>()->default_value("256"))(
+      "e,epoch", "Dependences per loop iteration",
+      cxxopts::value<uint32_t>()->default_value("100"));
+  bench::Suite::add_options(options);
+  auto result = options.parse(argc, argv);
+  bench::Suite suite("memory_profiler_bench", result);
+
+  const auto N = result["events"].as<uint64_t>();
+  const auto INSTRS = result["instrs"].as<uint32_t>();
+  const auto KEYS = result["keys"].as<uint32_t>();
+  const auto LOOPS = result["loops"].as<uint32_t>();
+  const auto EPOCH = result["epoch"].as<uint32_t>();
+
+  std::mt19937_64 rng(suite.get_seed());
+  std::vector<Dependence> keys;
+  keys.reserve(KEYS);
+  for (uint32_t i = 0; i < KEYS; i++)
+    keys.emplace_back(rng() % INSTRS, rng() % LOOPS, rng() % MAX_DIST,
+                      rng() % INSTRS);
+
+  // skewed, a few hot dependences dominate as in real programs
+  std::geometric_distribution<uint32_t> pick(8.0 / KEYS);
+  std::vector<Event> events;
+  events.reserve(N);
+  for (uint64_t i = 0; i < N; i++)
+    events.push_back({keys[pick(rng) % KEYS], i / EPOCH + 1});
+
+  using OldProfiler = KeyDistanceProfiler<MemoryProfile, MAX_DIST>;
+  std::unique_ptr<OldProfiler> old_profiler;
+  suite.run(
+      "map + unordered_set", N,
+      [&]() { old_profiler = std::make_unique<OldProfiler>(INSTRS); },
+      [&]() {
+        std::vector<DependenceSet> sets(MAX_DIST);
+        uint64_t epoch = 0;
+        for (auto &e : events) {
+          if (e.epoch != epoch) {
+            for (auto &set : sets)
+              set.clear();
+            epoch = e.epoch;
+          }
+          MemoryProfile &profile = old_profiler->getProfile(e.dep);
+          profile.increment();
+          if (sets[e.dep.dist].insert(e.dep).second)
+            profile.incrementLoop();
+        }
+      },
+      [] {});
+
+  std::unique_ptr<MemoryProfiler<MAX_DIST>> flat_profiler;
+  suite.run(
+      "flat + epoch", N,
+      [&]() { flat_profiler = std::make_unique<MemoryProfiler<MAX_DIST>>(INSTRS); },
+      [&]() {
+        for (auto &e : events)
+          flat_profiler->increment(e.dep, e.epoch);
+      },
+      [] {});
+
+  // both have to agree
+  if (!old_profiler || !flat_profiler)
+    return 0;
+  for (auto &dep : keys) {
+    auto &a = old_profiler->getProfile(dep);
+    auto &b = flat_profiler->getProfile(dep);
+    if (a.getCount() != b.getCount() || a.getLoopCount() != b.getLoopCount()) {
+      std::cerr << "Mismatch at load " << dep.load << " store " << dep.store
+                << std::endl;
+      return -1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,399 @@
+// The consumer side: the per-event cost of each profiling module (one thread,
+// no queue), and the structures under them, the shadow memory allocation,
+// the HTSet/HTMap_* containers and the context encoding.  The privateer
+// profiler is driven by a recursive call tree, where its contexts are deep.
+//
+// The events are drawn from a fixed seed over a real heap buffer, so the
+// shadow addresses are the ones a profiled program would hit.
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ContextManager.h"
+#include "DependenceModule.h"
+#include "HTContainer.h"
+#include "LoadedValueModule.h"
+#include "ObjectLifetimeModule.h"
+#include "PointsToModule.h"
+#include "PrivateerProfiler.h"
+#include "ValuePatternModule.h"
+#include "bench.h"
+#include "privateer/trailing_assert.h"
+
+struct Access {
+  uint32_t instr;
+  uint64_t addr;
+  bool store;
+};
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("module_bench", "Profiling modules and containers");
+  options.add_options()(
+      "n,events", "Events per case",
+      cxxopts::value<uint64_t>()->default_value("10000000"))(
+      "i,instrs", "Number of static instructions",
+      cxxopts::value<uint32_t>()->default_value("10000"))(
+      "w,working-set", "Bytes touched by the accesses",
+      cxxopts::value<uint64_t>()->default_value("67108864"))(
+      "e,epoch", "Events per loop iteration",
+      cxxopts::value<uint32_t>()->default_value("1000"));
+  bench::Suite::add_options(options);
+  auto result = options.parse(argc, argv);
+  const auto N = result["events"].as<uint64_t>();
+  const auto INSTRS = result["instrs"].as<uint32_t>();
+  const auto WSET = result["working-set"].as<uint64_t>();
+  const auto EPOCH = result["epoch"].as<uint32_t>();
+  bench::Suite suite("module_bench", result);
+  __prof_capture_leading_thread_pid();
+
+  std::mt19937_64 rng(suite.get_seed());
+  const uint32_t pid = getpid();
+  const uint32_t loop_id = 1;
+
+  // the working set, 8-byte accesses, a third of them stores
+  auto *heap = static_cast<char *>(aligned_alloc(4096, WSET));
+  std::vector<Access> accesses;
+  accesses.reserve(N);
+  for (uint64_t i = 0; i < N; i++)
+    accesses.push_back({(uint32_t)(rng() % INSTRS) + 1,
+                        (uint64_t)heap + (rng() % (WSET / 8)) * 8,
+                        rng() % 3 == 0});
+
+  // objects of the allocation events, allocated and freed in turns
+  const uint32_t OBJECTS = 4096;
+  std::vector<std::pair<void *, uint64_t>> objects;
+  for (uint32_t i = 0; i < OBJECTS; i++) {
+    uint64_t size = 8 + rng() % 4096;
+    objects.emplace_back(malloc(size), size);
+  }
+
+  // only one module at a time, those with the same shadow mask would share
+  // the shadow memory
+  {
+    std::unique_ptr<DependenceModule> dep;
+    suite.run(
+        "DependenceModule::load/store", N,
+        [&]() {
+          dep = std::make_unique<DependenceModule>(0, 0);
+          dep->init(loop_id, pid);
+          dep->allocate(heap, WSET);
+          dep->loop_invoc();
+        },
+        [&]() {
+          for (uint64_t i = 0; i < N; i++) {
+            auto &a = accesses[i];
+            if (a.store)
+              dep->store(a.instr, a.instr, a.addr, 8);
+            else
+              dep->load(a.instr, a.addr, a.instr, 8);
+            if (i % EPOCH == EPOCH - 1)
+              dep->loop_iter();
+          }
+        },
+        [&]() { dep.reset(); });
+  }
+
+  {
+    std::unique_ptr<LoadedValueModule> lv;
+    suite.run(
+        "LoadedValueModule::load", N,
+        [&]() {
+          lv = std::make_unique<LoadedValueModule>(0, 0);
+          lv->init(loop_id, pid);
+        },
+        [&]() {
+          for (uint64_t i = 0; i < N; i++) {
+            auto &a = accesses[i];
+            // a quarter of the instructions load a constant
+            uint64_t value = a.instr % 4 ? a.addr : a.instr;
+            lv->load(a.instr, a.addr, a.instr, value, 8);
+          }
+        },
+        [&]() { lv.reset(); });
+  }
+
+  {
+    std::unique_ptr<ValuePatternModule> vp;
+    suite.run(
+        "ValuePatternModule::load", N,
+        [&]() {
+          vp = std::make_unique<ValuePatternModule>(0, 0);
+          vp->init(loop_id, pid);
+          vp->loop_invoc();
+        },
+        [&]() {
+          for (uint64_t i = 0; i < N; i++) {
+            auto &a = accesses[i];
+            // a new iteration every 16 loads, a quarter of the instructions
+            // load the iteration
+            if (i % 16 == 0)
+              vp->loop_iter();
+            uint64_t value = a.instr % 4 ? a.addr : i / 16;
+            vp->load(a.instr, a.addr, value);
+          }
+        },
+        [&]() { vp.reset(); });
+  }
+
+  {
+    std::unique_ptr<PointsToModule> pt;
+    suite.run(
+        "PointsToModule::points_to_inst", N,
+        [&]() {
+          pt = std::make_unique<PointsToModule>(0, 0);
+          pt->init(loop_id, pid);
+          pt->loop_invoc();
+          for (uint32_t i = 0; i < OBJECTS; i++)
+            pt->allocate(objects[i].first, i % 64 + 1, objects[i].second);
+        },
+        [&]() {
+          for (uint64_t i = 0; i < N; i++) {
+            auto &a = accesses[i];
+            pt->points_to_inst(a.instr, objects[a.addr % OBJECTS].first);
+            if (i % EPOCH == EPOCH - 1)
+              pt->loop_iter();
+          }
+        },
+        [&]() { pt.reset(); });
+  }
+
+  {
+    std::unique_ptr<ObjectLifetimeModule> ol;
+    suite.run(
+        "ObjectLifetimeModule::allocate/free", N,
+        [&]() {
+          ol = std::make_unique<ObjectLifetimeModule>(0, 0);
+          ol->init(loop_id, pid);
+          ol->loop_invoc();
+        },
+        [&]() {
+          for (uint64_t i = 0; i < N; i += 2) {
+            auto &o = objects[i / 2 % OBJECTS];
+            ol->allocate(o.first, accesses[i].instr % 64 + 1, o.second);
+            ol->free(o.first);
+            if (i % EPOCH == EPOCH - 2)
+              ol->loop_iter();
+          }
+        },
+        [&]() { ol.reset(); });
+  }
+
+  // a random call tree of two mutually recursive functions, up to MAX_DEPTH
+  // deep; each activation has a stack slot and a heap object, and predicts
+  // a value.  The object is freed by the activation, or, when it escapes,
+  // by the root once the tree is built.
+  {
+    enum Op { Call, Return, Stack, Malloc, Free, Load };
+    struct Event {
+      Op op;
+      uint32_t id;
+      char *addr;
+    };
+    const uint32_t MAX_DEPTH = 64;
+    const uint64_t MAX_ESCAPING = WSET / 64;
+    std::vector<char> frames(2 * (MAX_DEPTH + 1) * 4096);
+    auto generate = [&](bool escaping) {
+      std::vector<Event> events;
+      std::vector<char *> escaped;
+      events.reserve(N + 6 * MAX_DEPTH);
+      std::function<void(uint32_t)> visit = [&](uint32_t d) {
+        char *stack = frames.data() + d * 4096;
+        char *object = escaping ? heap + escaped.size() * 64
+                                : stack + (MAX_DEPTH + 1) * 4096;
+        events.push_back({Call, 1 + d % 2, nullptr});
+        events.push_back({Stack, 10 + d % 2, stack});
+        events.push_back({Malloc, 20 + d % 2, object});
+        events.push_back({Load, 30 + d % 2, stack});
+        if (escaping)
+          escaped.push_back(object);
+        for (uint32_t c = d < MAX_DEPTH ? rng() % 3 : 0; c > 0; c--)
+          if (escaped.size() + MAX_DEPTH < MAX_ESCAPING)
+            visit(d + 1);
+        if (!escaping)
+          events.push_back({Free, 0, object});
+        events.push_back({Return, 1 + d % 2, nullptr});
+      };
+      while (events.size() < N) {
+        visit(0);
+        for (char *object : escaped)
+          events.push_back({Free, 0, object});
+        escaped.clear();
+      }
+      return events;
+    };
+
+    std::unique_ptr<PrivateerProfiler> priv;
+    auto replay = [&](const std::vector<Event> &events) {
+      for (auto &e : events) {
+        switch (e.op) {
+        case Call:
+          priv->func_entry(e.id);
+          break;
+        case Return:
+          priv->func_exit(e.id);
+          break;
+        case Stack:
+          priv->stack_alloc(e.addr, e.id, 64);
+          break;
+        case Malloc:
+          priv->allocate(e.addr, e.id, 64);
+          break;
+        case Free:
+          priv->free(e.addr);
+          break;
+        case Load:
+          priv->load(e.id, (uint64_t)e.addr);
+          break;
+        }
+      }
+    };
+    auto setup = [&]() {
+      priv = std::make_unique<PrivateerProfiler>(0, 0);
+      priv->init(loop_id, pid);
+    };
+
+    for (bool escaping : {false, true}) {
+      auto events = generate(escaping);
+      suite.run(
+          escaping ? "PrivateerProfiler::recursion (escaping)"
+                   : "PrivateerProfiler::recursion",
+          events.size(), setup, [&]() { replay(events); },
+          [&]() { priv.reset(); }, 0, "call tree up to 64 deep");
+    }
+  }
+
+  // fresh pages each repeat, from a reserved range; then the same pages again
+  {
+    const uint64_t PAGES = 1 << 16;
+    const uint64_t PAGE = getpagesize();
+    void *range = mmap(nullptr, PAGES * PAGE, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    std::unique_ptr<slamp::MemoryMap<>> smmap;
+    auto allocate = [&]() {
+      for (uint64_t i = 0; i < PAGES; i++)
+        smmap->allocate((char *)range + i * PAGE, 8);
+    };
+    suite.run(
+        "MemoryMap::allocate", PAGES,
+        [&]() { smmap = std::make_unique<slamp::MemoryMap<>>(0, 0, 8); },
+        allocate, [&]() { smmap.reset(); });
+    suite.run(
+        "MemoryMap::allocate (allocated)", PAGES,
+        [&]() {
+          smmap = std::make_unique<slamp::MemoryMap<>>(0, 0, 8);
+          allocate();
+        },
+        allocate, [&]() { smmap.reset(); });
+    munmap(range, PAGES * PAGE);
+  }
+
+  // insert all then flush, the keys repeat as the dependences do
+  std::vector<uint64_t> keys;
+  keys.reserve(N);
+  for (uint64_t i = 0; i < N; i++)
+    keys.push_back(accesses[i].instr * (uint64_t)INSTRS +
+                   accesses[(i + 1) % N].instr);
+  {
+    std::unique_ptr<HTSet<uint64_t>> set;
+    suite.run(
+        "HTSet::emplace+flush", N,
+        [&]() { set = std::make_unique<HTSet<uint64_t>>(); },
+        [&]() {
+          for (auto k : keys)
+            set->emplace(k);
+          bench::keep(*set->begin());
+        },
+        [&]() { set.reset(); });
+  }
+  {
+    std::unique_ptr<HTMap_Sum<uint64_t>> map;
+    suite.run(
+        "HTMap_Sum::emplace+flush", N,
+        [&]() { map = std::make_unique<HTMap_Sum<uint64_t>>(); },
+        [&]() {
+          for (auto k : keys)
+            map->emplace(k);
+          bench::keep(*map->begin());
+        },
+        [&]() { map.reset(); });
+  }
+  {
+    std::unique_ptr<HTMap_Min<uint64_t>> map;
+    suite.run(
+        "HTMap_Min::emplace+flush", N,
+        [&]() { map = std::make_unique<HTMap_Min<uint64_t>>(); },
+        [&]() {
+          for (uint64_t i = 0; i < N; i++)
+            map->emplace(std::make_pair(keys[i], (uint32_t)(i % EPOCH)));
+          bench::keep(*map->begin());
+        },
+        [&]() { map.reset(); });
+  }
+  {
+    std::unique_ptr<HTMap_IsConstant<uint64_t>> map;
+    suite.run(
+        "HTMap_IsConstant::emplace+flush", N,
+        [&]() { map = std::make_unique<HTMap_IsConstant<uint64_t>>(); },
+        [&]() {
+          for (uint64_t i = 0; i < N; i++)
+            map->emplace(std::make_pair(keys[i], accesses[i].addr));
+          bench::keep(*map->begin());
+        },
+        [&]() { map.reset(); });
+  }
+  {
+    // the common case of the loaded-value module, each key loads a constant
+    std::unique_ptr<HTMap_IsConstant<uint64_t>> map;
+    suite.run(
+        "HTMap_IsConstant::emplace+flush(constant)", N,
+        [&]() { map = std::make_unique<HTMap_IsConstant<uint64_t>>(); },
+        [&]() {
+          for (uint64_t i = 0; i < N; i++)
+            map->emplace(std::make_pair(keys[i], keys[i] >> 3));
+          bench::keep(*map->begin());
+        },
+        [&]() { map.reset(); });
+  }
+
+  // a call/loop nest of bounded depth, encoded after every change
+  {
+    std::vector<std::pair<bool, ContextId<SpecPrivContextType, uint32_t>>> ops;
+    std::vector<ContextId<SpecPrivContextType, uint32_t>> stack;
+    ops.reserve(N);
+    for (uint64_t i = 0; i < N; i++) {
+      if (stack.empty() || (stack.size() < 16 && rng() % 2)) {
+        ContextId<SpecPrivContextType, uint32_t> c(
+            rng() % 4 ? FunctionContext : LoopContext, rng() % 64);
+        stack.push_back(c);
+        ops.emplace_back(true, c);
+      } else {
+        ops.emplace_back(false, stack.back());
+        stack.pop_back();
+      }
+    }
+    std::unique_ptr<SpecPrivContextManager> contexts;
+    suite.run(
+        "NewContextManager::encodeActiveContext", N,
+        [&]() { contexts = std::make_unique<SpecPrivContextManager>(); },
+        [&]() {
+          for (auto &op : ops) {
+            if (op.first)
+              contexts->pushContext(op.second);
+            else
+              contexts->popContext(op.second);
+            bench::keep(contexts->encodeActiveContext());
+          }
+        },
+        [&]() { contexts.reset(); });
+  }
+
+  for (auto &o : objects)
+    free(o.first);
+  free(heap);
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Memory bandwidth between each pair of NUMA nodes: a thread pinned to a cpu
+// of one node streams through a buffer bound to another. The diagonal is what
+// the consumer gets with --cpus and --numa-bind-shadow, and what the producer
+// gets with the queue on its node (SLAMP_PRODUCER_CPU); the rest is the cost
+// of leaving the placement to first touch.
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+
+#include "ProfilingModules/slamp_numa.h"
+#include "bench.h"
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("numa_bench", "Per-node memory bandwidth");
+  options.add_options()("b,bytes", "Bytes of the buffer per case",
+                        cxxopts::value<uint64_t>()->default_value("268435456"));
+  bench::Suite::add_options(options);
+  auto result = options.parse(argc, argv);
+  const auto BYTES = result["bytes"].as<uint64_t>();
+  const uint64_t WORDS = BYTES / sizeof(uint64_t);
+  bench::Suite suite("numa_bench", result);
+
+  const int nodes = slamp::numa::nodeCount();
+  std::cout << "NUMA nodes: " << nodes << std::endl;
+
+  for (int cpuNode = 0; cpuNode < nodes; cpuNode++) {
+    auto cpus = slamp::numa::cpusOfNode(cpuNode);
+    // a memory-only node
+    if (cpus.empty())
+      continue;
+
+    for (int memNode = 0; memNode < nodes; memNode++) {
+      auto suffix =
+          " cpu" + std::to_string(cpuNode) + " mem" + std::to_string(memNode);
+      if (!suite.enabled("read" + suffix) && !suite.enabled("write" + suffix))
+        continue;
+
+      // in its own pinned thread, the main one keeps its affinity
+      std::thread([&]() {
+        slamp::numa::pinCurrentThread(cpus.front());
+
+        auto *buffer = static_cast<uint64_t *>(
+            mmap(nullptr, BYTES, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (buffer == MAP_FAILED) {
+          perror("mmap");
+          return;
+        }
+        if (nodes > 1 && !slamp::numa::bindMemory(buffer, BYTES, memNode))
+          std::cout << "Cannot bind to node " << memNode << ": "
+                    << strerror(errno) << std::endl;
+        // fault the pages in on the bound node
+        memset(buffer, 1, BYTES);
+
+        suite.run(
+            "read" + suffix, WORDS, [] {},
+            [&]() {
+              uint64_t sum = 0;
+              for (uint64_t i = 0; i < WORDS; i++)
+                sum += buffer[i];
+              bench::keep(sum);
+            },
+            [] {}, sizeof(uint64_t));
+
+        suite.run(
+            "write" + suffix, WORDS, [] {},
+            [&]() {
+              for (uint64_t i = 0; i < WORDS; i++)
+                buffer[i] = i;
+              bench::keep(buffer[WORDS - 1]);
+            },
+            [] {}, sizeof(uint64_t));
+
+        munmap(buffer, BYTES);
+      }).join();
+    }
+  }
+
+  return 0;
+}
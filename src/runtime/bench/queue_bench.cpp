@@ -0,0 +1,113 @@
+// The SLAMPcustom double queue, as used by the generated frontends: the cost
+// of each packet layout a PRODUCE_* macro maps to (see FrontendGenerator.py),
+// and the end-to-end throughput with a consumer reading every packet.
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "SLAMPcustom/sw_queue_astream.h"
+#include "bench.h"
+
+// stands in for the consumer: takes the buffers in turn until an empty one
+static uint64_t drain(Queue_p dqA, Queue_p dqB) {
+  uint64_t sum = 0;
+  Queue_p q = dqA;
+  while (true) {
+    while (!q->ready_to_read)
+      usleep(10);
+    const uint64_t n = q->size;
+    const uint32_t *data = q->data();
+    for (uint64_t i = 0; i < n; i += 4)
+      sum += data[i] & 0xFF;
+    q->ready_to_read = false;
+    q->ready_to_write = true;
+    if (n == 0)
+      return sum;
+    q = q == dqA ? dqB : dqA;
+  }
+}
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("queue_bench", "SLAMPcustom producer and queue");
+  options.add_options()("n,events", "Events per case",
+                        cxxopts::value<uint64_t>()->default_value("50000000"));
+  bench::Suite::add_options(options);
+  auto result = options.parse(argc, argv);
+  const auto N = result["events"].as<uint64_t>();
+  bench::Suite suite("queue_bench", result);
+
+  const size_t bytes = QSIZE * sizeof(QTYPE);
+  auto *dataA = static_cast<uint32_t *>(aligned_alloc(CACHELINE_SIZE, bytes));
+  auto *dataB = static_cast<uint32_t *>(aligned_alloc(CACHELINE_SIZE, bytes));
+  // fault the buffers in, the first case would pay for it otherwise
+  memset(dataA, 0, bytes);
+  memset(dataB, 0, bytes);
+  Queue queueA, queueB;
+  std::thread consumer;
+  uint64_t consumed = 0;
+
+  auto setup = [&]() {
+    queueA.init(dataA);
+    queueB.init(dataB);
+    dq_index = 0;
+    ::init(&queueA, &queueB);
+    consumer = std::thread([&]() { consumed = drain(&queueA, &queueB); });
+  };
+  // the last buffer, then an empty one to stop the consumer
+  auto finish = [&]() {
+    if (dq_index)
+      produce_wait();
+    ::flush();
+    consumer.join();
+    bench::keep(consumed);
+  };
+
+  const uint64_t base = 0x7f0000000000;
+  const uint64_t mask = (1 << 24) - 1;
+
+  // a producer keeps the whole application waiting, only time its side
+  auto producer = [&](const char *name, const char *macros, auto produce) {
+    suite.run(
+        name, N, setup,
+        [&]() {
+          for (uint64_t i = 0; i < N; i++)
+            produce(i);
+        },
+        finish, 0, macros);
+  };
+  producer("produce_8", "TARGET_LOOP_INVOC/ITER/EXIT, FINISHED",
+           [](uint64_t i) { produce_8(i & 0x7); });
+  producer("produce_8_32", "FUNC_ENTRY/EXIT, LOOP_ENTRY/EXIT",
+           [](uint64_t i) { produce_8_32(i & 0x7, i); });
+  producer("produce_8_64", "FREE, STACK_LIFETIME_END",
+           [&](uint64_t i) { produce_8_64(i & 0x7, base + ((i << 3) & mask)); });
+  producer("produce_8_32_32", "INIT",
+           [](uint64_t i) { produce_8_32_32(i & 0x7, i, i); });
+  producer("produce_8_32_64", "LOAD, STORE, ALLOC, POINTS_TO_INST/ARG",
+           [&](uint64_t i) {
+             produce_8_32_64(i & 0x7, i, base + ((i << 3) & mask));
+           });
+  producer("produce_8_24_32_64", "LOAD, STORE, ALLOC, STACK_LIFETIME_START",
+           [&](uint64_t i) {
+             produce_8_24_32_64(i & 0x7, 8, i, base + ((i << 3) & mask));
+           });
+  producer("produce_8_24_32_64_64", "REALLOC",
+           [&](uint64_t i) {
+             produce_8_24_32_64_64(i & 0x7, 8, i, base + ((i << 3) & mask), i);
+           });
+
+  // until the consumer has seen every packet
+  suite.run(
+      "throughput", N, setup,
+      [&]() {
+        for (uint64_t i = 0; i < N; i++)
+          produce_8_32_64(i & 0x7, i, base + ((i << 3) & mask));
+        finish();
+      },
+      [] {}, 4 * sizeof(QTYPE), "produce_8_32_64 to the consumer");
+
+  free(dataA);
+  free(dataB);
+  return 0;
+}
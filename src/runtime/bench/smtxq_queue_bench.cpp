@@ -0,0 +1,76 @@
+// The SLAMPsmtxq queue (sw_queue.c), as used by SmtxSend.cpp: the cost of a
+// produce on the profiled side, and the end-to-end throughput with a
+// consumer reading every value.
+#include <cstdint>
+#include <thread>
+
+#include "SLAMPsmtxq/sw_queue_astream.h"
+#include "bench.h"
+
+#define sq_produce(Q, V) sq_produce(Q, V, (sq_callback)sq_flushQueue, Q)
+#define sq_produce2(Q, A, B)                                                   \
+  sq_produce2(Q, A, B, (sq_callback)sq_flushQueue, Q)
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("smtxq_queue_bench", "SLAMPsmtxq producer and queue");
+  options.add_options()("n,events", "Events per case",
+                        cxxopts::value<uint64_t>()->default_value("50000000"));
+  bench::Suite::add_options(options);
+  auto result = options.parse(argc, argv);
+  const auto N = result["events"].as<uint64_t>();
+  bench::Suite suite("smtxq_queue_bench", result);
+
+  SW_Queue q = sq_createQueue();
+  std::thread consumer;
+  uint64_t consumed = 0;
+
+  // the consumer knows how many values to expect
+  auto setup = [&](uint64_t values) {
+    return [&, values]() {
+      consumer = std::thread([&, values]() {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < values; i++)
+          sum += sq_consume(q);
+        consumed = sum;
+      });
+    };
+  };
+  auto finish = [&]() {
+    sq_flushQueue(q);
+    consumer.join();
+    bench::keep(consumed);
+  };
+
+  const uint64_t base = 0x7f0000000000;
+  const uint64_t mask = (1 << 24) - 1;
+
+  // a LOAD/STORE as SmtxSend.cpp sends it: PRODUCE_2(action, instr), address
+  suite.run(
+      "sq_produce", N, setup(2 * N),
+      [&]() {
+        for (uint64_t i = 0; i < N; i++) {
+          sq_produce(q, (i & 0x7) << 32 | (uint32_t)i);
+          sq_produce(q, base + ((i << 3) & mask));
+        }
+      },
+      finish, 0, "PRODUCE_2(action, instr), PRODUCE(addr)");
+  suite.run(
+      "sq_produce2", N, setup(2 * N),
+      [&]() {
+        for (uint64_t i = 0; i < N; i++)
+          sq_produce2(q, (i & 0x7) << 32 | (uint32_t)i, base + ((i << 3) & mask));
+      },
+      finish, 0, "(action, instr), addr");
+
+  suite.run(
+      "throughput", N, setup(2 * N),
+      [&]() {
+        for (uint64_t i = 0; i < N; i++)
+          sq_produce2(q, (i & 0x7) << 32 | (uint32_t)i, base + ((i << 3) & mask));
+        finish();
+      },
+      [] {}, 2 * sizeof(uint64_t), "sq_produce2 to the consumer");
+
+  sq_freeQueue(q);
+  return 0;
+}
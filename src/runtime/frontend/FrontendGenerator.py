@@ -86,7 +86,17 @@ if __name__ == "__main__":
         "-m",
         "--module",
         help="Module to generate frontend for",
-        choices=["wp-dep", "dep", "dep-context", "ol", "pt", "lv", "privateer"],
+        choices=[
+            "wp-dep",
+            "dep",
+            "batch-dep",
+            "dep-context",
+            "ol",
+            "pt",
+            "lv",
+            "vp",
+            "privateer",
+        ],
     )
     parser.add_argument("--config-dir", help="Config directory", required=True)
     parser.add_argument("-o", "--output", help="Output file")
@@ -97,10 +107,12 @@ if __name__ == "__main__":
     module_to_yaml = {
         "wp-dep": "WholeProgramDepModEvents.yaml",
         "dep": "DepModEvents.yaml",
+        "batch-dep": "BatchDepModEvents.yaml",
         "dep-context": "DepModule_TrackContext_Events.yaml",
         "ol": "ObjectLifetimeModEvents.yaml",
         "pt": "PointsToModEvents.yaml",
         "lv": "LoadedValueModEvents.yaml",
+        "vp": "ValuePatternModEvents.yaml",
         "privateer": "PrivateerProfilerEvents.yaml",
     }
 
@@ -1,8 +1,7 @@
 #pragma once
 
 #include "../SLAMPcustom/sw_queue_astream.h"
-#include <boost/interprocess/managed_shared_memory.hpp>
-namespace bip = boost::interprocess;
+#include "../SLAMPcustom/sw_queue_shm.h"
 
 enum UnifiedAction : char {
   INIT = 0,
@@ -33,14 +32,11 @@ enum UnifiedAction : char {
       std::cerr << "SLAMP_QUEUE_ID not set" << std::endl;                      \
       exit(-1);                                                                \
     }                                                                          \
-    auto queue_name = std::string("slamp_queue_") + env;                       \
-    auto segment = new bip::fixed_managed_shared_memory(                       \
-        bip::open_or_create, queue_name.c_str(), sizeof(uint32_t) * QSIZE * 4, \
-        (void *)(1UL << 32));                                                  \
-    Queue_p dqA, dqB;                                                          \
-    dqA = segment->find<Queue>("DQ_A").first;                                  \
-    dqB = segment->find<Queue>("DQ_B").first;                                  \
-    init(dqA, dqB);                                                            \
+    /* waits for the consumer to set up the queues */                          \
+    auto segment = QueueSegment::attach(QueueSegment::name(env));              \
+    if (segment == NULL)                                                       \
+      exit(-1);                                                                \
+    init(segment->queueA(), segment->queueB());                                \
   } while (0)
 
 #define PRODUCE_QUEUE_FLUSH() flush();
@@ -2,8 +2,12 @@
 #include "slamp_produce.h"
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <vector>
 
+#include "ProfilingModules/slamp_numa.h"
 #include "malloc_hook/malloc_hook.h"
 
 extern "C" bool hook_enabled;
@@ -14,6 +18,10 @@ static bool on_profiling = false;
 
 static uint32_t ext_fn_inst_id = 0;
 
+// whether this process is attached to a queue; the parent of the
+// epoch-parallel mode only fast-forwards and never produces
+static bool producing = true;
+
 #ifndef PRODUCE_QUEUE_DEFINE
 #define PRODUCE_QUEUE_DEFINE()
 #endif
@@ -67,15 +75,15 @@ static uint32_t ext_fn_inst_id = 0;
 #endif
 
 #ifndef PRODUCE_TARGET_LOOP_INVOC
-#define PRODUCE_TARGET_LOOP_INVOC()
+#define PRODUCE_TARGET_LOOP_INVOC(loop_id)
 #endif
 
 #ifndef PRODUCE_TARGET_LOOP_ITER
-#define PRODUCE_TARGET_LOOP_ITER()
+#define PRODUCE_TARGET_LOOP_ITER(loop_id)
 #endif
 
 #ifndef PRODUCE_TARGET_LOOP_EXIT
-#define PRODUCE_TARGET_LOOP_EXIT()
+#define PRODUCE_TARGET_LOOP_EXIT(loop_id)
 #endif
 
 #ifndef PRODUCE_POINTS_TO_ARG
@@ -106,7 +114,196 @@ static volatile char *lc_dummy = NULL;
 
 PRODUCE_QUEUE_DEFINE();
 
+/// Epoch-parallel profiling (SLAMP_FORK_SLICE=N)
+/// The process forks at top-level target loop invocations. Child k profiles
+/// invocations [k*N, (k+1)*N) into its own queue (SLAMP_QUEUE_ID_k) and its own
+/// consumer (SLAMP_FORK_CONSUMER, spawned in SLAMP_FORK_DIR/slice_k), while the
+/// parent runs on without producing anything. The dependence module only
+/// reports dependences within an invocation, so a slice needs no stores from
+/// the invocations before it.
+static uint64_t fork_slice = 0; // invocations per slice, 0 is off
+static unsigned fork_jobs = 1;
+static bool fork_child = false;
+static uint64_t fork_invocation = 0; // top-level invocations seen so far
+static uint64_t fork_next_slice = 0;
+static uint64_t fork_slice_end = 0;
+static pid_t fork_consumer_pid = 0;
+static std::vector<pid_t> *fork_children = nullptr;
+
+static uint32_t init_max_inst = 0;
+static uint32_t init_loop_id = 0;
+
+static uint64_t getenv_u64(const char *name, uint64_t default_value) {
+  char *env = getenv(name);
+  if (env == NULL)
+    return default_value;
+  return strtoull(env, NULL, 10);
+}
+
+/// report all private writable mappings as allocated, so the consumer attached
+/// in the middle of the run has shadow for the memory allocated before
+static void fork_replay_mappings() {
+  FILE *fp = fopen("/proc/self/maps", "r");
+  if (!fp) {
+    perror("/proc/self/maps");
+    exit(-1);
+  }
+
+  char buf[5000];
+  while (fgets(buf, sizeof(buf), fp) != NULL) {
+    uint64_t start, end;
+    char perms[5];
+    if (sscanf(buf, "%lx-%lx %4s", &start, &end, perms) != 3)
+      continue;
+    // the queue is shared, the stack is set up by the consumer
+    if (perms[1] != 'w' || perms[3] != 'p' || strstr(buf, "[stack]"))
+      continue;
+    PRODUCE_ALLOC(0, end - start, start);
+  }
+  fclose(fp);
+}
+
+/// wait for a process, return whether it exited normally with 0
+static bool fork_wait(pid_t pid) {
+  int status;
+  if (waitpid(pid, &status, 0) != pid)
+    return false;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void fork_wait_children(size_t keep) {
+  while (fork_children->size() > keep) {
+    pid_t pid = fork_children->front();
+    fork_children->erase(fork_children->begin());
+    if (!fork_wait(pid)) {
+      std::cerr << "Error: profiling slice (pid " << pid << ") failed"
+                << std::endl;
+      exit(-1);
+    }
+  }
+}
+
+/// set up a fresh queue and consumer for slice `slice` in the child
+static void fork_start_slice(uint64_t slice) {
+  hook_enabled = false;
+
+  char *dir_env = getenv("SLAMP_FORK_DIR");
+  std::string dir = std::string(dir_env ? dir_env : ".") + "/slice_" +
+                    std::to_string(slice);
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror(dir.c_str());
+    _exit(-1);
+  }
+
+  char *queue_env = getenv("SLAMP_QUEUE_ID");
+  if (queue_env == NULL) {
+    std::cerr << "SLAMP_QUEUE_ID not set" << std::endl;
+    _exit(-1);
+  }
+  std::string queue_id = std::string(queue_env) + "_" + std::to_string(slice);
+  setenv("SLAMP_QUEUE_ID", queue_id.c_str(), 1);
+
+  char *consumer = getenv("SLAMP_FORK_CONSUMER");
+  fork_consumer_pid = fork();
+  if (fork_consumer_pid == 0) {
+    if (chdir(dir.c_str()) != 0) {
+      perror(dir.c_str());
+      _exit(-1);
+    }
+    execl("/bin/sh", "sh", "-c", consumer, (char *)NULL);
+    perror("execl");
+    _exit(-1);
+  }
+
+  PRODUCE_QUEUE_INIT();
+  PRODUCE_INIT(init_max_inst, init_loop_id, (uint32_t)getpid());
+  fork_replay_mappings();
+  PRODUCE_QUEUE_FLUSH_AND_WAIT();
+
+  producing = true;
+  hook_enabled = true;
+}
+
+/// finish the slice in the child, never returns
+static void fork_finish_slice() {
+  PRODUCE_FINISHED();
+  PRODUCE_QUEUE_FLUSH();
+  hook_enabled = false;
+
+  _exit(fork_wait(fork_consumer_pid) ? 0 : -1);
+}
+
+/// called at every top-level invocation of the target loop
+static void fork_at_invocation() {
+  uint64_t n = fork_invocation++;
+
+  if (fork_child) {
+    if (n == fork_slice_end)
+      fork_finish_slice();
+    return;
+  }
+
+  uint64_t begin = fork_next_slice * fork_slice;
+  if (n != begin)
+    return;
+
+  // bound the number of slices in flight
+  fork_wait_children(fork_jobs - 1);
+
+  // do not duplicate buffered output in the child
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(-1);
+  }
+
+  if (pid == 0) {
+    fork_child = true;
+    fork_children->clear();
+    fork_slice_end = begin + fork_slice;
+    fork_start_slice(fork_next_slice);
+    return;
+  }
+
+  fork_children->push_back(pid);
+  fork_next_slice++;
+}
+
 void SLAMP_init(uint32_t max_inst, uint32_t fn_id, uint32_t loop_id) {
+  init_max_inst = max_inst;
+  init_loop_id = loop_id;
+
+  fork_slice = getenv_u64("SLAMP_FORK_SLICE", 0);
+  if (fork_slice != 0) {
+    if (loop_id == 0) {
+      std::cerr << "SLAMP_FORK_SLICE requires a target loop" << std::endl;
+      exit(-1);
+    }
+    if (getenv("SLAMP_FORK_CONSUMER") == NULL) {
+      std::cerr << "SLAMP_FORK_CONSUMER not set" << std::endl;
+      exit(-1);
+    }
+    fork_jobs = getenv_u64("SLAMP_FORK_JOBS", 1);
+    if (fork_jobs == 0)
+      fork_jobs = 1;
+    fork_children = new std::vector<pid_t>();
+
+    // the parent only fast-forwards; the slices attach their own queues
+    producing = false;
+    hook_enabled = true;
+#ifdef USE_MALLOC_HOOK
+    turn_on_malloc_hook();
+#endif
+    lc_dummy = setlocale(LC_ALL, "");
+    return;
+  }
+
+  // the consumer places the queue on the node of this cpu (--queue-node)
+  if (char *cpu = getenv("SLAMP_PRODUCER_CPU")) {
+    if (!slamp::numa::pinCurrentThread(atoi(cpu)))
+      std::cerr << "Cannot pin the producer to cpu " << cpu << std::endl;
+  }
 
   PRODUCE_QUEUE_INIT();
   uint32_t pid = getpid();
@@ -144,6 +341,12 @@ void SLAMP_init(uint32_t max_inst, uint32_t fn_id, uint32_t loop_id) {
 }
 
 void SLAMP_fini(const char *filename) {
+  if (fork_slice != 0 && !fork_child) {
+    hook_enabled = false;
+    fork_wait_children(0);
+    return;
+  }
+
   PRODUCE_FINISHED();
 
   PRODUCE_QUEUE_FLUSH();
@@ -155,34 +358,61 @@ void SLAMP_fini(const char *filename) {
     std::cerr << "Error: nested_level != 0 on exit" << std::endl;
     exit(-1);
   }
+
+  // the slice ran to the end of the program
+  if (fork_child) {
+    if (!fork_wait(fork_consumer_pid))
+      exit(-1);
+  }
 }
 
 void SLAMP_init_global_vars(const char *name, uint64_t addr, size_t size) {
-  PRODUCE_ALLOC(0, size, addr);
+  if (producing)
+    PRODUCE_ALLOC(0, size, addr);
 }
 
-void SLAMP_enter_fcn(uint32_t id) { PRODUCE_FUNC_ENTRY(id); }
+void SLAMP_enter_fcn(uint32_t id) {
+  if (producing)
+    PRODUCE_FUNC_ENTRY(id);
+}
 
-void SLAMP_exit_fcn(uint32_t id) { PRODUCE_FUNC_EXIT(id); }
+void SLAMP_exit_fcn(uint32_t id) {
+  if (producing)
+    PRODUCE_FUNC_EXIT(id);
+}
 
-void SLAMP_enter_loop(uint32_t id) { PRODUCE_LOOP_ENTRY(id); }
+void SLAMP_enter_loop(uint32_t id) {
+  if (producing)
+    PRODUCE_LOOP_ENTRY(id);
+}
 
-void SLAMP_exit_loop(uint32_t id) { PRODUCE_LOOP_EXIT(id); }
+void SLAMP_exit_loop(uint32_t id) {
+  if (producing)
+    PRODUCE_LOOP_EXIT(id);
+}
 
 void SLAMP_loop_iter_ctx(uint32_t id) {
-  PRODUCE_LOOP_ITER_CTX(id);
+  if (producing)
+    PRODUCE_LOOP_ITER_CTX(id);
   // produce_32_32(LOOP_ITER_CTX, id);
 }
 
-void SLAMP_loop_invocation() {
-  PRODUCE_TARGET_LOOP_INVOC();
+// the single target loop is init_loop_id; in the batch mode each target
+// loop reports its own ID, and the nesting level counts all of them
+static void loop_invocation(uint32_t loop_id) {
+  if (fork_slice != 0 && nested_level == 0)
+    fork_at_invocation();
+
+  if (producing)
+    PRODUCE_TARGET_LOOP_INVOC(loop_id);
 
   nested_level++;
-  on_profiling = true;
+  on_profiling = producing;
 }
 
-void SLAMP_loop_iteration() {
-  PRODUCE_TARGET_LOOP_ITER();
+static void loop_iteration(uint32_t loop_id) {
+  if (producing)
+    PRODUCE_TARGET_LOOP_ITER(loop_id);
 
 #ifdef SAMPLING_ITER
   if (counter_iter % 100 == 0) {
@@ -195,8 +425,9 @@ void SLAMP_loop_iteration() {
 #endif
 }
 
-void SLAMP_loop_exit() {
-  PRODUCE_TARGET_LOOP_EXIT();
+static void loop_exit(uint32_t loop_id) {
+  if (producing)
+    PRODUCE_TARGET_LOOP_EXIT(loop_id);
   nested_level--;
   if (nested_level < 0) {
     // huge problem
@@ -208,14 +439,26 @@ void SLAMP_loop_exit() {
   }
 }
 
+void SLAMP_loop_invocation() { loop_invocation(init_loop_id); }
+void SLAMP_loop_iteration() { loop_iteration(init_loop_id); }
+void SLAMP_loop_exit() { loop_exit(init_loop_id); }
+
+void SLAMP_batch_loop_invocation(uint32_t loop_id) {
+  loop_invocation(loop_id);
+}
+void SLAMP_batch_loop_iteration(uint32_t loop_id) { loop_iteration(loop_id); }
+void SLAMP_batch_loop_exit(uint32_t loop_id) { loop_exit(loop_id); }
+
 void SLAMP_report_base_pointer_arg(uint32_t fcnId, uint32_t argId, void *ptr) {
   // FIXME: combine fcnid and argid to 32 bit
   uint32_t fn_arg_id = (fcnId << 16) | (argId & 0xffff);
-  PRODUCE_POINTS_TO_ARG(fn_arg_id, (uint64_t)ptr);
+  if (producing)
+    PRODUCE_POINTS_TO_ARG(fn_arg_id, (uint64_t)ptr);
 }
 
 void SLAMP_report_base_pointer_inst(uint32_t instId, void *ptr) {
-  PRODUCE_POINTS_TO_INST(instId, (uint64_t)ptr);
+  if (producing)
+    PRODUCE_POINTS_TO_INST(instId, (uint64_t)ptr);
 }
 
 // TODO: this should be optional
@@ -251,9 +494,16 @@ void SLAMP_load8(uint32_t instr, const uint64_t addr, const uint32_t bare_instr,
   SLAMP_load(instr, addr, bare_instr, value, 8);
 }
 
+// the size of an access event is 24 bits, a longer one (memcpy, memset) is
+// sent in pieces
+static constexpr size_t MAX_ACCESS_SIZE = (1 << 24) - 1;
+
 void SLAMP_loadn(uint32_t instr, const uint64_t addr, const uint32_t bare_instr,
                  size_t n) {
-  SLAMP_load(instr, addr, bare_instr, 0, n);
+  uint64_t a = addr;
+  for (; n > MAX_ACCESS_SIZE; n -= MAX_ACCESS_SIZE, a += MAX_ACCESS_SIZE)
+    SLAMP_load(instr, a, bare_instr, 0, MAX_ACCESS_SIZE);
+  SLAMP_load(instr, a, bare_instr, 0, n);
 }
 
 void SLAMP_load1_ext(const uint64_t addr, const uint32_t bare_instr,
@@ -298,7 +548,10 @@ void SLAMP_store8(uint32_t instr, const uint64_t addr) {
   SLAMP_store(instr, addr, instr, 8);
 }
 void SLAMP_storen(uint32_t instr, const uint64_t addr, size_t n) {
-  SLAMP_store(instr, addr, instr, n);
+  uint64_t a = addr;
+  for (; n > MAX_ACCESS_SIZE; n -= MAX_ACCESS_SIZE, a += MAX_ACCESS_SIZE)
+    SLAMP_store(instr, a, instr, MAX_ACCESS_SIZE);
+  SLAMP_store(instr, a, instr, n);
 }
 
 void SLAMP_store1_ext(const uint64_t addr, const uint32_t bare_inst) {
@@ -318,14 +571,19 @@ void SLAMP_storen_ext(const uint64_t addr, const uint32_t bare_inst, size_t n) {
 }
 
 void malloc_callback(void *ptr, size_t size) {
-  PRODUCE_ALLOC(ext_fn_inst_id, size, (uint64_t)ptr);
+  if (producing)
+    PRODUCE_ALLOC(ext_fn_inst_id, size, (uint64_t)ptr);
 }
 
 void calloc_callback(void *ptr, size_t nmemb, size_t size) {
-  PRODUCE_ALLOC(ext_fn_inst_id, size * nmemb, (uint64_t)ptr);
+  if (producing)
+    PRODUCE_ALLOC(ext_fn_inst_id, size * nmemb, (uint64_t)ptr);
 }
 
-void free_callback(void *ptr) { PRODUCE_FREE((uint64_t)ptr); }
+void free_callback(void *ptr) {
+  if (producing)
+    PRODUCE_FREE((uint64_t)ptr);
+}
 
 void realloc_callback(void *new_ptr, void *ptr, size_t size) {
   // FIXME: if realloc returns the same pointer, it needs to be handled
@@ -334,10 +592,12 @@ void realloc_callback(void *new_ptr, void *ptr, size_t size) {
   // pointers are the same
 
   // PRODUCE_ALLOC(ext_fn_inst_id, size, (uint64_t)new_ptr);
-  PRODUCE_REALLOC(ext_fn_inst_id, size, (uint64_t)ptr, (uint64_t)new_ptr);
+  if (producing)
+    PRODUCE_REALLOC(ext_fn_inst_id, size, (uint64_t)ptr, (uint64_t)new_ptr);
 }
 void memalign_callback(void *ptr, size_t alignment, size_t size) {
-  PRODUCE_ALLOC(ext_fn_inst_id, size, (uint64_t)ptr);
+  if (producing)
+    PRODUCE_ALLOC(ext_fn_inst_id, size, (uint64_t)ptr);
 }
 
 // FIXME: a bunch of unused functions
@@ -349,8 +609,10 @@ void SLAMP_allocated(uint64_t addr) {}
 void SLAMP_callback_stack_alloca(uint32_t instr, void *ptr, uint64_t array_size,
                                  uint64_t elt_size) {
   const uint64_t size = array_size * elt_size;
-  PRODUCE_STACK_LIFETIME_START(instr, size, (uint64_t)ptr);
+  if (producing)
+    PRODUCE_STACK_LIFETIME_START(instr, size, (uint64_t)ptr);
 }
 void SLAMP_callback_stack_free(uint32_t instr, void *ptr) {
-  PRODUCE_STACK_LIFETIME_END(instr, (uint64_t)ptr);
+  if (producing)
+    PRODUCE_STACK_LIFETIME_END(instr, (uint64_t)ptr);
 }
@@ -60,6 +60,10 @@ void SLAMP_loop_iter_ctx(uint32_t id);
 void SLAMP_loop_invocation();
 void SLAMP_loop_iteration();
 void SLAMP_loop_exit();
+// batch mode (-slamp-target-loops), with the loop of the event
+void SLAMP_batch_loop_invocation(uint32_t loop_id);
+void SLAMP_batch_loop_iteration(uint32_t loop_id);
+void SLAMP_batch_loop_exit(uint32_t loop_id);
 
 void SLAMP_report_base_pointer_arg(uint32_t, uint32_t, void *ptr);
 void SLAMP_report_base_pointer_inst(uint32_t, void *ptr);
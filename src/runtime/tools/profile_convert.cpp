@@ -0,0 +1,167 @@
+// Convert a binary PROMPT profile (prompt.prof) to the text logs the modules
+// write with `--format text`: deplog.txt, lvlog.txt, vplog.txt, ptlog.txt and
+// ollog.txt
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "cxxopts.hpp"
+#include "slamp_profile.h"
+
+using namespace slamp;
+
+// same as ContextManager::printContext, innermost first
+static void print_context(std::ostream &os, const ProfileReader &reader,
+                          uint32_t id) {
+  auto context = reader.context(id);
+  for (auto i = context.size(); i > 0; i--)
+    os << "(" << context[i - 1].type << "," << context[i - 1].id << ")";
+}
+
+// one block per DEPENDENCE section, the batch mode has one per loop
+static void write_dependences(const ProfileReader &reader,
+                              const SectionHeader &section, std::ostream &of) {
+  of << section.loop_id << " " << 0 << " " << 0 << " " << 0 << " " << 0 << " "
+     << 0 << "\n";
+
+  for (auto &r : reader.records<DependenceRecord>(section)) {
+    of << section.loop_id << " " << r.src << " " << r.dst << " " << r.dst_bare
+       << " " << r.cross << " " << r.count << " ";
+    if (section.flags & PROFILE_HAS_MIN_DISTANCE)
+      of << r.min_distance;
+    of << "\n";
+  }
+}
+
+static void write_values(const ProfileReader &reader,
+                         const SectionHeader &section,
+                         const std::string &filename) {
+  std::ofstream of(filename);
+  of << "BEGIN SPEC PRIV PROFILE\n";
+  for (auto &r : reader.records<ValueRecord>(section)) {
+    // not constant, kept only for accumulation
+    if (r.value == PROFILE_VALUE_INVALID)
+      continue;
+    of << "PRED VAL " << r.instr << " " << r.value << " ; \n";
+  }
+  of << " END SPEC PRIV PROFILE\n";
+}
+
+// same as ValuePatternModule::fini
+static void write_value_patterns(const ProfileReader &reader,
+                                 const SectionHeader &section,
+                                 const std::string &filename) {
+  std::ofstream of(filename);
+  of << "BEGIN SPEC PRIV PROFILE\n";
+  for (auto &r : reader.records<ValuePatternRecord>(section)) {
+    const char *kind = r.stream == STREAM_VALUE ? "VALUE" : "ADDR";
+    if (r.flags & PATTERN_CONSTANT)
+      of << "PRED " << kind << " " << r.instr << " CONSTANT " << r.first;
+    else if ((r.flags & PATTERN_LINEAR) && (r.flags & PATTERN_SLOPE_KNOWN))
+      of << "PRED " << kind << " " << r.instr << " LINEAR " << r.slope << " "
+         << (int64_t)(r.first - r.slope * r.first_iter);
+    else if ((r.flags & PATTERN_STRIDE) && r.count > 1)
+      of << "PRED " << kind << " " << r.instr << " STRIDE " << r.stride;
+    else
+      continue;
+    of << " COUNT " << r.count << " ; \n";
+  }
+  of << " END SPEC PRIV PROFILE\n";
+}
+
+static void write_points_to(const ProfileReader &reader,
+                            const SectionHeader &section,
+                            const std::string &filename) {
+  std::ofstream of(filename);
+  of << "BEGIN SPEC PRIV PROFILE\n";
+  of << "COMPLETE ALLOCATION INFO ; \n";
+
+  auto loopContexts =
+      reader.records<LoopContextRecord>(ProfileSection::LOOP_CONTEXTS);
+  of << "LOOP CONTEXTS: " << loopContexts.size() << "\n";
+  for (auto &r : loopContexts) {
+    print_context(of, reader, r.context);
+    of << "\n";
+  }
+
+  for (auto &r : reader.records<PointsToRecord>(section)) {
+    of << "PRED OBJ " << r.instr << " at ";
+    print_context(of, reader, r.context);
+    of << ": " << 1 << "\n";
+    of << "AU ";
+    if (r.au == PT_AU_NOT_CONSTANT) {
+      of << " NOT CONSTANT";
+    } else if (r.au == PT_AU_UNMANAGED) {
+      of << " UNMANAGED";
+    } else if (r.au == PT_AU_NULL) {
+      of << " NULL";
+    } else {
+      of << r.au;
+      of << " FROM CONTEXT ";
+      print_context(of, reader, r.au_context);
+    }
+    of << ";\n";
+  }
+
+  of << " END SPEC PRIV PROFILE\n";
+}
+
+static void write_local_objects(const ProfileReader &reader,
+                                const SectionHeader &section,
+                                const std::string &filename) {
+  std::ofstream of(filename);
+  of << "BEGIN SPEC PRIV PROFILE\n";
+  of << "COMPLETE ALLOCATION INFO ; \n";
+  for (auto &r : reader.records<LocalObjectRecord>(section)) {
+    of << "LOCAL OBJECT " << r.instr << " at context ";
+    print_context(of, reader, r.context);
+    of << ";\n";
+  }
+  of << " END SPEC PRIV PROFILE\n";
+}
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("profile_convert",
+                           "Convert a binary PROMPT profile to text logs");
+  options.add_options()("profile", "Binary profile",
+                        cxxopts::value<std::string>()->default_value(
+                            "prompt.prof"))(
+      "o,output-dir", "Directory of the text logs",
+      cxxopts::value<std::string>()->default_value("."));
+  options.parse_positional({"profile"});
+  auto result = options.parse(argc, argv);
+
+  auto profile = result["profile"].as<std::string>();
+  auto dir = result["output-dir"].as<std::string>() + "/";
+
+  ProfileReader reader;
+  if (!reader.open(profile.c_str()))
+    return -1;
+
+  std::ofstream deplog;
+  for (auto &section : reader.sections()) {
+    switch (section.kind) {
+    case ProfileSection::DEPENDENCE:
+      if (!deplog.is_open())
+        deplog.open(dir + "deplog.txt");
+      write_dependences(reader, section, deplog);
+      break;
+    case ProfileSection::LOADED_VALUE:
+      write_values(reader, section, dir + "lvlog.txt");
+      break;
+    case ProfileSection::VALUE_PATTERN:
+      write_value_patterns(reader, section, dir + "vplog.txt");
+      break;
+    case ProfileSection::POINTS_TO:
+      write_points_to(reader, section, dir + "ptlog.txt");
+      break;
+    case ProfileSection::LOCAL_OBJECTS:
+      write_local_objects(reader, section, dir + "ollog.txt");
+      break;
+    default:
+      break;
+    }
+  }
+
+  return 0;
+}
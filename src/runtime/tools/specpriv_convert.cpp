@@ -0,0 +1,170 @@
+// Emit the SpecPriv profile of a PROMPT run: the points-to, object-lifetime
+// and loaded-value results, named with the symbol table of the pass. The
+// results are read from the binary profile (prompt.prof), or from the text
+// logs (ptlog.txt, ollog.txt, lvlog.txt) with --text; either is streamed once.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "cxxopts.hpp"
+#include "slamp_specpriv.h"
+
+using namespace slamp;
+
+static void convert_binary(const ProfileReader &reader,
+                           SpecPrivEmitter &emitter) {
+  // the loop contexts first, the local objects are local to them
+  for (auto &r :
+       reader.records<LoopContextRecord>(ProfileSection::LOOP_CONTEXTS))
+    emitter.addLoopContext(reader.context(r.context));
+
+  for (auto &section : reader.sections()) {
+    switch (section.kind) {
+    case ProfileSection::POINTS_TO:
+      for (auto &r : reader.records<PointsToRecord>(section))
+        emitter.predictObject(r.instr, reader.context(r.context), r.au,
+                              reader.context(r.au_context));
+      break;
+    case ProfileSection::LOCAL_OBJECTS:
+      for (auto &r : reader.records<LocalObjectRecord>(section))
+        emitter.localObject(r.instr, reader.context(r.context));
+      break;
+    case ProfileSection::LOADED_VALUE:
+      for (auto &r : reader.records<ValueRecord>(section))
+        if (r.value != PROFILE_VALUE_INVALID)
+          emitter.predictValue(r.instr, r.value);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+// "(2,39)(1,10)(0,0)", innermost first as ContextManager::printContext
+// writes it; returned innermost last
+static std::vector<ContextElement> parse_context(const char *s) {
+  std::vector<ContextElement> context;
+  while ((s = strchr(s, '('))) {
+    char *end;
+    uint32_t type = strtoul(s + 1, &end, 10);
+    uint32_t id = strtoul(end + 1, &end, 10);
+    context.push_back({type, id});
+    s = end;
+  }
+  return {context.rbegin(), context.rend()};
+}
+
+static bool starts_with(const std::string &line, const char *prefix) {
+  return line.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// PointsToModule::fini
+static void convert_points_to(std::istream &is, SpecPrivEmitter &emitter) {
+  std::string line;
+  while (std::getline(is, line)) {
+    if (starts_with(line, "LOOP CONTEXTS: ")) {
+      auto count = strtoul(line.c_str() + strlen("LOOP CONTEXTS: "), nullptr, 10);
+      for (unsigned long i = 0; i < count && std::getline(is, line); i++)
+        emitter.addLoopContext(parse_context(line.c_str()));
+    } else if (starts_with(line, "PRED OBJ ")) {
+      // PRED OBJ 282 at (1,10)(0,0): 1
+      // AU 24 FROM CONTEXT (1,0)(1,10)(0,0);
+      char *end;
+      uint32_t uoId = strtoul(line.c_str() + strlen("PRED OBJ "), &end, 10);
+      auto context = parse_context(end);
+
+      std::string au;
+      if (!std::getline(is, au))
+        break;
+      if (au.find("NOT CONSTANT") != std::string::npos)
+        emitter.predictObject(uoId, context, PT_AU_NOT_CONSTANT, context);
+      else if (au.find("UNMANAGED") != std::string::npos)
+        emitter.predictObject(uoId, context, PT_AU_UNMANAGED, context);
+      else if (au.find("NULL") != std::string::npos)
+        emitter.predictObject(uoId, context, PT_AU_NULL, context);
+      else {
+        int32_t instr = strtol(au.c_str() + strlen("AU "), &end, 10);
+        emitter.predictObject(uoId, context, instr, parse_context(end));
+      }
+    }
+  }
+}
+
+// ObjectLifetimeModule::fini
+static void convert_local_objects(std::istream &is, SpecPrivEmitter &emitter) {
+  std::string line;
+  while (std::getline(is, line)) {
+    // LOCAL OBJECT 279 at context (2,39)(2,35)(1,10)(0,0);
+    if (!starts_with(line, "LOCAL OBJECT "))
+      continue;
+    char *end;
+    uint32_t instr = strtoul(line.c_str() + strlen("LOCAL OBJECT "), &end, 10);
+    emitter.localObject(instr, parse_context(end));
+  }
+}
+
+// LoadedValueModule::fini
+static void convert_values(std::istream &is, SpecPrivEmitter &emitter) {
+  std::string line;
+  while (std::getline(is, line)) {
+    // PRED VAL 42 7 ;
+    if (!starts_with(line, "PRED VAL "))
+      continue;
+    char *end;
+    uint32_t instr = strtoul(line.c_str() + strlen("PRED VAL "), &end, 10);
+    uint64_t value = strtoull(end, nullptr, 10);
+    emitter.predictValue(instr, value);
+  }
+}
+
+int main(int argc, char **argv) {
+  cxxopts::Options options("specpriv_convert",
+                           "Emit the SpecPriv profile of a PROMPT run");
+  options.add_options()("profile", "Binary profile",
+                        cxxopts::value<std::string>()->default_value(
+                            "prompt.prof"))(
+      "s,symbols", "Symbol table of the pass (-slamp-symbols)",
+      cxxopts::value<std::string>()->default_value(SYMBOLS_DEFAULT_FILE))(
+      "text", "Read the text logs of the points-to, object lifetime and "
+              "loaded value modules instead of the binary profile")(
+      "points-to", "Text log of the points-to module",
+      cxxopts::value<std::string>()->default_value("ptlog.txt"))(
+      "object-lifetime", "Text log of the object lifetime module",
+      cxxopts::value<std::string>()->default_value("ollog.txt"))(
+      "loaded-value", "Text log of the loaded value module",
+      cxxopts::value<std::string>()->default_value("lvlog.txt"))(
+      "o,output", "SpecPriv profile",
+      cxxopts::value<std::string>()->default_value(
+          "specpriv-profile-converted.out"));
+  options.parse_positional({"profile"});
+  auto result = options.parse(argc, argv);
+
+  SymbolTable symbols;
+  if (!symbols.open(result["symbols"].as<std::string>().c_str()))
+    return -1;
+
+  std::ofstream of(result["output"].as<std::string>());
+  SpecPrivEmitter emitter(of, symbols);
+  emitter.begin();
+
+  if (result.count("text")) {
+    // in this order: the local objects need the loop context of the points-to
+    // log
+    std::ifstream pt(result["points-to"].as<std::string>());
+    convert_points_to(pt, emitter);
+    std::ifstream ol(result["object-lifetime"].as<std::string>());
+    convert_local_objects(ol, emitter);
+    std::ifstream lv(result["loaded-value"].as<std::string>());
+    convert_values(lv, emitter);
+  } else {
+    ProfileReader reader;
+    if (!reader.open(result["profile"].as<std::string>().c_str()))
+      return -1;
+    convert_binary(reader, emitter);
+  }
+
+  emitter.end();
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ProfilingModules/PageOwners.h"
+
+using slamp::PageOwners;
+
+static constexpr uint32_t GROUPS = PageOwners::GROUPS;
+
+// exactly one thread claims each group
+static void expectOneOwner(PageOwners &owners, unsigned threads) {
+  for (uint32_t g = 0; g < GROUPS; g++) {
+    unsigned claimed = 0;
+    for (unsigned t = 0; t < threads; t++)
+      claimed += owners.claim(g, t);
+    ASSERT_EQ(claimed, 1u) << "group " << g;
+  }
+}
+
+TEST(PageOwnersTest, InitialOwnersAreRoundRobin) {
+  PageOwners owners(3);
+  for (uint32_t g = 0; g < GROUPS; g++)
+    EXPECT_EQ(owners.owner(g), g % 3);
+  // the unit is hashed to its group
+  EXPECT_EQ(owners.owner(GROUPS + 4), owners.owner(4));
+  expectOneOwner(owners, 3);
+}
+
+TEST(PageOwnersTest, TooFewAccessesMoveNothing) {
+  PageOwners owners(4);
+  for (int i = 0; i < 1000; i++)
+    owners.claim(0, 0);
+  EXPECT_EQ(owners.rebalance(), 0u);
+  EXPECT_EQ(owners.owner(0), 0u);
+  EXPECT_EQ(owners.rebalance_count(), 0u);
+}
+
+TEST(PageOwnersTest, RebalanceKeepsOneOwnerAndBoundsLoad) {
+  const unsigned threads = 4;
+  PageOwners owners(threads);
+
+  // all the accesses go to 64 groups of thread 0
+  std::vector<uint64_t> load(GROUPS);
+  for (uint32_t g = 0; g < 64 * threads; g += threads)
+    load[g] = 2000;
+  for (uint32_t g = 0; g < GROUPS; g++)
+    for (uint64_t i = 0; i < load[g]; i++)
+      ASSERT_TRUE(owners.claim(g, owners.owner(g)));
+
+  const unsigned moved = owners.rebalance();
+  EXPECT_GT(moved, 0u);
+  EXPECT_EQ(owners.groups_moved(), moved);
+  EXPECT_EQ(owners.rebalance_count(), 1u);
+
+  expectOneOwner(owners, threads);
+
+  // the busiest thread is within SLACK (2/16) of the average
+  std::vector<uint64_t> total(threads);
+  uint64_t sum = 0;
+  for (uint32_t g = 0; g < GROUPS; g++) {
+    total[owners.owner(g)] += load[g];
+    sum += load[g];
+  }
+  const uint64_t average = sum / threads;
+  EXPECT_LE(*std::max_element(total.begin(), total.end()) * 16, average * 18);
+}
+
+TEST(PageOwnersTest, BalancedLoadMovesNothing) {
+  const unsigned threads = 4;
+  PageOwners owners(threads);
+  for (uint32_t g = 0; g < GROUPS; g++)
+    for (int i = 0; i < 8; i++)
+      owners.claim(g, owners.owner(g));
+
+  EXPECT_EQ(owners.rebalance(), 0u);
+  for (uint32_t g = 0; g < GROUPS; g++)
+    EXPECT_EQ(owners.owner(g), g % threads);
+}
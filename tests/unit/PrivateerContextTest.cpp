@@ -0,0 +1,85 @@
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "ProfilingModules/privateer/context.h"
+
+TEST(PrivateerContextTest, InternIsStable) {
+  ContextTable table;
+  EXPECT_EQ(table.size(), 1u);
+
+  const CtxId f = table.intern(Function, Name(FcnName, 1), 0);
+  const CtxId l = table.intern(Loop, Name(LoopName, 2), f);
+  const CtxId g = table.intern(Function, Name(FcnName, 3), l);
+  EXPECT_EQ(table.size(), 4u);
+
+  // the same (type, name, parent) is the same context, recent or not
+  EXPECT_EQ(table.intern(Function, Name(FcnName, 3), l), g);
+  EXPECT_EQ(table.intern(Loop, Name(LoopName, 2), f), l);
+  EXPECT_EQ(table.intern(Function, Name(FcnName, 1), 0), f);
+  EXPECT_EQ(table.size(), 4u);
+
+  // the same name under another parent is not
+  const CtxId g2 = table.intern(Function, Name(FcnName, 3), f);
+  EXPECT_NE(g2, g);
+  EXPECT_EQ(table.size(), 5u);
+
+  EXPECT_EQ(table[g].parent, l);
+  EXPECT_EQ(table[g].depth, 3u);
+  EXPECT_EQ(table.innermostFunction(g), g);
+  EXPECT_EQ(table.findCommon(g, g2), f);
+}
+
+TEST(PrivateerContextTest, ImportMapsEveryContext) {
+  // fn_1 > loop_2 > fn_3 is in both, in another order
+  ContextTable a;
+  const CtxId a1 = a.intern(Function, Name(FcnName, 1), 0);
+  const CtxId a4 = a.intern(Function, Name(FcnName, 4), a1);
+  const CtxId a2 = a.intern(Loop, Name(LoopName, 2), a1);
+  const CtxId a3 = a.intern(Function, Name(FcnName, 3), a2);
+
+  ContextTable b;
+  const CtxId b5 = b.intern(Function, Name(FcnName, 5), 0);
+  const CtxId b1 = b.intern(Function, Name(FcnName, 1), 0);
+  const CtxId b2 = b.intern(Loop, Name(LoopName, 2), b1);
+  const CtxId b6 = b.intern(Loop, Name(LoopName, 6), b5);
+  const CtxId b3 = b.intern(Function, Name(FcnName, 3), b2);
+
+  std::vector<Context> before;
+  for (CtxId id = 0; id < a.size(); id++)
+    before.push_back(a[id]);
+
+  const std::vector<CtxId> ids = a.import(b);
+  ASSERT_EQ(ids.size(), b.size());
+  EXPECT_EQ(ids[0], 0u);
+
+  // the contexts of `a` keep their IDs
+  for (CtxId id = 0; id < before.size(); id++) {
+    EXPECT_EQ(a[id].type, before[id].type);
+    EXPECT_EQ(a[id].name, before[id].name);
+    EXPECT_EQ(a[id].parent, before[id].parent);
+  }
+
+  // the shared ones map to them, the others are new
+  EXPECT_EQ(ids[b1], a1);
+  EXPECT_EQ(ids[b2], a2);
+  EXPECT_EQ(ids[b3], a3);
+  EXPECT_GE(ids[b5], before.size());
+  EXPECT_GE(ids[b6], before.size());
+  EXPECT_NE(ids[b5], ids[b6]);
+  EXPECT_EQ(a.size(), before.size() + 2);
+  for (CtxId id : ids)
+    EXPECT_NE(id, a4);
+
+  // every context is the same in both
+  for (CtxId id = 1; id < b.size(); id++) {
+    EXPECT_EQ(a[ids[id]].type, b[id].type);
+    EXPECT_EQ(a[ids[id]].name, b[id].name);
+    EXPECT_EQ(a[ids[id]].parent, ids[b[id].parent]);
+    EXPECT_EQ(a[ids[id]].depth, b[id].depth);
+  }
+
+  // importing again adds nothing
+  EXPECT_EQ(a.import(b), ids);
+  EXPECT_EQ(a.size(), before.size() + 2);
+}
@@ -0,0 +1,151 @@
+#include "gtest/gtest.h"
+
+#include <condition_variable>
+#include <mutex>
+
+#include "ProfilingModules/ValuePatternModule.h"
+#include "SLAMPcustom/sw_queue_astream.h"
+
+TEST(ValuePatternTest, Constant) {
+  ValuePattern p;
+  for (uint64_t i = 0; i < 10; i++)
+    p.observe(i, 42);
+
+  EXPECT_TRUE(p.is_constant());
+  EXPECT_TRUE(p.is_stride());
+  EXPECT_EQ(p.stride, 0);
+  EXPECT_EQ(p.first, 42u);
+  EXPECT_EQ(p.count, 10u);
+}
+
+TEST(ValuePatternTest, Linear) {
+  ValuePattern p;
+  for (uint64_t i = 0; i < 10; i++)
+    p.observe(i, 3 * i + 7);
+
+  EXPECT_FALSE(p.is_constant());
+  ASSERT_TRUE(p.is_linear());
+  EXPECT_EQ(p.slope, 3);
+  EXPECT_EQ(p.base(), 7);
+  ASSERT_TRUE(p.is_stride());
+  EXPECT_EQ(p.stride, 3);
+}
+
+TEST(ValuePatternTest, StrideAcrossInvocations) {
+  // the iteration starts over, the value keeps going
+  ValuePattern p;
+  uint64_t value = 100;
+  for (int invocation = 0; invocation < 3; invocation++)
+    for (uint64_t i = 0; i < 4; i++, value += 8)
+      p.observe(i, value);
+
+  EXPECT_FALSE(p.is_linear());
+  ASSERT_TRUE(p.is_stride());
+  EXPECT_EQ(p.stride, 8);
+}
+
+TEST(ValuePatternTest, NoPattern) {
+  ValuePattern p;
+  const uint64_t values[] = {5, 9, 2, 14, 3};
+  for (uint64_t i = 0; i < 5; i++)
+    p.observe(i, values[i]);
+
+  EXPECT_FALSE(p.is_constant());
+  EXPECT_FALSE(p.is_linear());
+  EXPECT_FALSE(p.is_stride());
+}
+
+TEST(ValuePatternTest, MergeShardsOfOneLine) {
+  ValuePattern a, b;
+  for (uint64_t i = 0; i < 5; i++)
+    a.observe(i, 3 * i + 7);
+  for (uint64_t i = 5; i < 10; i++)
+    b.observe(i, 3 * i + 7);
+
+  a.merge(b);
+  ASSERT_TRUE(a.is_linear());
+  EXPECT_EQ(a.slope, 3);
+  EXPECT_EQ(a.base(), 7);
+  EXPECT_TRUE(a.is_stride());
+  EXPECT_EQ(a.count, 10u);
+}
+
+TEST(ValuePatternTest, MergeDifferentConstants) {
+  ValuePattern a, b;
+  for (uint64_t i = 0; i < 5; i++)
+    a.observe(i, 5);
+  for (uint64_t i = 5; i < 10; i++)
+    b.observe(i, 6);
+
+  a.merge(b);
+  EXPECT_FALSE(a.is_constant());
+  EXPECT_FALSE(a.is_linear());
+  // the order of the two is unknown, only their own strides count
+  ASSERT_TRUE(a.is_stride());
+  EXPECT_EQ(a.stride, 0);
+}
+
+TEST(ValuePatternTest, MergeDifferentStrides) {
+  ValuePattern a, b;
+  for (uint64_t i = 0; i < 5; i++)
+    a.observe(i, 2 * i);
+  for (uint64_t i = 0; i < 5; i++)
+    b.observe(i, 4 * i);
+
+  a.merge(b);
+  EXPECT_FALSE(a.is_linear());
+  EXPECT_FALSE(a.is_stride());
+}
+
+TEST(ValuePatternTest, MergeIntoEmpty) {
+  ValuePattern a, b;
+  b.observe(0, 1);
+  b.observe(1, 2);
+
+  a.merge(b);
+  EXPECT_EQ(a.count, 2u);
+  EXPECT_TRUE(a.is_linear());
+  EXPECT_EQ(a.slope, 1);
+}
+
+// a load goes through the queue as produce_8_24_32_64_64, the value in the
+// first lane of the second packet
+TEST(ValuePatternTest, LoadRoundTrip) {
+  alignas(64) static uint32_t buffer[64];
+  Queue queue;
+  queue.init(buffer);
+
+  dq_data = buffer;
+  dq_index = 0;
+  const uint64_t addrs[] = {0x7fff12345678, 0x7fff12345680, 0x7fff12345688};
+  for (uint64_t i = 0; i < 3; i++)
+    produce_8_24_32_64_64(1, 8, 12 + i, addrs[i], 10 * i + 10);
+
+  unsigned running = 1;
+  std::mutex m;
+  std::condition_variable cv;
+  DoubleQueue dq(&queue, &queue, true, running, m, cv);
+  dq.size = dq_index;
+
+  ValuePattern values, addresses;
+  for (uint64_t i = 0; i < 3; i++) {
+    ASSERT_EQ(dq.consumePacket(), 1u);
+    uint32_t size, instr;
+    uint64_t addr, value;
+    dq.unpack_24_32_64_64(size, instr, addr, value);
+
+    EXPECT_EQ(size, 8u);
+    EXPECT_EQ(instr, 12 + i);
+    EXPECT_EQ(addr, addrs[i]);
+    EXPECT_EQ(value, 10 * i + 10);
+    values.observe(i, value);
+    addresses.observe(i, addr);
+  }
+  EXPECT_EQ(dq.index, dq.size);
+
+  ASSERT_TRUE(values.is_linear());
+  EXPECT_EQ(values.slope, 10);
+  EXPECT_EQ(values.base(), 10);
+  ASSERT_TRUE(addresses.is_stride());
+  EXPECT_EQ(addresses.stride, 8);
+}